@@ -24,9 +24,12 @@
 /*---------- includes ----------*/
 #include "options.h"
 #include "nvs_flash.h"
+#include "esp_timer.h"
 
 /*---------- macro ----------*/
 #define TAG                                         "Daemon"
+#define XLOG_TASK_STACK_SIZE                        (3072)
+#define XLOG_TASK_PERIOD_MS                         (10)
 
 /*---------- type define ----------*/
 /*---------- variable prototype ----------*/
@@ -34,6 +37,9 @@
 /*---------- variable ----------*/
 static SemaphoreHandle_t xlog_buf_mutex;
 static SemaphoreHandle_t xlog_console_mutex;
+#if defined(CONFIG_XLOG_DEFERRED) || defined(CONFIG_XLOG_ASYNC) || defined(CONFIG_XLOG_ISR)
+static TaskHandle_t xlog_task;
+#endif
 
 /*---------- function ----------*/
 static void __xlog_buf_lock(void)
@@ -50,6 +56,35 @@ static void __xlog_buf_unlock(void)
     }
 }
 
+#ifdef CONFIG_XLOG_LOCKLESS
+static void __xlog_suspend(void)
+{
+    vTaskSuspendAll();
+}
+
+static void __xlog_resume(void)
+{
+    xTaskResumeAll();
+}
+
+static void __xlog_yield(void)
+{
+    /* let the holder of the console print, whatever its priority */
+    vTaskDelay(1);
+}
+
+static bool __xlog_acquire_console(void)
+{
+    bool retval = true;
+
+    if(xlog_console_mutex) {
+        /* the holder of the console prints our line too */
+        retval = (xSemaphoreTake(xlog_console_mutex, 0) == pdTRUE);
+    }
+
+    return retval;
+}
+#else
 static bool __xlog_acquire_console(void)
 {
     if(xlog_console_mutex) {
@@ -58,6 +93,7 @@ static bool __xlog_acquire_console(void)
 
     return true;
 }
+#endif
 
 static void __xlog_release_console(void)
 {
@@ -66,12 +102,35 @@ static void __xlog_release_console(void)
     }
 }
 
-static void __xlog_print(const char *str, uint32_t length)
+static void __xlog_get_timestamp_us(uint64_t *us)
 {
-    for(uint32_t i = 0; i < length; ++i) {
-        printf("%c", str[i]);
+    *us = (uint64_t)esp_timer_get_time();
+}
+
+#ifdef CONFIG_XLOG_ISR
+static uint32_t __xlog_core_id(void)
+{
+    return (uint32_t)xPortGetCoreID();
+}
+#endif
+
+#if defined(CONFIG_XLOG_DEFERRED) || defined(CONFIG_XLOG_ASYNC) || defined(CONFIG_XLOG_ISR)
+static void __xlog_notify(void)
+{
+    if(xlog_task) {
+        xTaskNotifyGive(xlog_task);
+    }
+}
+
+static void __xlog_task(void *args)
+{
+    for(;;) {
+        /* deferred lines and lines of interrupts are not notified, poll them */
+        ulTaskNotifyTake(pdTRUE, __ms2ticks(XLOG_TASK_PERIOD_MS));
+        xlog_process();
     }
 }
+#endif
 
 static inline void __xlog_init(void)
 {
@@ -86,8 +145,25 @@ static inline void __xlog_init(void)
     ops.unlock = __xlog_buf_unlock;
     ops.acquire_console = __xlog_acquire_console;
     ops.release_console = __xlog_release_console;
-    ops.print = __xlog_print;
+#ifdef CONFIG_XLOG_LOCKLESS
+    ops.suspend = __xlog_suspend;
+    ops.resume = __xlog_resume;
+    ops.yield = __xlog_yield;
+#endif
+#if defined(CONFIG_XLOG_DEFERRED) || defined(CONFIG_XLOG_ASYNC) || defined(CONFIG_XLOG_ISR)
+    ops.notify = __xlog_notify;
+#endif
+#ifdef CONFIG_XLOG_ISR
+    ops.core_id = __xlog_core_id;
+#endif
+    /* the clock of the rate limits, and of the line prefixes with CONFIG_XLOG_TIMESTAMP_MONOTONIC */
+    ops.get_timestamp_us = __xlog_get_timestamp_us;
+    ops.print_v = xlog_print_v;
     xlog_init(&ops);
+#if defined(CONFIG_XLOG_DEFERRED) || defined(CONFIG_XLOG_ASYNC) || defined(CONFIG_XLOG_ISR)
+    /* format the deferred lines and drain the log buffer at low priority */
+    xTaskCreate(__xlog_task, "xlog", XLOG_TASK_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, &xlog_task);
+#endif
 }
 
 static void _init(void)
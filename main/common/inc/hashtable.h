@@ -0,0 +1,361 @@
+/**
+ * @file common/inc/hashtable.h
+ *
+ * Copyright (C) 2022
+ *
+ * hashtable.h is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Intrusive hash table of hlist buckets.
+ *
+ * The struct hash_node is embedded in the entry like a list_head and
+ * keeps the hash of the key, the entry is got back by container_of().
+ * The table allocates nothing, the bucket arrays are given by the user.
+ * When hash_table_grow_needed() tells so, a bucket array twice as big
+ * is given to hash_table_resize(), the nodes are then moved into it a
+ * few buckets at a time by each add and del, so that no single call
+ * pays the whole rehash. The buckets are picked by the high bits of
+ * the hash, so the nodes of an old bucket go to buckets of their own
+ * in the new array: the keys of an old bucket stay in it until it is
+ * moved, and the new buckets are cleared only when their old bucket is
+ * moved. The old array is given back by the release callback once it
+ * is empty.
+ *
+ *     struct attr {
+ *         const char *name;
+ *         struct hash_node node;
+ *     };
+ *
+ *     static bool attr_match(const struct hash_node *node, const void *key)
+ *     {
+ *         return !strcmp(container_of(node, struct attr, node)->name, key);
+ *     }
+ *
+ *     hash_table_add(&table, &attr->node, hash_str(attr->name));
+ *     node = hash_table_find(&table, hash_str(name), attr_match, name);
+ *
+ * Nothing is locked, the user serializes the accesses.
+ */
+#ifndef __HASHTABLE_H
+#define __HASHTABLE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*---------- includes ----------*/
+#include "lists.h"
+
+/*---------- macro ----------*/
+/* old buckets moved by each add and del while resizing, with 2 a table
+ * growing at a load of 1 is done moving before it needs to grow again
+ */
+#ifndef CONFIG_HASH_TABLE_MOVE_STEP
+#define CONFIG_HASH_TABLE_MOVE_STEP         (2)
+#endif
+
+/* buckets of a table of 2^shift buckets
+ */
+#define HASH_TABLE_BUCKETS(shift)           (1UL << (shift))
+
+/*---------- type define ----------*/
+struct hash_node {
+    struct hlist_node node;
+    uint32_t hash;                                  /*<< hash of the key, kept for the resizing */
+};
+
+/**
+ * @brief Tell whether a node has the key looked for, only the nodes
+ * with the same hash are given.
+ * @param node: the node to test.
+ * @param key: the key given to hash_table_find().
+ * @retval true: @node has the key.
+ *         false: @node has not the key.
+ */
+typedef bool (*hash_table_match_t)(const struct hash_node *node, const void *key);
+
+/**
+ * @brief Give back a bucket array the table does not use anymore.
+ * @param buckets: the bucket array.
+ * @retval None
+ */
+typedef void (*hash_table_release_t)(struct hlist_head *buckets);
+
+struct hash_table {
+    struct hlist_head *buckets;
+    struct hlist_head *old;                         /*<< buckets being moved, NULL if not resizing */
+    uint32_t shift;                                 /*<< 2^shift buckets */
+    uint32_t old_shift;
+    uint32_t moved;                                 /*<< old buckets below it are moved */
+    uint32_t count;
+    hash_table_release_t release;
+};
+
+/*---------- variable prototype ----------*/
+/*---------- function prototype ----------*/
+/**
+ * @brief FNV-1a hash of a string.
+ * @param s: the string.
+ * @retval the hash.
+ */
+static inline uint32_t hash_str(const char *s)
+{
+    uint32_t hash = 2166136261UL;
+
+    for(; *s; ++s) {
+        hash = (hash ^ (uint8_t)*s) * 16777619UL;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief FNV-1a hash of a buffer.
+ * @param buf: the buffer.
+ * @param len: the length of the buffer.
+ * @retval the hash.
+ */
+static inline uint32_t hash_mem(const void *buf, uint32_t len)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    uint32_t hash = 2166136261UL;
+
+    for(; len; --len, ++p) {
+        hash = (hash ^ *p) * 16777619UL;
+    }
+
+    return hash;
+}
+
+/*
+ * Bucket of a hash in a table of 2^shift buckets. The hash is mixed
+ * first, so that small integer keys can be used as their own hash.
+ */
+static inline uint32_t __hash_index(uint32_t hash, uint32_t shift)
+{
+    return shift ? ((uint32_t)(hash * 2654435761UL) >> (32 - shift)) : 0;
+}
+
+static inline void __hash_buckets_init(struct hlist_head *buckets, uint32_t n)
+{
+    for(; n; --n, ++buckets) {
+        INIT_HLIST_HEAD(buckets);
+    }
+}
+
+/*
+ * Bucket of a hash, in the old array if its bucket there is not moved yet.
+ */
+static inline struct hlist_head *__hash_bucket(const struct hash_table *tbl, uint32_t hash)
+{
+    struct hlist_head *retval = NULL;
+    uint32_t index = 0;
+
+    if(tbl->old) {
+        index = __hash_index(hash, tbl->old_shift);
+        if(index >= tbl->moved) {
+            retval = &tbl->old[index];
+        }
+    }
+    if(!retval) {
+        retval = &tbl->buckets[__hash_index(hash, tbl->shift)];
+    }
+
+    return retval;
+}
+
+/*
+ * Move the next old bucket, the new buckets it is the first to fill
+ * are cleared before.
+ */
+static inline void __hash_bucket_move(struct hash_table *tbl)
+{
+    struct hlist_head *head = &tbl->old[tbl->moved];
+    struct hlist_node *pos = NULL;
+    uint32_t d = 0;
+
+    if(tbl->shift >= tbl->old_shift) {
+        d = tbl->shift - tbl->old_shift;
+        __hash_buckets_init(&tbl->buckets[tbl->moved << d], HASH_TABLE_BUCKETS(d));
+    } else {
+        d = tbl->old_shift - tbl->shift;
+        if(!(tbl->moved & (HASH_TABLE_BUCKETS(d) - 1))) {
+            INIT_HLIST_HEAD(&tbl->buckets[tbl->moved >> d]);
+        }
+    }
+    while((pos = head->first) != NULL) {
+        hlist_del(pos);
+        hlist_add_head(pos, &tbl->buckets[__hash_index(hlist_entry(pos, struct hash_node, node)->hash,
+                                                       tbl->shift)]);
+    }
+    tbl->moved++;
+}
+
+static inline struct hash_node *__hash_bucket_find(const struct hlist_head *head, uint32_t hash,
+                                                   hash_table_match_t match, const void *key)
+{
+    struct hash_node *pos = NULL;
+
+    hlist_for_each_entry(pos, struct hash_node, head, node) {
+        if(pos->hash == hash && match(pos, key)) {
+            break;
+        }
+    }
+
+    return pos;
+}
+
+/**
+ * @brief Initialize an empty hash table.
+ * @param tbl: the table.
+ * @param buckets: an array of 2^shift buckets.
+ * @param shift: log2 of the number of buckets.
+ * @param release: gets the arrays the table is done with after a resize,
+ * could be NULL.
+ * @retval None
+ */
+static inline void hash_table_init(struct hash_table *tbl, struct hlist_head *buckets, uint32_t shift,
+                                   hash_table_release_t release)
+{
+    __hash_buckets_init(buckets, HASH_TABLE_BUCKETS(shift));
+    tbl->buckets = buckets;
+    tbl->old = NULL;
+    tbl->shift = shift;
+    tbl->old_shift = 0;
+    tbl->moved = 0;
+    tbl->count = 0;
+    tbl->release = release;
+}
+
+/**
+ * @brief Move up to @n buckets of a resize in progress, the ones
+ * add and del do not get to can be moved when idle.
+ * @param tbl: the table.
+ * @param n: the number of old buckets to move.
+ * @retval true: no resize is in progress anymore.
+ *         false: there are old buckets left.
+ */
+static inline bool hash_table_move(struct hash_table *tbl, uint32_t n)
+{
+    struct hlist_head *old = tbl->old;
+
+    for(; old && n; --n) {
+        __hash_bucket_move(tbl);
+        if(tbl->moved == HASH_TABLE_BUCKETS(tbl->old_shift)) {
+            tbl->old = NULL;
+            if(tbl->release) {
+                tbl->release(old);
+            }
+            old = NULL;
+        }
+    }
+
+    return (!old);
+}
+
+/**
+ * @brief Tell whether the table should grow, ie. it has more entries
+ * than buckets and is not resizing already.
+ * @param tbl: the table.
+ * @retval true: a table of 2^(shift + 1) buckets should be given to
+ * hash_table_resize().
+ *         false: the table is fine as it is.
+ */
+static inline bool hash_table_grow_needed(const struct hash_table *tbl)
+{
+    return (!tbl->old && tbl->count > HASH_TABLE_BUCKETS(tbl->shift));
+}
+
+/**
+ * @brief Start moving the table into a new bucket array, it can be
+ * smaller or bigger. A resize in progress is finished first.
+ * @param tbl: the table.
+ * @param buckets: an array of 2^shift buckets, it does not need to be
+ * initialized.
+ * @param shift: log2 of the number of buckets.
+ * @retval None
+ */
+static inline void hash_table_resize(struct hash_table *tbl, struct hlist_head *buckets, uint32_t shift)
+{
+    hash_table_move(tbl, UINT32_MAX);
+    tbl->old = tbl->buckets;
+    tbl->old_shift = tbl->shift;
+    tbl->moved = 0;
+    tbl->buckets = buckets;
+    tbl->shift = shift;
+    hash_table_move(tbl, CONFIG_HASH_TABLE_MOVE_STEP);
+}
+
+/**
+ * @brief Add a node to the table, the keys are not checked for
+ * duplicates.
+ * @param tbl: the table.
+ * @param node: the node to be added.
+ * @param hash: the hash of the key of the node.
+ * @retval None
+ */
+static inline void hash_table_add(struct hash_table *tbl, struct hash_node *node, uint32_t hash)
+{
+    node->hash = hash;
+    hlist_add_head(&node->node, __hash_bucket(tbl, hash));
+    tbl->count++;
+    hash_table_move(tbl, CONFIG_HASH_TABLE_MOVE_STEP);
+}
+
+/**
+ * @brief Delete a node from the table.
+ * @param tbl: the table.
+ * @param node: the node to be deleted, which must be in the table.
+ * @retval None
+ */
+static inline void hash_table_del(struct hash_table *tbl, struct hash_node *node)
+{
+    hlist_del(&node->node);
+    tbl->count--;
+    hash_table_move(tbl, CONFIG_HASH_TABLE_MOVE_STEP);
+}
+
+/**
+ * @brief Find a node of the table by its key, a single bucket is
+ * searched, even while resizing.
+ * @param tbl: the table.
+ * @param hash: the hash of the key.
+ * @param match: tells whether a node has the key.
+ * @param key: the key given to @match.
+ * @retval the node found or NULL.
+ */
+static inline struct hash_node *hash_table_find(const struct hash_table *tbl, uint32_t hash,
+                                                hash_table_match_t match, const void *key)
+{
+    return __hash_bucket_find(__hash_bucket(tbl, hash), hash, match, key);
+}
+
+/**
+ * @brief Get the number of nodes in the table.
+ * @param tbl: the table.
+ * @retval the number of nodes.
+ */
+static inline uint32_t hash_table_count(const struct hash_table *tbl)
+{
+    return tbl->count;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __HASHTABLE_H */
@@ -27,6 +27,15 @@
  * sometimes we already know the next/prev entries and we can
  * generate better code by using them directly rather than
  * using the generic single-entry routines.
+ *
+ * Double linked lists with a single pointer list head(hlist) are
+ * mostly useful for hash tables, where the two pointer list head
+ * is too wasteful. The list tail can not be reached in O(1).
+ *
+ * The _rcu variants let readers walk a list while one writer at a
+ * time changes it, without any lock on the reader side. The writers
+ * serialize among themselves, and a deleted entry can only be freed
+ * after all the readers are done with it, see qsbr.h.
  */
 #ifndef __LIST_HEAD_H
 #define __LIST_HEAD_H
@@ -272,12 +281,147 @@ extern "C"
  */
 #define list_safe_reset_next(pos, n, type, member)      n = list_next_entry(pos, type, member)
 
+/* initialize hlist head
+ */
+#define HLIST_HEAD_INIT                             {NULL}
+#define HLIST_HEAD(name)                            struct hlist_head name = HLIST_HEAD_INIT
+
+/**
+ * @brief Get the struct for this hlist entry.
+ * @param ptr: the &struct hlist_node pointer.
+ * @param type: the type of the struct this is embeded in.
+ * @param member: the name of the hlist_node within the struct.
+ */
+#define hlist_entry(ptr, type, member)              container_of(ptr, type, member)
+
+/**
+ * @brief Get the struct for this hlist entry.
+ * @note That if @ptr is NULL, it returns NULL.
+ * @param ptr: the &struct hlist_node pointer.
+ * @param type: the type of the struct this is embeded in.
+ * @param member: the name of the hlist_node within the struct.
+ */
+#define hlist_entry_safe(ptr, type, member)         ((ptr) ? hlist_entry(ptr, type, member) : NULL)
+
+/**
+ * @brief iterate over a hlist.
+ * @param pos: the &struct hlist_node to use as a loop cursor.
+ * @param head: the head for your hlist.
+ */
+#define hlist_for_each(pos, head)                   for(pos = (head)->first; pos; pos = pos->next)
+
+/**
+ * @brief iterate over a hlist safe against removal of hlist entry.
+ * @param pos: the &struct hlist_node to use as a loop cursor.
+ * @param n: another &struct hlist_node to use as temporary storage.
+ * @param head: the head for your hlist.
+ */
+#define hlist_for_each_safe(pos, n, head)           for(pos = (head)->first; pos && (n = pos->next, true); \
+                                                        pos = n)
+
+/**
+ * @brief Iterate over hlist of given type.
+ * @param pos: the type * to use as a loop cursor.
+ * @param type: the type of the struct this is embeded in.
+ * @param head: the head for your hlist.
+ * @param member: the name of the hlist_node within the struct.
+ */
+#define hlist_for_each_entry(pos, type, head, member)               \
+        for(pos = hlist_entry_safe((head)->first, type, member);    \
+            pos;                                                    \
+            pos = hlist_entry_safe(pos->member.next, type, member))
+
+/**
+ * @brief Continue iteration over hlist of given type.
+ * @param pos: the type * to use as a loop cursor.
+ * @param type: the type of the struct this is embeded in.
+ * @param member: the name of the hlist_node within the struct.
+ */
+#define hlist_for_each_entry_continue(pos, type, member)            \
+        for(pos = hlist_entry_safe(pos->member.next, type, member); \
+            pos;                                                    \
+            pos = hlist_entry_safe(pos->member.next, type, member))
+
+/**
+ * @brief Iterate over hlist of given type safe against removal of
+ * hlist entry.
+ * @param pos: the type * to use as a loop cursor.
+ * @param n: a &struct hlist_node to use as temporary storage.
+ * @param type: the type of the struct this is embeded in.
+ * @param head: the head for your hlist.
+ * @param member: the name of the hlist_node within the struct.
+ */
+#define hlist_for_each_entry_safe(pos, n, type, head, member)       \
+        for(pos = hlist_entry_safe((head)->first, type, member);    \
+            pos && (n = pos->member.next, true);                    \
+            pos = hlist_entry_safe(n, type, member))
+
+/**
+ * @brief Publish a pointer to an entry which readers may follow, the
+ * entry is initialized before the pointer can be seen.
+ * @param p: the pointer to be assigned.
+ * @param v: the value to assign.
+ */
+#define rcu_assign_pointer(p, v)                    __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+/**
+ * @brief Read a pointer published by rcu_assign_pointer(), the entry
+ * it points to is seen initialized.
+ * @param p: the pointer to be read.
+ */
+#define rcu_dereference(p)                          __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+
+/**
+ * @brief Iterate over list of given type, while it may be changed by
+ * the _rcu functions.
+ * @param pos: the type * to use as a loop cursor.
+ * @param type: the type of the struct this is embeded in.
+ * @param head: the head for your list.
+ * @param member: the name of the list_struct within the struct.
+ */
+#define list_for_each_entry_rcu(pos, type, head, member)                    \
+        for(pos = list_entry(rcu_dereference((head)->next), type, member);  \
+            &pos->member != (head);                                         \
+            pos = list_entry(rcu_dereference(pos->member.next), type, member))
+
+/**
+ * @brief Iterate over hlist of given type, while it may be changed by
+ * the _rcu functions.
+ * @param pos: the type * to use as a loop cursor.
+ * @param type: the type of the struct this is embeded in.
+ * @param head: the head for your hlist.
+ * @param member: the name of the hlist_node within the struct.
+ */
+#define hlist_for_each_entry_rcu(pos, type, head, member)                           \
+        for(pos = (type *)__hlist_entry_rcu(&(head)->first, offsetof(type, member));  \
+            pos;                                                                    \
+            pos = (type *)__hlist_entry_rcu(&pos->member.next, offsetof(type, member)))
+
 /*---------- type define ----------*/
 struct list_head {
     struct list_head *next;
     struct list_head *prev;
 };
 
+/**
+ * @brief Compare two entries for list_sort().
+ * @param priv: the private data given to list_sort().
+ * @param a: the first entry.
+ * @param b: the second entry.
+ * @retval > 0: @a goes after @b.
+ *         <= 0: @a goes before @b, or they keep their order.
+ */
+typedef int (*list_cmp_func_t)(void *priv, const struct list_head *a, const struct list_head *b);
+
+struct hlist_node {
+    struct hlist_node *next;
+    struct hlist_node **pprev;                      /*<< the next pointer which points to this node */
+};
+
+struct hlist_head {
+    struct hlist_node *first;
+};
+
 /*---------- variable prototype ----------*/
 /*---------- function prototype ----------*/
 /**
@@ -598,6 +742,396 @@ static inline void list_splice_tail_init(struct list_head *list, struct list_hea
     }
 }
 
+/*
+ * Merge two NULL terminated lists of sorted entries, the prev pointers
+ * are left as they are. Entries of a go first when they compare equal.
+ */
+static inline struct list_head *__list_merge(void *priv, list_cmp_func_t cmp, struct list_head *a,
+                                             struct list_head *b)
+{
+    struct list_head *head = NULL, **tail = &head;
+
+    while(true) {
+        if(cmp(priv, a, b) <= 0) {
+            *tail = a;
+            tail = &a->next;
+            a = a->next;
+            if(!a) {
+                *tail = b;
+                break;
+            }
+        } else {
+            *tail = b;
+            tail = &b->next;
+            b = b->next;
+            if(!b) {
+                *tail = a;
+                break;
+            }
+        }
+    }
+
+    return head;
+}
+
+/*
+ * Merge the two last lists into head and restore the prev pointers
+ * and the circular links.
+ */
+static inline void __list_merge_final(void *priv, list_cmp_func_t cmp, struct list_head *head,
+                                      struct list_head *a, struct list_head *b)
+{
+    struct list_head *tail = head;
+
+    while(true) {
+        if(cmp(priv, a, b) <= 0) {
+            tail->next = a;
+            a->prev = tail;
+            tail = a;
+            a = a->next;
+            if(!a) {
+                break;
+            }
+        } else {
+            tail->next = b;
+            b->prev = tail;
+            tail = b;
+            b = b->next;
+            if(!b) {
+                b = a;
+                break;
+            }
+        }
+    }
+    tail->next = b;
+    do {
+        b->prev = tail;
+        tail = b;
+        b = b->next;
+    } while(b);
+    tail->next = head;
+    head->prev = tail;
+}
+
+/**
+ * @brief Sort a list in place, the order of equal entries is kept.
+ * Description:
+ * bottom-up merge sort in O(n log n) compares. The entries are taken
+ * one at a time into pending lists of power of two sizes, chained by
+ * their prev pointers, and two of the same size are merged as soon as
+ * a third one follows, so that merges stay balanced at 2:1 at worst
+ * and the pending lists fit in the cache. Nothing is allocated and the
+ * stack use is constant.
+ * @param priv: private data given to @cmp.
+ * @param head: the list to sort.
+ * @param cmp: compares two entries.
+ * @retval None
+ */
+static inline void list_sort(void *priv, struct list_head *head, list_cmp_func_t cmp)
+{
+    struct list_head *list = head->next, *pending = NULL, *next = NULL, *a = NULL, *b = NULL;
+    struct list_head **tail = NULL;
+    size_t count = 0, bits = 0;
+
+    do {
+        if(list == head->prev) {
+            /* zero or one entry */
+            break;
+        }
+        head->prev->next = NULL;
+        /* the bits of count tell the sizes of the pending lists, the
+         * lowest clear bit of it is where two lists are merged
+         */
+        do {
+            tail = &pending;
+            for(bits = count; bits & 1; bits >>= 1) {
+                tail = &(*tail)->prev;
+            }
+            if(bits) {
+                a = *tail;
+                b = a->prev;
+                a = __list_merge(priv, cmp, b, a);
+                a->prev = b->prev;
+                *tail = a;
+            }
+            list->prev = pending;
+            pending = list;
+            list = list->next;
+            pending->next = NULL;
+            count++;
+        } while(list);
+        /* merge all the pending lists, the smallest first */
+        list = pending;
+        pending = pending->prev;
+        while((next = pending->prev) != NULL) {
+            list = __list_merge(priv, cmp, pending, list);
+            pending = next;
+        }
+        __list_merge_final(priv, cmp, head, pending, list);
+    } while(0);
+}
+
+/**
+ * @brief Initialize the hlist to an empty hlist.
+ * @param head: hlist head will be initialize.
+ * @retval None
+ */
+static inline void INIT_HLIST_HEAD(struct hlist_head *head)
+{
+    head->first = NULL;
+}
+
+/**
+ * @brief Initialize a hlist node, it is unhashed after this.
+ * @param node: hlist node will be initialize.
+ * @retval None
+ */
+static inline void INIT_HLIST_NODE(struct hlist_node *node)
+{
+    node->next = NULL;
+    node->pprev = NULL;
+}
+
+/**
+ * @brief Test whether a node is not in any hlist.
+ * @param node: the node to test.
+ * @retval true: @node has been initialized or deleted by hlist_del_init().
+ *         false: @node is in a hlist.
+ */
+static inline bool hlist_unhashed(const struct hlist_node *node)
+{
+    return (!node->pprev);
+}
+
+/**
+ * @brief Test whether a hlist is empty.
+ * @param head: the hlist to test.
+ * @retval true: @head is an empty hlist.
+ *         false: @head is not an empty hlist.
+ */
+static inline bool hlist_empty(const struct hlist_head *head)
+{
+    return (!head->first);
+}
+
+static inline void __hlist_del(struct hlist_node *node)
+{
+    struct hlist_node *next = node->next;
+    struct hlist_node **pprev = node->pprev;
+
+    *pprev = next;
+    if(next) {
+        next->pprev = pprev;
+    }
+}
+
+/**
+ * @brief Deletes entry from hlist.
+ * @note hlist_unhashed() on entry returns true after this, as its
+ * pointers are cleared, so hlist_del_init() on it does nothing.
+ * @param node: the element to delete from the hlist.
+ * @retval None
+ */
+static inline void hlist_del(struct hlist_node *node)
+{
+    __hlist_del(node);
+    node->next = NULL;
+    node->pprev = NULL;
+}
+
+/**
+ * @brief Deletes entry from hlist and reinitialize it, nothing is
+ * done if the entry is not in a hlist.
+ * @param node: the element to delete from the hlist.
+ * @retval None
+ */
+static inline void hlist_del_init(struct hlist_node *node)
+{
+    if(!hlist_unhashed(node)) {
+        __hlist_del(node);
+        INIT_HLIST_NODE(node);
+    }
+}
+
+/**
+ * @brief Add a new entry at the beginning of the hlist.
+ * @param pnew: new entry to be added.
+ * @param head: hlist head to add it after.
+ * @retval None
+ */
+static inline void hlist_add_head(struct hlist_node *pnew, struct hlist_head *head)
+{
+    struct hlist_node *first = head->first;
+
+    pnew->next = first;
+    if(first) {
+        first->pprev = &pnew->next;
+    }
+    head->first = pnew;
+    pnew->pprev = &head->first;
+}
+
+/**
+ * @brief Add a new entry before the one specified.
+ * @param pnew: new entry to be added.
+ * @param next: hlist node to add it before, which must be non-NULL.
+ * @retval None
+ */
+static inline void hlist_add_before(struct hlist_node *pnew, struct hlist_node *next)
+{
+    pnew->pprev = next->pprev;
+    pnew->next = next;
+    next->pprev = &pnew->next;
+    *(pnew->pprev) = pnew;
+}
+
+/**
+ * @brief Add a new entry after the one specified.
+ * @param pnew: new entry to be added.
+ * @param prev: hlist node to add it after, which must be non-NULL.
+ * @retval None
+ */
+static inline void hlist_add_behind(struct hlist_node *pnew, struct hlist_node *prev)
+{
+    pnew->next = prev->next;
+    prev->next = pnew;
+    pnew->pprev = &prev->next;
+    if(pnew->next) {
+        pnew->next->pprev = &pnew->next;
+    }
+}
+
+/**
+ * @brief Move a hlist from one hlist head to another, fix up the
+ * pprev reference of the first entry if it exists.
+ * @param old: hlist head for old hlist.
+ * @param pnew: hlist head for new hlist.
+ * @retval None
+ */
+static inline void hlist_move_list(struct hlist_head *old, struct hlist_head *pnew)
+{
+    pnew->first = old->first;
+    if(pnew->first) {
+        pnew->first->pprev = &pnew->first;
+    }
+    old->first = NULL;
+}
+
+/*
+ * Read a hlist pointer once and get the entry it points to, the NULL
+ * test of hlist_entry_safe() would read it twice.
+ */
+static inline void *__hlist_entry_rcu(struct hlist_node *const *ptr, size_t offset)
+{
+    struct hlist_node *node = rcu_dereference(*ptr);
+
+    return node ? (void *)((char *)node - offset) : NULL;
+}
+
+static inline void __list_add_rcu(struct list_head *pnew, struct list_head *prev, struct list_head *next)
+{
+    pnew->next = next;
+    pnew->prev = prev;
+    rcu_assign_pointer(prev->next, pnew);
+    next->prev = pnew;
+}
+
+/**
+ * @brief Add a new entry after the specified head, while readers may
+ * walk the list with list_for_each_entry_rcu().
+ * @param pnew: new entry to be added.
+ * @param head: list head to add it after.
+ * @retval None
+ */
+static inline void list_add_rcu(struct list_head *pnew, struct list_head *head)
+{
+    __list_add_rcu(pnew, head, head->next);
+}
+
+/**
+ * @brief Add a new entry before the specified head, while readers may
+ * walk the list with list_for_each_entry_rcu().
+ * @param pnew: new entry to be added.
+ * @param head: list head to add it before.
+ * @retval None
+ */
+static inline void list_add_tail_rcu(struct list_head *pnew, struct list_head *head)
+{
+    __list_add_rcu(pnew, head->prev, head);
+}
+
+/**
+ * @brief Deletes entry from list, while readers may walk the list with
+ * list_for_each_entry_rcu().
+ * @note The next pointer of the entry is kept for the readers still on
+ * it, the entry must not be freed or reused until they are done, see
+ * qsbr_synchronize().
+ * @param entry: the element to delete from the list.
+ * @retval None
+ */
+static inline void list_del_rcu(struct list_head *entry)
+{
+    __atomic_store_n(&entry->prev->next, entry->next, __ATOMIC_RELAXED);
+    entry->next->prev = entry->prev;
+    entry->prev = NULL;
+}
+
+/**
+ * @brief Replace old entry by new one, while readers may walk the list
+ * with list_for_each_entry_rcu().
+ * @note The old entry must not be freed or reused until the readers are
+ * done, see qsbr_synchronize().
+ * @param old: The elemnet to be replaced.
+ * @param pnew: The new element to insert.
+ * @retval None
+ */
+static inline void list_replace_rcu(struct list_head *old, struct list_head *pnew)
+{
+    pnew->next = old->next;
+    pnew->prev = old->prev;
+    rcu_assign_pointer(pnew->prev->next, pnew);
+    pnew->next->prev = pnew;
+    old->prev = NULL;
+}
+
+/**
+ * @brief Add a new entry at the beginning of the hlist, while readers
+ * may walk the hlist with hlist_for_each_entry_rcu().
+ * @param pnew: new entry to be added.
+ * @param head: hlist head to add it after.
+ * @retval None
+ */
+static inline void hlist_add_head_rcu(struct hlist_node *pnew, struct hlist_head *head)
+{
+    struct hlist_node *first = head->first;
+
+    pnew->next = first;
+    pnew->pprev = &head->first;
+    rcu_assign_pointer(head->first, pnew);
+    if(first) {
+        first->pprev = &pnew->next;
+    }
+}
+
+/**
+ * @brief Deletes entry from hlist, while readers may walk the hlist with
+ * hlist_for_each_entry_rcu().
+ * @note The entry must not be freed or reused until the readers are
+ * done, see qsbr_synchronize().
+ * @param node: the element to delete from the hlist.
+ * @retval None
+ */
+static inline void hlist_del_rcu(struct hlist_node *node)
+{
+    struct hlist_node *next = node->next;
+
+    __atomic_store_n(node->pprev, next, __ATOMIC_RELAXED);
+    if(next) {
+        next->pprev = node->pprev;
+    }
+    node->pprev = NULL;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -78,14 +78,16 @@ extern "C"
 #define COLOR_GREEN                     "\033[32;22m"
 #define COLOR_WHITE                     "\033[37;22m"
 
+/* the colors are those of the log levels, the buffer is dumped by xlog_hexdump(),
+ * at the default log level for any other string
+ */
+#define COLOR_LOG_LEVEL(color)          (!strcmp((color), COLOR_RED) ? LOG_ERROR :         \
+                                         !strcmp((color), COLOR_YELLOW) ? LOG_WARN :       \
+                                         !strcmp((color), COLOR_GREEN) ? LOG_MESSAGE :     \
+                                         !strcmp((color), COLOR_WHITE) ? LOG_INFO : LOG_DEFAULT)
+
 #define PRINT_BUFFER_CONTENT(color, tag, buf, length)   \
-        do {                                            \
-            xlog_cont("%s%s: ", color, tag);            \
-            for(uint32_t i = 0; i < length; ++i) {      \
-                xlog_cont("%02X ", buf[i]);             \
-            }                                           \
-            xlog_cont("\b\n");                          \
-        } while(0);
+        xlog_hexdump(COLOR_LOG_LEVEL(color), tag, buf, length)
 
 /*---------- type define ----------*/
 typedef struct protocol_callback *protocol_callback_t;
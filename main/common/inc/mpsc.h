@@ -0,0 +1,162 @@
+/**
+ * @file common/inc/mpsc.h
+ *
+ * Copyright (C) 2022
+ *
+ * mpsc.h is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Intrusive lock-free multi-producer single-consumer queue(D. Vyukov).
+ *
+ * The struct mpsc_node is embedded in the entry like a list_head, the
+ * entry is handed over by its pointer, nothing is copied or allocated.
+ * A push is an atomic exchange and a store, it never waits and can be
+ * done from any task, core or ISR. Only one task pops.
+ *
+ * Between the exchange and the store of a push, the entries pushed
+ * after it can not be popped yet: mpsc_pop() returns NULL until the
+ * push is done. So the consumer must not take NULL for an empty queue
+ * for good, each producer should notify the consumer(eg. a task
+ * notification) after its push, the consumer then pops until NULL.
+ */
+#ifndef __MPSC_H
+#define __MPSC_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*---------- includes ----------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "misc.h"
+
+/*---------- macro ----------*/
+/**
+ * @brief Get the struct for this queue entry.
+ * @param ptr: the &struct mpsc_node pointer.
+ * @param type: the type of the struct this is embeded in.
+ * @param member: the name of the mpsc_node within the struct.
+ */
+#define mpsc_entry(ptr, type, member)               container_of(ptr, type, member)
+
+/*---------- type define ----------*/
+struct mpsc_node {
+    struct mpsc_node *next;
+};
+
+struct mpsc_queue {
+    struct mpsc_node *head;                         /*<< last node pushed, exchanged by the producers */
+    struct mpsc_node *tail;                         /*<< next node popped, only used by the consumer */
+    struct mpsc_node stub;                          /*<< keeps the queue non-empty, see mpsc_pop() */
+};
+
+/*---------- variable prototype ----------*/
+/*---------- function prototype ----------*/
+/**
+ * @brief Initialize an empty queue.
+ * @param q: the queue.
+ * @retval None
+ */
+static inline void mpsc_init(struct mpsc_queue *q)
+{
+    q->stub.next = NULL;
+    q->head = &q->stub;
+    q->tail = &q->stub;
+}
+
+/**
+ * @brief Push an entry at the end of the queue, it can be called from
+ * any task, core or ISR.
+ * @param q: the queue.
+ * @param node: the entry to be pushed.
+ * @retval None
+ */
+static inline void mpsc_push(struct mpsc_queue *q, struct mpsc_node *node)
+{
+    struct mpsc_node *prev = NULL;
+
+    node->next = NULL;
+    prev = __atomic_exchange_n(&q->head, node, __ATOMIC_ACQ_REL);
+    /* the entries after node can not be popped until this store */
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Pop the first entry of the queue, it must be called by the
+ * consumer only.
+ * @param q: the queue.
+ * @retval the entry popped, NULL if the queue is empty or a push is not
+ * done yet.
+ */
+static inline struct mpsc_node *mpsc_pop(struct mpsc_queue *q)
+{
+    struct mpsc_node *retval = NULL, *tail = q->tail;
+    struct mpsc_node *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    do {
+        if(tail == &q->stub) {
+            /* skip the stub */
+            if(!next) {
+                break;
+            }
+            q->tail = next;
+            tail = next;
+            next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+        }
+        if(next) {
+            q->tail = next;
+            retval = tail;
+            break;
+        }
+        if(tail != __atomic_load_n(&q->head, __ATOMIC_ACQUIRE)) {
+            /* a push is not done */
+            break;
+        }
+        /* tail is the last entry, the stub is pushed behind it so
+         * that it can be taken
+         */
+        mpsc_push(q, &q->stub);
+        next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+        if(next) {
+            q->tail = next;
+            retval = tail;
+        }
+    } while(0);
+
+    return retval;
+}
+
+/**
+ * @brief Test whether the queue is empty, it must be called by the
+ * consumer only.
+ * @param q: the queue.
+ * @retval true: nothing has been pushed since the last entry popped.
+ *         false: there are entries, they may not be popped yet if a
+ * push is not done.
+ */
+static inline bool mpsc_empty(const struct mpsc_queue *q)
+{
+    return (q->tail == &q->stub && __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == &q->stub);
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __MPSC_H */
@@ -0,0 +1,223 @@
+/**
+ * @file common/inc/qsbr.h
+ *
+ * Copyright (C) 2022
+ *
+ * qsbr.h is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Quiescent state based reclamation for the _rcu lists of lists.h.
+ *
+ * Each task reading the lists registers a struct qsbr_reader and, at a
+ * point of its loop where it holds no entry of the lists(eg. before
+ * waiting for its next event), calls qsbr_quiescent(). The readers take
+ * no lock and never wait. A writer deletes an entry with list_del_rcu(),
+ * then qsbr_synchronize() waits until every reader went through a
+ * quiescent state, after which no reader can hold the entry and it can
+ * be freed. A reader blocking for long goes offline first, so that the
+ * writers do not wait for it:
+ *
+ *     qsbr_online(&domain, &reader);
+ *     while(true) {
+ *         list_for_each_entry_rcu(pos, struct sub, &subs, node) {
+ *             pos->notify(event);
+ *         }
+ *         qsbr_offline(&reader);
+ *         xQueueReceive(events, &event, portMAX_DELAY);
+ *         qsbr_online(&domain, &reader);
+ *     }
+ *
+ * The writers, qsbr_register() and qsbr_unregister() are serialized by
+ * the user, ie. they are called under the lock of the writers.
+ */
+#ifndef __QSBR_H
+#define __QSBR_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*---------- includes ----------*/
+#include "options.h"
+#include "lists.h"
+
+/*---------- macro ----------*/
+/* what qsbr_synchronize() does while a reader is not quiescent yet,
+ * between two polls of the readers. The default sleeps the calling task
+ * with __delay_ms(1), one tick at 1000Hz, so that the readers it waits for
+ * can run on its core: a grace period then costs at least a tick. Without
+ * __delay_ms() in the options, it spins.
+ */
+#ifndef CONFIG_QSBR_WAIT
+#ifdef __delay_ms
+#define CONFIG_QSBR_WAIT()                  __delay_ms(1)
+#else
+#define CONFIG_QSBR_WAIT()
+#endif
+#endif
+
+/*---------- type define ----------*/
+struct qsbr_reader {
+    uint32_t seq;                                   /*<< last grace period seen, 0 when offline */
+    struct list_head node;
+};
+
+struct qsbr {
+    uint32_t gp;                                    /*<< current grace period, never 0 */
+    struct list_head readers;
+};
+
+/*---------- variable prototype ----------*/
+/*---------- function prototype ----------*/
+/**
+ * @brief Initialize a reclamation domain without readers.
+ * @param q: the domain.
+ * @retval None
+ */
+static inline void qsbr_init(struct qsbr *q)
+{
+    q->gp = 1;
+    INIT_LIST_HEAD(&q->readers);
+}
+
+/**
+ * @brief Add a reader to the domain, it is offline until qsbr_online().
+ * @param q: the domain.
+ * @param r: the reader.
+ * @retval None
+ */
+static inline void qsbr_register(struct qsbr *q, struct qsbr_reader *r)
+{
+    r->seq = 0;
+    list_add_tail(&r->node, &q->readers);
+}
+
+/**
+ * @brief Remove a reader from the domain, it must be offline.
+ * @param r: the reader.
+ * @retval None
+ */
+static inline void qsbr_unregister(struct qsbr_reader *r)
+{
+    list_del(&r->node);
+}
+
+/**
+ * @brief Tell that the reader holds no entry of the lists, the writers
+ * waiting for it can go on.
+ * @param q: the domain.
+ * @param r: the reader, which must be online.
+ * @retval None
+ */
+static inline void qsbr_quiescent(struct qsbr *q, struct qsbr_reader *r)
+{
+    /* the reads before are done before the store can be seen, the
+     * reads after see what was deleted before the grace period
+     */
+    __atomic_store_n(&r->seq, __atomic_load_n(&q->gp, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Take the reader offline, the writers do not wait for it until
+ * qsbr_online(), it must hold no entry of the lists.
+ * @param r: the reader.
+ * @retval None
+ */
+static inline void qsbr_offline(struct qsbr_reader *r)
+{
+    __atomic_store_n(&r->seq, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Take the reader online, before it reads the lists.
+ * @param q: the domain.
+ * @param r: the reader.
+ * @retval None
+ */
+static inline void qsbr_online(struct qsbr *q, struct qsbr_reader *r)
+{
+    qsbr_quiescent(q, r);
+}
+
+/**
+ * @brief Start a grace period without waiting for it, for the writers
+ * which can not block.
+ * @param q: the domain.
+ * @retval the grace period, given to qsbr_poll().
+ */
+static inline uint32_t qsbr_start(struct qsbr *q)
+{
+    uint32_t retval = __atomic_add_fetch(&q->gp, 1, __ATOMIC_SEQ_CST);
+
+    if(!retval) {
+        /* 0 means offline */
+        retval = __atomic_add_fetch(&q->gp, 1, __ATOMIC_SEQ_CST);
+    }
+
+    return retval;
+}
+
+/**
+ * @brief Test whether a grace period is over, ie. every reader online
+ * went through a quiescent state since it started.
+ * @param q: the domain.
+ * @param gp: the grace period got by qsbr_start().
+ * @retval true: the entries deleted before qsbr_start() can be freed.
+ *         false: some reader may still hold them.
+ */
+static inline bool qsbr_poll(struct qsbr *q, uint32_t gp)
+{
+    struct qsbr_reader *r = NULL;
+    uint32_t seq = 0;
+    bool retval = true;
+
+    list_for_each_entry(r, struct qsbr_reader, &q->readers, node) {
+        seq = __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE);
+        if(seq && (int32_t)(seq - gp) < 0) {
+            retval = false;
+            break;
+        }
+    }
+
+    return retval;
+}
+
+/**
+ * @brief Wait until every reader online went through a quiescent state,
+ * the entries deleted before can then be freed. It must not be called by
+ * a reader online. It blocks in CONFIG_QSBR_WAIT(), ie. the calling task
+ * sleeps by default, so it must not be called from an ISR, in a critical
+ * section or with the scheduler suspended, the writers which can not block
+ * use qsbr_start() and qsbr_poll() instead.
+ * @param q: the domain.
+ * @retval None
+ */
+static inline void qsbr_synchronize(struct qsbr *q)
+{
+    uint32_t gp = qsbr_start(q);
+
+    while(!qsbr_poll(q, gp)) {
+        CONFIG_QSBR_WAIT();
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __QSBR_H */
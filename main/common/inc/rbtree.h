@@ -0,0 +1,703 @@
+/**
+ * @file common/inc/rbtree.h
+ *
+ * Copyright (C) 2022
+ *
+ * rbtree.h is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Intrusive red-black tree.
+ *
+ * The struct rb_node is embedded in the entry like a list_head, the
+ * entry is got back by rb_entry(). Nothing is allocated and nothing is
+ * locked. The tree keeps no key, the user either finds the place of a
+ * new node and links it:
+ *
+ *     struct rb_node **link = &root->node, *parent = NULL;
+ *
+ *     while(*link) {
+ *         parent = *link;
+ *         if(key < rb_entry(parent, struct timer, node)->key) {
+ *             link = &parent->left;
+ *         } else {
+ *             link = &parent->right;
+ *         }
+ *     }
+ *     rb_link_node(&timer->node, parent, link);
+ *     rb_insert_color(&timer->node, root);
+ *
+ * or gives a compare callback to rb_add() and rb_find(). A tree with
+ * the cached leftmost node(struct rb_root_cached) gets its smallest
+ * node in O(1), which suits deadline ordered queues.
+ */
+#ifndef __RBTREE_H
+#define __RBTREE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*---------- includes ----------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "misc.h"
+
+/*---------- macro ----------*/
+#define RB_RED                                      (0)
+#define RB_BLACK                                    (1)
+
+/* initialize rbtree root
+ */
+#define RB_ROOT                                     {NULL}
+#define RB_ROOT_CACHED                              {{NULL}, NULL}
+
+/**
+ * @brief Get the struct for this rbtree entry.
+ * @param ptr: the &struct rb_node pointer.
+ * @param type: the type of the struct this is embeded in.
+ * @param member: the name of the rb_node within the struct.
+ */
+#define rb_entry(ptr, type, member)                 container_of(ptr, type, member)
+
+/**
+ * @brief Get the struct for this rbtree entry.
+ * @note That if @ptr is NULL, it returns NULL.
+ * @param ptr: the &struct rb_node pointer.
+ * @param type: the type of the struct this is embeded in.
+ * @param member: the name of the rb_node within the struct.
+ */
+#define rb_entry_safe(ptr, type, member)            ((ptr) ? rb_entry(ptr, type, member) : NULL)
+
+#define RB_EMPTY_ROOT(root)                         ((root)->node == NULL)
+
+/* a node not in any tree points to itself
+ */
+#define RB_EMPTY_NODE(n)                            ((n)->parent_color == (uintptr_t)(n))
+#define RB_CLEAR_NODE(n)                            ((n)->parent_color = (uintptr_t)(n))
+
+/**
+ * @brief Iterate in order over the entries of a rbtree.
+ * @param pos: the type * to use as a loop cursor.
+ * @param type: the type of the struct this is embeded in.
+ * @param root: the &struct rb_root of the tree.
+ * @param member: the name of the rb_node within the struct.
+ */
+#define rb_for_each_entry(pos, type, root, member)              \
+        for(pos = rb_entry_safe(rb_first(root), type, member);  \
+            pos;                                                \
+            pos = rb_entry_safe(rb_next(&pos->member), type, member))
+
+/*---------- type define ----------*/
+struct rb_node {
+    uintptr_t parent_color;                         /*<< parent pointer, the color in bit 0 */
+    struct rb_node *right;
+    struct rb_node *left;
+};
+
+struct rb_root {
+    struct rb_node *node;
+};
+
+struct rb_root_cached {
+    struct rb_root root;
+    struct rb_node *leftmost;                       /*<< smallest node, NULL if empty */
+};
+
+/*---------- variable prototype ----------*/
+/*---------- function prototype ----------*/
+static inline struct rb_node *rb_parent(const struct rb_node *node)
+{
+    return (struct rb_node *)(node->parent_color & ~(uintptr_t)3);
+}
+
+static inline bool rb_is_black(const struct rb_node *node)
+{
+    return (node->parent_color & RB_BLACK);
+}
+
+static inline bool rb_is_red(const struct rb_node *node)
+{
+    return !rb_is_black(node);
+}
+
+static inline void __rb_set_parent(struct rb_node *node, struct rb_node *parent)
+{
+    node->parent_color = (node->parent_color & RB_BLACK) | (uintptr_t)parent;
+}
+
+static inline void __rb_set_parent_color(struct rb_node *node, struct rb_node *parent, uintptr_t color)
+{
+    node->parent_color = (uintptr_t)parent | color;
+}
+
+/*
+ * Replace the child old of parent by pnew, parent is NULL if old is
+ * the root.
+ */
+static inline void __rb_change_child(struct rb_node *old, struct rb_node *pnew, struct rb_node *parent,
+                                     struct rb_root *root)
+{
+    if(!parent) {
+        root->node = pnew;
+    } else if(parent->left == old) {
+        parent->left = pnew;
+    } else {
+        parent->right = pnew;
+    }
+}
+
+/*
+ * Helper for rotations: pnew takes the place and the color of old,
+ * old becomes a child of pnew with the color given.
+ */
+static inline void __rb_rotate_set_parents(struct rb_node *old, struct rb_node *pnew, struct rb_root *root,
+                                           uintptr_t color)
+{
+    struct rb_node *parent = rb_parent(old);
+
+    pnew->parent_color = old->parent_color;
+    __rb_set_parent_color(old, pnew, color);
+    __rb_change_child(old, pnew, parent, root);
+}
+
+/**
+ * @brief Link a new node at the place found for it, the tree must
+ * be rebalanced by rb_insert_color() after this.
+ * @param node: the node to be linked.
+ * @param parent: the parent of the place, NULL for the root.
+ * @param link: the child pointer of @parent(or the root pointer)
+ * the node goes in.
+ * @retval None
+ */
+static inline void rb_link_node(struct rb_node *node, struct rb_node *parent, struct rb_node **link)
+{
+    node->parent_color = (uintptr_t)parent;
+    node->left = NULL;
+    node->right = NULL;
+    *link = node;
+}
+
+/**
+ * @brief Rebalance the tree after a node was linked.
+ * @param node: the node linked by rb_link_node().
+ * @param root: the root of the tree.
+ * @retval None
+ */
+static inline void rb_insert_color(struct rb_node *node, struct rb_root *root)
+{
+    struct rb_node *parent = rb_parent(node), *gparent = NULL, *tmp = NULL;
+
+    /* the node is red, it is recolored up while both its parent and
+     * uncle are red, then at most two rotations fix the tree
+     */
+    while(true) {
+        if(!parent) {
+            __rb_set_parent_color(node, NULL, RB_BLACK);
+            break;
+        }
+        if(rb_is_black(parent)) {
+            break;
+        }
+        gparent = rb_parent(parent);
+        tmp = gparent->right;
+        if(parent != tmp) {
+            /* parent is the left child */
+            if(tmp && rb_is_red(tmp)) {
+                __rb_set_parent_color(tmp, gparent, RB_BLACK);
+                __rb_set_parent_color(parent, gparent, RB_BLACK);
+                node = gparent;
+                parent = rb_parent(node);
+                __rb_set_parent_color(node, parent, RB_RED);
+                continue;
+            }
+            tmp = parent->right;
+            if(node == tmp) {
+                /* left rotate at parent */
+                tmp = node->left;
+                parent->right = tmp;
+                node->left = parent;
+                if(tmp) {
+                    __rb_set_parent_color(tmp, parent, RB_BLACK);
+                }
+                __rb_set_parent_color(parent, node, RB_RED);
+                parent = node;
+                tmp = node->right;
+            }
+            /* right rotate at gparent */
+            gparent->left = tmp;
+            parent->right = gparent;
+            if(tmp) {
+                __rb_set_parent_color(tmp, gparent, RB_BLACK);
+            }
+            __rb_rotate_set_parents(gparent, parent, root, RB_RED);
+            break;
+        } else {
+            /* parent is the right child */
+            tmp = gparent->left;
+            if(tmp && rb_is_red(tmp)) {
+                __rb_set_parent_color(tmp, gparent, RB_BLACK);
+                __rb_set_parent_color(parent, gparent, RB_BLACK);
+                node = gparent;
+                parent = rb_parent(node);
+                __rb_set_parent_color(node, parent, RB_RED);
+                continue;
+            }
+            tmp = parent->left;
+            if(node == tmp) {
+                /* right rotate at parent */
+                tmp = node->right;
+                parent->left = tmp;
+                node->right = parent;
+                if(tmp) {
+                    __rb_set_parent_color(tmp, parent, RB_BLACK);
+                }
+                __rb_set_parent_color(parent, node, RB_RED);
+                parent = node;
+                tmp = node->left;
+            }
+            /* left rotate at gparent */
+            gparent->right = tmp;
+            parent->left = gparent;
+            if(tmp) {
+                __rb_set_parent_color(tmp, gparent, RB_BLACK);
+            }
+            __rb_rotate_set_parents(gparent, parent, root, RB_RED);
+            break;
+        }
+    }
+}
+
+/*
+ * Rebalance the tree after a black leaf was removed below parent.
+ */
+static inline void __rb_erase_color(struct rb_node *parent, struct rb_root *root)
+{
+    struct rb_node *node = NULL, *sibling = NULL, *tmp1 = NULL, *tmp2 = NULL;
+
+    while(true) {
+        sibling = parent->right;
+        if(node != sibling) {
+            /* node is the left child */
+            if(rb_is_red(sibling)) {
+                /* left rotate at parent */
+                tmp1 = sibling->left;
+                parent->right = tmp1;
+                sibling->left = parent;
+                __rb_set_parent_color(tmp1, parent, RB_BLACK);
+                __rb_rotate_set_parents(parent, sibling, root, RB_RED);
+                sibling = tmp1;
+            }
+            tmp1 = sibling->right;
+            if(!tmp1 || rb_is_black(tmp1)) {
+                tmp2 = sibling->left;
+                if(!tmp2 || rb_is_black(tmp2)) {
+                    /* flip the sibling, go up if the parent was black */
+                    __rb_set_parent_color(sibling, parent, RB_RED);
+                    if(rb_is_red(parent)) {
+                        parent->parent_color |= RB_BLACK;
+                    } else {
+                        node = parent;
+                        parent = rb_parent(node);
+                        if(parent) {
+                            continue;
+                        }
+                    }
+                    break;
+                }
+                /* right rotate at sibling */
+                tmp1 = tmp2->right;
+                sibling->left = tmp1;
+                tmp2->right = sibling;
+                parent->right = tmp2;
+                if(tmp1) {
+                    __rb_set_parent_color(tmp1, sibling, RB_BLACK);
+                }
+                tmp1 = sibling;
+                sibling = tmp2;
+            }
+            /* left rotate at parent and color flips */
+            tmp2 = sibling->left;
+            parent->right = tmp2;
+            sibling->left = parent;
+            __rb_set_parent_color(tmp1, sibling, RB_BLACK);
+            if(tmp2) {
+                __rb_set_parent(tmp2, parent);
+            }
+            __rb_rotate_set_parents(parent, sibling, root, RB_BLACK);
+            break;
+        } else {
+            /* node is the right child */
+            sibling = parent->left;
+            if(rb_is_red(sibling)) {
+                /* right rotate at parent */
+                tmp1 = sibling->right;
+                parent->left = tmp1;
+                sibling->right = parent;
+                __rb_set_parent_color(tmp1, parent, RB_BLACK);
+                __rb_rotate_set_parents(parent, sibling, root, RB_RED);
+                sibling = tmp1;
+            }
+            tmp1 = sibling->left;
+            if(!tmp1 || rb_is_black(tmp1)) {
+                tmp2 = sibling->right;
+                if(!tmp2 || rb_is_black(tmp2)) {
+                    /* flip the sibling, go up if the parent was black */
+                    __rb_set_parent_color(sibling, parent, RB_RED);
+                    if(rb_is_red(parent)) {
+                        parent->parent_color |= RB_BLACK;
+                    } else {
+                        node = parent;
+                        parent = rb_parent(node);
+                        if(parent) {
+                            continue;
+                        }
+                    }
+                    break;
+                }
+                /* left rotate at sibling */
+                tmp1 = tmp2->left;
+                sibling->right = tmp1;
+                tmp2->left = sibling;
+                parent->left = tmp2;
+                if(tmp1) {
+                    __rb_set_parent_color(tmp1, sibling, RB_BLACK);
+                }
+                tmp1 = sibling;
+                sibling = tmp2;
+            }
+            /* right rotate at parent and color flips */
+            tmp2 = sibling->right;
+            parent->left = tmp2;
+            sibling->right = parent;
+            __rb_set_parent_color(tmp1, sibling, RB_BLACK);
+            if(tmp2) {
+                __rb_set_parent(tmp2, parent);
+            }
+            __rb_rotate_set_parents(parent, sibling, root, RB_BLACK);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Delete a node from the tree.
+ * @note RB_EMPTY_NODE() on node does not return true after this, use
+ * RB_CLEAR_NODE() if needed.
+ * @param node: the node to delete, which must be in the tree.
+ * @param root: the root of the tree.
+ * @retval None
+ */
+static inline void rb_erase(struct rb_node *node, struct rb_root *root)
+{
+    struct rb_node *child = node->right, *tmp = node->left;
+    struct rb_node *parent = NULL, *rebalance = NULL, *successor = NULL, *child2 = NULL;
+    uintptr_t pc = 0, pc2 = 0;
+
+    if(!tmp) {
+        /* at most a right child, which must be red: it takes the
+         * place and the color of the node
+         */
+        pc = node->parent_color;
+        parent = rb_parent(node);
+        __rb_change_child(node, child, parent, root);
+        if(child) {
+            child->parent_color = pc;
+        } else if(pc & RB_BLACK) {
+            rebalance = parent;
+        }
+    } else if(!child) {
+        /* only a left child, which must be red */
+        tmp->parent_color = pc = node->parent_color;
+        __rb_change_child(node, tmp, rb_parent(node), root);
+    } else {
+        /* two children, the successor takes the place of the node */
+        successor = child;
+        tmp = child->left;
+        if(!tmp) {
+            parent = successor;
+            child2 = successor->right;
+        } else {
+            do {
+                parent = successor;
+                successor = tmp;
+                tmp = tmp->left;
+            } while(tmp);
+            child2 = successor->right;
+            parent->left = child2;
+            successor->right = child;
+            __rb_set_parent(child, successor);
+        }
+        tmp = node->left;
+        successor->left = tmp;
+        __rb_set_parent(tmp, successor);
+        pc = node->parent_color;
+        __rb_change_child(node, successor, rb_parent(node), root);
+        pc2 = successor->parent_color;
+        successor->parent_color = pc;
+        if(child2) {
+            __rb_set_parent_color(child2, parent, RB_BLACK);
+        } else if(pc2 & RB_BLACK) {
+            rebalance = parent;
+        }
+    }
+    if(rebalance) {
+        __rb_erase_color(rebalance, root);
+    }
+}
+
+/**
+ * @brief Replace a node of the tree by a new one with the same key.
+ * @param victim: the node to be replaced.
+ * @param pnew: the new node to insert.
+ * @param root: the root of the tree.
+ * @retval None
+ */
+static inline void rb_replace_node(struct rb_node *victim, struct rb_node *pnew, struct rb_root *root)
+{
+    *pnew = *victim;
+    if(victim->left) {
+        __rb_set_parent(victim->left, pnew);
+    }
+    if(victim->right) {
+        __rb_set_parent(victim->right, pnew);
+    }
+    __rb_change_child(victim, pnew, rb_parent(victim), root);
+}
+
+/**
+ * @brief Get the smallest node of the tree.
+ * @param root: the root of the tree.
+ * @retval the first node in order, NULL if the tree is empty.
+ */
+static inline struct rb_node *rb_first(const struct rb_root *root)
+{
+    struct rb_node *retval = root->node;
+
+    if(retval) {
+        while(retval->left) {
+            retval = retval->left;
+        }
+    }
+
+    return retval;
+}
+
+/**
+ * @brief Get the biggest node of the tree.
+ * @param root: the root of the tree.
+ * @retval the last node in order, NULL if the tree is empty.
+ */
+static inline struct rb_node *rb_last(const struct rb_root *root)
+{
+    struct rb_node *retval = root->node;
+
+    if(retval) {
+        while(retval->right) {
+            retval = retval->right;
+        }
+    }
+
+    return retval;
+}
+
+/**
+ * @brief Get the next node in order.
+ * @param node: a node of the tree.
+ * @retval the next node, NULL if @node is the last one.
+ */
+static inline struct rb_node *rb_next(const struct rb_node *node)
+{
+    struct rb_node *retval = NULL;
+
+    if(node->right) {
+        retval = node->right;
+        while(retval->left) {
+            retval = retval->left;
+        }
+    } else {
+        while((retval = rb_parent(node)) != NULL && node == retval->right) {
+            node = retval;
+        }
+    }
+
+    return retval;
+}
+
+/**
+ * @brief Get the previous node in order.
+ * @param node: a node of the tree.
+ * @retval the previous node, NULL if @node is the first one.
+ */
+static inline struct rb_node *rb_prev(const struct rb_node *node)
+{
+    struct rb_node *retval = NULL;
+
+    if(node->left) {
+        retval = node->left;
+        while(retval->right) {
+            retval = retval->right;
+        }
+    } else {
+        while((retval = rb_parent(node)) != NULL && node == retval->left) {
+            node = retval;
+        }
+    }
+
+    return retval;
+}
+
+/**
+ * @brief Insert a node in order of a compare callback, nodes with the
+ * same key go after the ones already in the tree.
+ * @param node: the node to be inserted.
+ * @param root: the root of the tree.
+ * @param less: tells whether the first node goes before the second one.
+ * @retval None
+ */
+static inline void rb_add(struct rb_node *node, struct rb_root *root,
+                          bool (*less)(const struct rb_node *, const struct rb_node *))
+{
+    struct rb_node **link = &root->node, *parent = NULL;
+
+    while(*link) {
+        parent = *link;
+        link = less(node, parent) ? &parent->left : &parent->right;
+    }
+    rb_link_node(node, parent, link);
+    rb_insert_color(node, root);
+}
+
+/**
+ * @brief Find a node by its key.
+ * @param key: the key to find.
+ * @param root: the root of the tree.
+ * @param cmp: compares the key to the key of a node, returns < 0, 0 or
+ * > 0 when the key goes before, is the same or goes after.
+ * @retval a node with the key, NULL if none.
+ */
+static inline struct rb_node *rb_find(const void *key, const struct rb_root *root,
+                                      int (*cmp)(const void *, const struct rb_node *))
+{
+    struct rb_node *retval = root->node;
+    int c = 0;
+
+    while(retval) {
+        c = cmp(key, retval);
+        if(!c) {
+            break;
+        }
+        retval = (c < 0) ? retval->left : retval->right;
+    }
+
+    return retval;
+}
+
+/**
+ * @brief Rebalance a tree with the cached leftmost node after a node
+ * was linked.
+ * @param node: the node linked by rb_link_node().
+ * @param root: the root of the tree.
+ * @param leftmost: the node was linked as the leftmost one.
+ * @retval None
+ */
+static inline void rb_insert_color_cached(struct rb_node *node, struct rb_root_cached *root, bool leftmost)
+{
+    if(leftmost) {
+        root->leftmost = node;
+    }
+    rb_insert_color(node, &root->root);
+}
+
+/**
+ * @brief Delete a node from a tree with the cached leftmost node.
+ * @param node: the node to delete, which must be in the tree.
+ * @param root: the root of the tree.
+ * @retval None
+ */
+static inline void rb_erase_cached(struct rb_node *node, struct rb_root_cached *root)
+{
+    if(root->leftmost == node) {
+        root->leftmost = rb_next(node);
+    }
+    rb_erase(node, &root->root);
+}
+
+/**
+ * @brief Replace a node of a tree with the cached leftmost node by a
+ * new one with the same key.
+ * @param victim: the node to be replaced.
+ * @param pnew: the new node to insert.
+ * @param root: the root of the tree.
+ * @retval None
+ */
+static inline void rb_replace_node_cached(struct rb_node *victim, struct rb_node *pnew,
+                                          struct rb_root_cached *root)
+{
+    if(root->leftmost == victim) {
+        root->leftmost = pnew;
+    }
+    rb_replace_node(victim, pnew, &root->root);
+}
+
+/**
+ * @brief Get the smallest node of a tree with the cached leftmost node
+ * in O(1).
+ * @param root: the root of the tree.
+ * @retval the first node in order, NULL if the tree is empty.
+ */
+static inline struct rb_node *rb_first_cached(const struct rb_root_cached *root)
+{
+    return root->leftmost;
+}
+
+/**
+ * @brief Insert a node in order of a compare callback in a tree with the
+ * cached leftmost node, nodes with the same key go after the ones already
+ * in the tree.
+ * @param node: the node to be inserted.
+ * @param root: the root of the tree.
+ * @param less: tells whether the first node goes before the second one.
+ * @retval true: the node is the new leftmost one.
+ *         false: the node is not the leftmost one.
+ */
+static inline bool rb_add_cached(struct rb_node *node, struct rb_root_cached *root,
+                                 bool (*less)(const struct rb_node *, const struct rb_node *))
+{
+    struct rb_node **link = &root->root.node, *parent = NULL;
+    bool leftmost = true;
+
+    while(*link) {
+        parent = *link;
+        if(less(node, parent)) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            leftmost = false;
+        }
+    }
+    rb_link_node(node, parent, link);
+    rb_insert_color_cached(node, root, leftmost);
+
+    return leftmost;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __RBTREE_H */
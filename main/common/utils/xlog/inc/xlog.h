@@ -45,43 +45,325 @@ extern "C"
 /* Annotation for a "continuted" line of log printout(only done after a
  * line that had no enclasing \n). Only to be used by core/arch code during
  * early bootup(a continued line is not SMP=safe otherwise).
+ * Whether a continued line is shown follows the line the same task logged last,
+ * see CONFIG_XLOG_THREAD_LOCAL.
  */
 #define LOG_CONT                            "<c>"
 
+/* Most verbose log level built in, 0(LOG_ERROR) to 3(LOG_INFO). The calls of
+ * the more verbose levels are compiled out together with their format strings,
+ * what is left of them is a call of xlog_compiled_out(), so that xlog_cont()
+ * following them is dropped as it would be after a line filtered at run time.
+ */
+#ifndef CONFIG_XLOG_MIN_LEVEL
+#define CONFIG_XLOG_MIN_LEVEL               (3)
+#endif
+
 /* xlog API functions definition
  */
-#define xlog_error(x, y...)                 xlog(LOG_ERROR x, ##y)
-#define xlog_warn(x, y...)                  xlog(LOG_WARN x, ##y)
-#define xlog_message(x, y...)               xlog(LOG_MESSAGE x, ##y)
-#define xlog_info(x, y...)                  xlog(LOG_INFO x, ##y)
-#define xlog_cont(x, y...)                  xlog(LOG_CONT x, ##y)
-#define xlog_tag_error(tag, x, y...)        xlog(LOG_ERROR "(" tag ")" x, ##y)
-#define xlog_tag_warn(tag, x, y...)         xlog(LOG_WARN "(" tag ")" x, ##y)
-#define xlog_tag_message(tag, x, y...)      xlog(LOG_MESSAGE "(" tag ")" x, ##y)
-#define xlog_tag_info(tag, x, y...)         xlog(LOG_INFO "(" tag ")" x, ##y)
+#if CONFIG_XLOG_MIN_LEVEL >= 0
+#define xlog_error(x, y...)                 __xlog_line(LOG_ERROR, x, ##y)
+#define xlog_tag_error(tag, x, y...)        __xlog_tag(LOG_ERROR, tag, x, ##y)
+#else
+#define xlog_error(x, y...)                 xlog_compiled_out()
+#define xlog_tag_error(tag, x, y...)        xlog_compiled_out()
+#endif
+#if CONFIG_XLOG_MIN_LEVEL >= 1
+#define xlog_warn(x, y...)                  __xlog_line(LOG_WARN, x, ##y)
+#define xlog_tag_warn(tag, x, y...)         __xlog_tag(LOG_WARN, tag, x, ##y)
+#else
+#define xlog_warn(x, y...)                  xlog_compiled_out()
+#define xlog_tag_warn(tag, x, y...)         xlog_compiled_out()
+#endif
+#if CONFIG_XLOG_MIN_LEVEL >= 2
+#define xlog_message(x, y...)               __xlog_line(LOG_MESSAGE, x, ##y)
+#define xlog_tag_message(tag, x, y...)      __xlog_tag(LOG_MESSAGE, tag, x, ##y)
+#else
+#define xlog_message(x, y...)               xlog_compiled_out()
+#define xlog_tag_message(tag, x, y...)      xlog_compiled_out()
+#endif
+#if CONFIG_XLOG_MIN_LEVEL >= 3
+#define xlog_info(x, y...)                  __xlog_line(LOG_INFO, x, ##y)
+#define xlog_tag_info(tag, x, y...)         __xlog_tag(LOG_INFO, tag, x, ##y)
+#else
+#define xlog_info(x, y...)                  xlog_compiled_out()
+#define xlog_tag_info(tag, x, y...)         xlog_compiled_out()
+#endif
+#define xlog_cont(x, y...)                  __xlog_line(LOG_CONT, x, ##y)
+
+/* number of log levels, LOG_ERROR to LOG_INFO
+ */
+#define XLOG_LEVEL_COUNT                    (4)
+
+/* Every call site caches the id of its tag, so that the level of the tag is
+ * looked up with one array access.
+ */
+#ifdef CONFIG_USE_XLOG
+#define __xlog_tag(level, tag, x, y...)     ({ \
+                                                static int16_t __xlog_tag_id = -1; \
+                                                xlog_tag_enabled(&__xlog_tag_id, tag, (level)[1] - '0') ? \
+                                                __xlog_tag_line(__xlog_tag_id, level, tag, x, ##y) : 0; \
+                                            })
+#else
+#define __xlog_tag(level, tag, x, y...)
+#endif
+
+/* With CONFIG_XLOG_BINARY defined the format strings are not built into the
+ * firmware. Every call site puts its format string into the .xlog_fmt section,
+ * which is not loaded(see xlog_fmt.ld), and logs the address of the string in
+ * place of the text together with the raw arguments, see xlog_bin(). The lines
+ * are decoded on the host from the ELF file by tools/xlog_decode.py. The
+ * XLOG_BINARY option of main/CMakeLists.txt defines it and links xlog_fmt.ld.
+ */
+#if defined(CONFIG_USE_XLOG) && defined(CONFIG_XLOG_BINARY)
+#define __xlog_line(level, x, y...)         __xlog_bin(-1, level, "", x, ##y)
+#define __xlog_tag_line(id, level, tag, x, y...) __xlog_bin(id, level, "(" tag ")", x, ##y)
+#else
+#define __xlog_line(level, x, y...)         xlog(level x, ##y)
+#define __xlog_tag_line(id, level, tag, x, y...) xlog_tag_print(id, level "(" tag ")" x, ##y)
+#endif
+
+#ifdef CONFIG_XLOG_BINARY
+/* Longest %s argument of a binary record, longer strings are cut.
+ */
+#ifndef CONFIG_XLOG_BIN_STR_MAX
+#define CONFIG_XLOG_BIN_STR_MAX             (24)
+#endif
+
+/* The arguments of a binary record are described by a word built at compile
+ * time: 2 bits of type per argument, the number of arguments in bits 16 to 19
+ * and XLOG_BIN_EOL when the format string ends the line.
+ */
+#define XLOG_BIN_INT                        (0)     /*<< integer or pointer up to 32 bits */
+#define XLOG_BIN_INT64                      (1)     /*<< 64-bit integer or pointer */
+#define XLOG_BIN_DOUBLE                     (2)
+#define XLOG_BIN_STR                        (3)
+#define XLOG_BIN_ARGS_MAX                   (8)
+#define XLOG_BIN_NARG_SHIFT                 (16)
+#define XLOG_BIN_EOL                        (1UL << 31)
+
+#define __xlog_bin_type(a)                  _Generic((a), \
+                                                float: XLOG_BIN_DOUBLE, \
+                                                double: XLOG_BIN_DOUBLE, \
+                                                char *: XLOG_BIN_STR, \
+                                                const char *: XLOG_BIN_STR, \
+                                                default: ((sizeof(a) > 4) ? XLOG_BIN_INT64 : XLOG_BIN_INT))
+#define __xlog_bin_narg(y...)               __xlog_bin_narg_(0, ##y, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define __xlog_bin_narg_(z, a, b, c, d, e, f, g, h, n, ...) n
+#define __xlog_bin_desc0()                  (0UL)
+#define __xlog_bin_desc1(a)                 ((uint32_t)__xlog_bin_type(a))
+#define __xlog_bin_desc2(a, y...)           (__xlog_bin_desc1(a) | (__xlog_bin_desc1(y) << 2))
+#define __xlog_bin_desc3(a, y...)           (__xlog_bin_desc1(a) | (__xlog_bin_desc2(y) << 2))
+#define __xlog_bin_desc4(a, y...)           (__xlog_bin_desc1(a) | (__xlog_bin_desc3(y) << 2))
+#define __xlog_bin_desc5(a, y...)           (__xlog_bin_desc1(a) | (__xlog_bin_desc4(y) << 2))
+#define __xlog_bin_desc6(a, y...)           (__xlog_bin_desc1(a) | (__xlog_bin_desc5(y) << 2))
+#define __xlog_bin_desc7(a, y...)           (__xlog_bin_desc1(a) | (__xlog_bin_desc6(y) << 2))
+#define __xlog_bin_desc8(a, y...)           (__xlog_bin_desc1(a) | (__xlog_bin_desc7(y) << 2))
+#define __xlog_bin_desc_(n, y...)           __xlog_bin_desc##n(y)
+#define __xlog_bin_desc(n, y...)            __xlog_bin_desc_(n, ##y)
+#define __xlog_bin(id, level, prefix, x, y...) ({ \
+                                                static const char __xlog_fmt[] \
+                                                    __attribute__((section(".xlog_fmt"))) = prefix x; \
+                                                xlog_bin(id, level, (uint32_t)(uintptr_t)__xlog_fmt, \
+                                                    __xlog_bin_desc(__xlog_bin_narg(y), ##y) | \
+                                                    ((uint32_t)__xlog_bin_narg(y) << XLOG_BIN_NARG_SHIFT) | \
+                                                    (((x)[(sizeof(x) > 1) ? (sizeof(x) - 2) : 0] == '\n') ? \
+                                                     XLOG_BIN_EOL : 0), ##y); \
+                                            })
+#endif
+
+/* Every rate limited call site has a token bucket of its own, holding up to
+ * CONFIG_XLOG_RATELIMIT_BURST lines, which earns the lines back over
+ * CONFIG_XLOG_RATELIMIT_INTERVAL milliseconds. A line above the log level
+ * takes no token. The time is taken from get_timestamp_us(), or get_timestamp()
+ * if there is none, nothing is limited without either.
+ */
+#ifndef CONFIG_XLOG_RATELIMIT_INTERVAL
+#define CONFIG_XLOG_RATELIMIT_INTERVAL      (5000)
+#endif
+#ifndef CONFIG_XLOG_RATELIMIT_BURST
+#define CONFIG_XLOG_RATELIMIT_BURST         (10)
+#endif
+#define XLOG_RATELIMIT_INIT(interval, burst) {((interval) * 1000UL) / (burst), 0, 0, (burst), (burst)}
+
+#ifdef CONFIG_USE_XLOG
+#define __xlog_ratelimited(level, x, y...)  ({ \
+                                                static xlog_ratelimit_t __xlog_rs = XLOG_RATELIMIT_INIT( \
+                                                    CONFIG_XLOG_RATELIMIT_INTERVAL, CONFIG_XLOG_RATELIMIT_BURST); \
+                                                xlog_ratelimit(&__xlog_rs, level, __func__) ? \
+                                                __xlog_line(level, x, ##y) : 0; \
+                                            })
+#define __xlog_tag_ratelimited(level, tag, x, y...) ({ \
+                                                static int16_t __xlog_tag_id = -1; \
+                                                static xlog_ratelimit_t __xlog_rs = XLOG_RATELIMIT_INIT( \
+                                                    CONFIG_XLOG_RATELIMIT_INTERVAL, CONFIG_XLOG_RATELIMIT_BURST); \
+                                                (xlog_tag_enabled(&__xlog_tag_id, tag, (level)[1] - '0') && \
+                                                 xlog_ratelimit(&__xlog_rs, NULL, __func__)) ? \
+                                                __xlog_tag_line(__xlog_tag_id, level, tag, x, ##y) : 0; \
+                                            })
+#else
+#define __xlog_ratelimited(level, x, y...)
+#define __xlog_tag_ratelimited(level, tag, x, y...)
+#endif
+
+/* rate limited versions of the xlog API functions
+ */
+#if CONFIG_XLOG_MIN_LEVEL >= 0
+#define xlog_ratelimited_error(x, y...)     __xlog_ratelimited(LOG_ERROR, x, ##y)
+#define xlog_ratelimited_tag_error(tag, x, y...) __xlog_tag_ratelimited(LOG_ERROR, tag, x, ##y)
+#else
+#define xlog_ratelimited_error(x, y...)     xlog_compiled_out()
+#define xlog_ratelimited_tag_error(tag, x, y...) xlog_compiled_out()
+#endif
+#if CONFIG_XLOG_MIN_LEVEL >= 1
+#define xlog_ratelimited_warn(x, y...)      __xlog_ratelimited(LOG_WARN, x, ##y)
+#define xlog_ratelimited_tag_warn(tag, x, y...) __xlog_tag_ratelimited(LOG_WARN, tag, x, ##y)
+#else
+#define xlog_ratelimited_warn(x, y...)      xlog_compiled_out()
+#define xlog_ratelimited_tag_warn(tag, x, y...) xlog_compiled_out()
+#endif
+#if CONFIG_XLOG_MIN_LEVEL >= 2
+#define xlog_ratelimited_message(x, y...)   __xlog_ratelimited(LOG_MESSAGE, x, ##y)
+#define xlog_ratelimited_tag_message(tag, x, y...) __xlog_tag_ratelimited(LOG_MESSAGE, tag, x, ##y)
+#else
+#define xlog_ratelimited_message(x, y...)   xlog_compiled_out()
+#define xlog_ratelimited_tag_message(tag, x, y...) xlog_compiled_out()
+#endif
+#if CONFIG_XLOG_MIN_LEVEL >= 3
+#define xlog_ratelimited_info(x, y...)      __xlog_ratelimited(LOG_INFO, x, ##y)
+#define xlog_ratelimited_tag_info(tag, x, y...) __xlog_tag_ratelimited(LOG_INFO, tag, x, ##y)
+#else
+#define xlog_ratelimited_info(x, y...)      xlog_compiled_out()
+#define xlog_ratelimited_tag_info(tag, x, y...) xlog_compiled_out()
+#endif
 
 /*---------- type define ----------*/
 typedef struct {
+    const char *base;
+    size_t len;
+} xlog_iovec_t;
+
+/* API functions of xlog, see xlog_init().
+ */
+typedef struct {
+    /* Protect the log buffer, eg. a mutex. With CONFIG_XLOG_LOCKLESS defined they
+     * are not used, the log buffer is reserved and committed with atomic operations.
+     */
     void (*lock)(void);
     void (*unlock)(void);
+    /* Protect the console, eg. a binary semaphore. With CONFIG_XLOG_LOCKLESS defined
+     * acquire_console() should return false instead of blocking when the console is
+     * held by another task.
+     */
     bool (*acquire_console)(void);
     void (*release_console)(void);
+    /* Keep the current task from being preempted, eg. vTaskSuspendAll() and
+     * xTaskResumeAll(). With CONFIG_XLOG_LOCKLESS defined between reserve and commit,
+     * as a preempted producer holds back the lines reserved after its own from the
+     * console. With CONFIG_XLOG_DEFERRED defined while a task queues a line, and in
+     * lockless mode while it takes a queued line and stores it, as a message formatted
+     * in place waits for the lines queued before.
+     */
+    void (*suspend)(void);
+    void (*resume)(void);
+    /* Wake up the task calling xlog_process(). With CONFIG_XLOG_ASYNC defined xlog()
+     * only stores the line into the log buffer and calls notify().
+     */
+    void (*notify)(void);
+    /* Let the task holding the console run, eg. vTaskDelay(1) or sched_yield(). A
+     * producer finding the log buffer full in lockless mode prints it when the
+     * console is free, otherwise it yields, CONFIG_XLOG_RESERVE_WAITS(100) times
+     * before its line is dropped and told by a "N lines lost" marker. Optional,
+     * without it the tries do not wait for anything.
+     */
+    void (*yield)(void);
+    /* Optional, adds "[%Y-%m-%d %H:%M:%S]" to every line. With
+     * CONFIG_XLOG_TIMESTAMP_MONOTONIC defined get_timestamp_us() is used instead, a
+     * monotonic time in microseconds printed as "[sec.usec]".
+     */
     void (*get_timestamp)(time_t *utc);
+    void (*get_timestamp_us)(uint64_t *us);
+    /* Output the log. print_v() is used instead of print() when it is set, it gets
+     * every pending segment of the log buffer in one call, eg. xlog_print_v().
+     */
     void (*print)(const char *str, uint32_t length);
+    void (*print_v)(const xlog_iovec_t *iov, uint32_t count);
+    /* Optional, the core xlog_from_isr() is called on, eg. xPortGetCoreID(). Only
+     * used with CONFIG_XLOG_ISR defined.
+     */
+    uint32_t (*core_id)(void);
+    /* Optional, a persistent log region of the size asked for, eg. xlog_get_persist()
+     * on Linux. Only used with CONFIG_XLOG_PERSIST defined.
+     */
+    void *(*get_persist)(uint32_t size);
 } xlog_ops_t;
 
 typedef void (*xlog_print_func_t)(const char *str, uint32_t length);
+typedef void (*xlog_print_v_func_t)(const xlog_iovec_t *iov, uint32_t count);
+
+/* what a producer does when the backlog of the log buffer is above the
+ * watermark in asynchronous mode
+ */
+typedef enum {
+    XLOG_ASYNC_BLOCK,                               /*<< print the backlog in the caller */
+    XLOG_ASYNC_DROP_OLDEST,                         /*<< drop the oldest lines */
+    XLOG_ASYNC_DROP_NEWEST                          /*<< drop the new line */
+} xlog_async_policy_t;
+
+typedef struct {
+    uint32_t blocked;                               /*<< lines whose caller printed the backlog */
+    uint32_t dropped_oldest;                        /*<< lines dropped by XLOG_ASYNC_DROP_OLDEST */
+    uint32_t dropped_newest;                        /*<< lines dropped by XLOG_ASYNC_DROP_NEWEST */
+} xlog_async_stats_t;
+
+/* counters of the lines logged, indexed by log level 0(LOG_ERROR) to 3(LOG_INFO)
+ */
+typedef struct {
+    uint32_t written[XLOG_LEVEL_COUNT];             /*<< lines logged above the console or a sink log level */
+    uint32_t dropped[XLOG_LEVEL_COUNT];             /*<< lines which never reached the console */
+    uint32_t dropped_bytes[XLOG_LEVEL_COUNT];       /*<< text of the lines dropped */
+    uint32_t high_watermark;                        /*<< most bytes of the log buffer waiting for the console */
+    uint32_t size;                                  /*<< size of the log buffer */
+} xlog_stats_t;
+
+/* token bucket of a rate limited call site, see XLOG_RATELIMIT_INIT()
+ * The fields are updated with atomic operations and no lock, tasks sharing a
+ * call site take every token once, the bucket may hold a few more than burst
+ * for a while.
+ */
+typedef struct {
+    uint32_t step;                                  /*<< microseconds to earn a line back */
+    uint32_t deadline;                              /*<< time the next line is earned back at */
+    uint32_t missed;                                /*<< lines suppressed since the last line logged */
+    uint32_t tokens;                                /*<< lines left */
+    uint16_t burst;                                 /*<< most lines in a row */
+} xlog_ratelimit_t;
+
+/* a log sink, it reads the log buffer with a cursor of its own
+ */
+typedef struct {
+    xlog_print_func_t write;                        /*<< gets the rendered lines, a batch at a time */
+    const char *level;                              /*<< LOG_ERROR to LOG_INFO, NULL for every level */
+    uint32_t batch;                                 /*<< chars gathered before xlog_process() calls write() */
+    bool manual;                                    /*<< only written by xlog_flush_sink() */
+    struct xlog_lz *lz;                             /*<< compresses what write() gets when not NULL, see xlog_lz.h */
+} xlog_sink_t;
 
 /*---------- variable prototype ----------*/
 /*---------- function prototype ----------*/
 /**
  * @brief Print a message to the console.
- * One effect of this deferred printing is that code which calls xlog() and
- * then changes xlog level may break. This is because xlog level is inspected
- * when the actual printing accurs.
+ * The log level is checked before the message is formatted, a message above
+ * the console log level costs nothing but the check, and so do the lines
+ * continuing it.
+ * With CONFIG_XLOG_DEFERRED defined, xlog() only records the format string, the
+ * timestamp and the raw arguments, the line is formatted later by xlog_process().
+ * Lines with a %s argument or too many arguments can not be deferred, they are
+ * formatted in place.
  * @param fmt Format string.
  * 
- * @retval The length actually printed or put into the log buffer.
+ * @retval The length of the text actually put into the log buffer, without the
+ * line prefixes, 0 if the line is deferred.
  */
 #ifdef CONFIG_USE_XLOG
 extern uint32_t __attribute__((format(printf, 1, 0))) xlog(const char *fmt, ...);
@@ -90,13 +372,261 @@ extern uint32_t __attribute__((format(printf, 1, 0))) xlog(const char *fmt, ...)
 #endif
 
 /**
- * @brief Set function used to output log entries. 
+ * @brief Log a message from an interrupt handler, with CONFIG_XLOG_ISR defined.
+ * Like deferred mode, only the format string, the timestamp and the raw arguments
+ * are recorded, into a small ring of the current core(CONFIG_XLOG_ISR_SLOTS lines).
+ * The lines of all cores are formatted and put into the log buffer in the order
+ * they were logged by the next xlog() call or xlog_process(), ahead of the line of
+ * that call. Nothing is printed and nothing blocks, the worst case is one pass over
+ * the format string, copying CONFIG_XLOG_DEFERRED_ARGS argument words, get_timestamp()
+ * or get_timestamp_us() which must then be callable from an interrupt, one atomic add
+ * shared by the cores, and one compare-and-swap retried at most once per nested
+ * interrupt level.
+ * A line should end with '\n', %s arguments and lines of more arguments than the
+ * record can carry are not supported.
+ * The code of xlog_from_isr() and of its helpers is not placed in IRAM and the format
+ * string, which is read, stays in flash with the other string literals: it must not
+ * be called from an interrupt handler allocated with ESP_INTR_FLAG_IRAM, or from
+ * anything else running while the flash cache is disabled.
+ * @param fmt Format string.
+ * 
+ * @retval If the line is staged then true is returned, false is returned when it is
+ * above the console log level, it can not be recorded or the ring is full.
+ */
+#ifdef CONFIG_USE_XLOG
+extern bool __attribute__((format(printf, 1, 0))) xlog_from_isr(const char *fmt, ...);
+#else
+#define xlog_from_isr(x, y...)
+#endif
+
+/**
+ * @brief What a call of a log level compiled out by CONFIG_XLOG_MIN_LEVEL is
+ * left with. The line the task continues by LOG_CONT counts as filtered from
+ * then on, as if it had been logged and filtered.
+ * 
+ * @retval None
+ */
+#ifdef CONFIG_USE_XLOG
+extern void xlog_compiled_out(void);
+#else
+#define xlog_compiled_out()                 ((void)0)
+#endif
+
+/**
+ * @brief Check the level of a tag, used by the xlog_tag_* macros.
+ * @param id Id of the tag cached by the call site, the tag is looked up and the
+ * id is updated when it is negative. It stays negative while another task is
+ * registering a tag, and the line follows the console log level then.
+ * @param tag Name of the tag.
+ * @param level Log level of the line, 0(LOG_ERROR) to 3(LOG_INFO).
+ * 
+ * @retval If the line can be shown then true is returned, otherwise false is returned.
+ */
+extern bool xlog_tag_enabled(int16_t *id, const char *tag, uint32_t level);
+
+/**
+ * @brief Print a message of a tag which passed xlog_tag_enabled(), used by the
+ * xlog_tag_* macros.
+ * @param id Id of the tag, as returned by xlog_tag_enabled().
+ * @param fmt Format string.
+ * 
+ * @retval The length actually put into the log buffer, 0 if the line is deferred.
+ */
+extern uint32_t __attribute__((format(printf, 2, 0))) xlog_tag_print(int16_t id, const char *fmt, ...);
+
+/**
+ * @brief Take a line from the token bucket of a call site, used by the
+ * xlog_ratelimited_* macros. The clock is only read when the bucket is empty or
+ * full, a line suppressed costs the clock and a compare against the time the next
+ * line is earned back at. The first line logged after some have been suppressed
+ * is preceded by a line telling how many, and where.
+ * @param rs Token bucket of the call site.
+ * @param fmt Format string of the line or its log level, a line above the log level
+ * takes no token.
+ * NULL when the level has been checked already, eg. by xlog_tag_enabled().
+ * @param func Name of the function of the call site.
+ * 
+ * @retval If the line can be logged then true is returned, otherwise false is returned.
+ */
+extern bool xlog_ratelimit(xlog_ratelimit_t *rs, const char *fmt, const char *func);
+
+/**
+ * @brief Log a binary record, used by the xlog_* macros with CONFIG_XLOG_BINARY
+ * defined. The record holds the id of the format string and the arguments as
+ * varints(zigzag encoded integers), raw doubles and strings of up to
+ * CONFIG_XLOG_BIN_STR_MAX chars, it is never split. Binary records are not
+ * deferred, the lines deferred before are put into the log buffer first.
+ * @param id Id of the tag as returned by xlog_tag_enabled(), negative without tag.
+ * @param level Log level of the line, LOG_ERROR to LOG_INFO, LOG_DEFAULT or LOG_CONT.
+ * @param fmt Id of the format string, its address in the .xlog_fmt section.
+ * @param desc Types and number of the arguments, see XLOG_BIN_INT.
+ * 
+ * @retval The length of the record put into the log buffer, 0 if it is filtered
+ * or dropped.
+ */
+extern uint32_t xlog_bin(int16_t id, const char *level, uint32_t fmt, uint32_t desc, ...);
+
+/**
+ * @brief Dump a buffer in rows of 16 bytes: offset, hex and ASCII. The rows are
+ * rendered without the formatter and put into the log buffer as one message,
+ * under one lock, so the lines of other tasks do not get in between. In lockless
+ * mode(CONFIG_XLOG_LOCKLESS) the rows are put one by one into a range of the log
+ * buffer reserved for all of them, a dump the log buffer cannot hold at once
+ * takes as many rows at a time as it holds.
+ * @param level Log level of the rows, LOG_ERROR to LOG_INFO or LOG_DEFAULT.
+ * @param tag Tag of the rows, its level applies like for the xlog_tag_* macros,
+ * NULL without tag. Its id is cached by the call site like for those, so a call
+ * site should always pass the same tag.
+ * @param buf Buffer to be dumped.
+ * @param len Length of the buffer.
+ * 
+ * @retval The length of the text actually put into the log buffer.
+ */
+#ifdef CONFIG_USE_XLOG
+#define xlog_hexdump(level, tag, buf, len)  ({ \
+                                                static int16_t __xlog_tag_id = -1; \
+                                                xlog_tag_hexdump(&__xlog_tag_id, level, tag, buf, len); \
+                                            })
+
+/**
+ * @brief Dump a buffer, used by xlog_hexdump().
+ * @param id Id of the tag cached by the call site, see xlog_tag_enabled().
+ * 
+ * @retval The length of the text actually put into the log buffer.
+ */
+extern uint32_t xlog_tag_hexdump(int16_t *id, const char *level, const char *tag, const void *buf, uint32_t len);
+#else
+#define xlog_hexdump(level, tag, buf, len)
+#endif
+
+/**
+ * @brief Format the lines recorded by deferred mode(CONFIG_XLOG_DEFERRED) or
+ * xlog_from_isr() and put them into the log buffer. In asynchronous mode(CONFIG_XLOG_ASYNC) the log buffer
+ * is then printed to the console in one batch. The log sinks not added as manual
+ * are written last. It is expected to be called from a low priority task, woken up
+ * by the notify() API function.
+ * 
+ * @retval The number of deferred lines processed.
+ */
+extern uint32_t xlog_process(void);
+
+/**
+ * @brief Set what a producer does when the backlog of the log buffer is above
+ * CONFIG_XLOG_ASYNC_WATERMARK in asynchronous mode. XLOG_ASYNC_DROP_OLDEST falls
+ * back to XLOG_ASYNC_DROP_NEWEST in lockless mode.
+ * @param policy One of XLOG_ASYNC_BLOCK, XLOG_ASYNC_DROP_OLDEST and XLOG_ASYNC_DROP_NEWEST.
+ * 
+ * @retval Set policy successfully then true is returned, otherwise false is returned.
+ */
+extern bool xlog_set_async_policy(xlog_async_policy_t policy);
+
+/**
+ * @brief Get the counters of the asynchronous mode overflow policy.
+ * @param stats Where the counters are copied to.
+ * 
+ * @retval None
+ */
+extern void xlog_get_async_stats(xlog_async_stats_t *stats);
+
+/**
+ * @brief Get the counters of the lines logged and dropped, and the high watermark
+ * of the log buffer, to size CONFIG_XLOG_BUF_SHIFT. The records in the log buffer
+ * carry their headers, so a line takes 24 bytes more than its text, 32 with
+ * CONFIG_XLOG_PERSIST defined.
+ * Wherever lines are dropped, by an overflow of the log buffer, the asynchronous
+ * mode overflow policy or a full xlog_from_isr() ring, the console prints a marker
+ * line "N lines lost" in their place.
+ * @param stats Where the counters are copied to.
+ * 
+ * @retval None
+ */
+extern void xlog_get_stats(xlog_stats_t *stats);
+
+/**
+ * @brief Add a log sink, eg. a UART, a file or a network connection, next to the
+ * console. Every sink reads the log buffer from a cursor of its own, starting
+ * with the oldest line kept, and renders the lines of its level into a buffer of
+ * CONFIG_XLOG_SINK_BUF_SIZE chars, which is handed to write() once batch chars are
+ * gathered. Nothing waits for a sink: a sink which falls behind by more than the
+ * log buffer loses the oldest lines of its backlog, reported by a marker line
+ * "N lines lost", while the console and the other sinks go on. The lines are kept
+ * for the most verbose of the console and the sinks, the tag levels only apply to
+ * the console. Up to CONFIG_XLOG_SINK_MAX sinks can be added.
+ * The sinks are written by xlog_process(), which must then be called periodically,
+ * a manual sink only by xlog_flush_sink(), eg. from a task of its own.
+ * A sink given a compressor(xlog_lz_t) gets a compressed stream, which starts
+ * when the sink is added.
+ * @param sink Description of the sink, it is copied.
+ * 
+ * @retval The id of the sink, -1 if it is not valid or no sink is left.
+ */
+extern int32_t xlog_add_sink(const xlog_sink_t *sink);
+
+/**
+ * @brief Remove a log sink, what it has gathered is written first.
+ * @param id Id of the sink, as returned by xlog_add_sink().
+ * 
+ * @retval Remove the sink successfully then true is returned, false is returned
+ * when there is no such sink or the sink is being written.
+ */
+extern bool xlog_remove_sink(int32_t id);
+
+/**
+ * @brief Set log level of a log sink.
+ * @param id Id of the sink, as returned by xlog_add_sink().
+ * @param level One of the following parameters: LOG_ERROR, LOG_WARN, LOG_MESSAGE
+ * and LOG_INFO, or NULL for every level.
+ * 
+ * @retval Set log level successfully then true is returned, otherwise false is
+ * returned.
+ */
+extern bool xlog_set_sink_level(int32_t id, const char *level);
+
+/**
+ * @brief Read the log buffer for a log sink and write everything it got, whatever
+ * its batch. Does nothing when the sink is being written by another task.
+ * @param id Id of the sink, as returned by xlog_add_sink().
+ * 
+ * @retval The number of lines written.
+ */
+extern uint32_t xlog_flush_sink(int32_t id);
+
+/**
+ * @brief Copy the lines kept in the log buffer, from a sequence number on, as the
+ * console prints them. Nothing is taken from the console or the sinks, and nothing
+ * is locked while the lines are copied, so it can be called from a diagnostics
+ * request or a crash handler. Every record carries a 64-bit sequence number, a reader
+ * resumes with the *seq it got last time, and the lines it missed since then, as they
+ * were overwritten or dropped, are reported by a marker line "N lines lost".
+ * Only whole lines are copied, a line longer than len is cut.
+ * @param seq Sequence number of the first line wanted, 0 for the oldest line kept
+ * without a marker line for the lines before it. It is updated to the sequence
+ * number of the line following the last line copied.
+ * @param buf Where the lines are copied to.
+ * @param len Size of buf.
+ * 
+ * @retval The number of chars copied, 0 when there is no line from *seq on.
+ */
+extern uint32_t xlog_read(uint64_t *seq, char *buf, uint32_t len);
+
+/**
+ * @brief Set function used to output log entries. It replaces print_v() as
+ * well, which would be used in its place otherwise.
  * @param print New function used for output.
  * 
  * @retval Function old is returned.
  */
 extern xlog_print_func_t xlog_set_print_func(xlog_print_func_t print);
 
+/**
+ * @brief Set function used to output batches of log entries, print() is used
+ * again when it is NULL.
+ * @param print_v New function used for output.
+ * 
+ * @retval Function old is returned.
+ */
+extern xlog_print_v_func_t xlog_set_print_v_func(xlog_print_v_func_t print_v);
+
 /**
  * @brief Set log level for determine which log can output.
  * @param level One of the following parameters: LOG_ERROR, LOG_WARN, LOG_MESSAGE
@@ -107,6 +637,20 @@ extern xlog_print_func_t xlog_set_print_func(xlog_print_func_t print);
  */
 extern bool xlog_set_log_level(const char *level);
 
+/**
+ * @brief Set log level of a tag, which then overrides the console log level for
+ * the lines printed by xlog_tag_* macros with this tag. Up to CONFIG_XLOG_TAG_MAX
+ * tags can be registered, the others always follow the console log level. The name is
+ * copied, up to CONFIG_XLOG_TAG_NAME_SIZE - 1(15) chars of it tell the tags apart.
+ * @param tag Name of the tag, as passed to the xlog_tag_* macros.
+ * @param level One of the following parameters: LOG_ERROR, LOG_WARN, LOG_MESSAGE
+ * and LOG_INFO, or NULL to follow the console log level again.
+ * 
+ * @retval Set log level successfully then true is returned, otherwise false is
+ * returned.
+ */
+extern bool xlog_set_tag_level(const char *tag, const char *level);
+
 /**
  * @brief Control if the log type can output. No log type is output by default.
  * @param hide If hide is true, no log type is output, otherwise the log type
@@ -117,15 +661,37 @@ extern bool xlog_set_log_level(const char *level);
 extern void xlog_hide_log_type(bool hide);
 
 /**
- * @brief Initialize xlog.
- * @param ops API functions structure for xlog use.
- * If use xlog in multi-thread os, must to implement lock(), unlock(), acquire_console(),
- * release_console() API functions to protect the log buffer and console.
- * lock() and unlock() API functions to protect the log buffer, it can be impemented from
- * mutex lock.
- * acquire_console() and release_console() API functions to protect the console, it can
- * be implemented from binary semaphore.
- * print() API function must be implemented to output message.
+ * @brief Default print_v() API function, writes a batch of segments to stdout.
+ * It maps to writev() on Linux, which is called again for what a signal leaves
+ * unwritten. On the target the segments are gathered in a buffer of
+ * CONFIG_XLOG_PRINT_V_BUF_SIZE bytes and written with one fwrite(), so it must
+ * be called with the console held.
+ * @param iov Segments to write.
+ * @param count Number of segments.
+ * 
+ * @retval None
+ */
+extern void xlog_print_v(const xlog_iovec_t *iov, uint32_t count);
+
+/**
+ * @brief Default get_persist() API function. On Linux it maps the file
+ * CONFIG_XLOG_PERSIST_FILE, created or resized as needed, elsewhere there is
+ * no region and the built-in one is used.
+ * @param size Size of the persistent log region.
+ * 
+ * @retval The region mapped, NULL if there is none.
+ */
+extern void *xlog_get_persist(uint32_t size);
+
+/**
+ * @brief Initialize xlog: take the API functions, empty the log buffer and reset
+ * the log levels, the tags, the sinks and the statistics. With CONFIG_XLOG_PERSIST
+ * defined the persistent log region is checked instead of emptied, and the lines
+ * the previous boot left in there are printed once more, followed by a line telling
+ * how many they were.
+ * @param ops API functions structure for xlog use, see xlog_ops_t. print() or
+ * print_v() must be implemented, in multi-thread os lock(), unlock(),
+ * acquire_console() and release_console() too.
  * 
  * @retval None
  */
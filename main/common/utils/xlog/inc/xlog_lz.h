@@ -0,0 +1,97 @@
+/**
+ * @file common/utils/xlog/inc/xlog_lz.h
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_lz.h is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ */
+#ifndef __XLOG_LZ_H
+#define __XLOG_LZ_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*---------- includes ----------*/
+#include "xlog.h"
+
+/*---------- macro ----------*/
+/* history the matches are searched in(up to 2^16 bytes, the offsets are 16 bits),
+ * the hash table of the positions and the output gathered before it is written,
+ * about 6.3KiB with the defaults
+ */
+#ifndef CONFIG_XLOG_LZ_WINDOW_SHIFT
+#define CONFIG_XLOG_LZ_WINDOW_SHIFT         (12)
+#endif
+#ifndef CONFIG_XLOG_LZ_HASH_SHIFT
+#define CONFIG_XLOG_LZ_HASH_SHIFT           (10)
+#endif
+#ifndef CONFIG_XLOG_LZ_OUT_SIZE
+#define CONFIG_XLOG_LZ_OUT_SIZE             (128)
+#endif
+
+/* a sequence holds the offset of its match in 2 bytes */
+_Static_assert(CONFIG_XLOG_LZ_WINDOW_SHIFT <= 16, "CONFIG_XLOG_LZ_WINDOW_SHIFT must not be above 16");
+
+/*---------- type define ----------*/
+/* state of a compressed stream, see xlog_lz_write()
+ */
+typedef struct xlog_lz {
+    uint32_t pos;                                   /*<< bytes of history, the dictionary included */
+    uint32_t hashed;                                /*<< positions below it are in the hash table */
+    uint32_t out_len;
+    uint16_t hash[1UL << CONFIG_XLOG_LZ_HASH_SHIFT];    /*<< last position of a 4-byte hash, 16 bits of it */
+    uint8_t history[1UL << CONFIG_XLOG_LZ_WINDOW_SHIFT];
+    uint8_t out[CONFIG_XLOG_LZ_OUT_SIZE];
+} xlog_lz_t;
+
+/*---------- variable prototype ----------*/
+/*---------- function prototype ----------*/
+/**
+ * @brief Start a new compressed stream. The history is seeded with a static
+ * dictionary of the prefixes xlog puts out, color escapes, timestamps and
+ * marker lines, so that even the first lines compress. A sink with a compressor
+ * is reset by xlog_add_sink().
+ * @param lz State of the stream.
+ *
+ * @retval None
+ */
+extern void xlog_lz_reset(xlog_lz_t *lz);
+
+/**
+ * @brief Compress a chunk of the stream and write it, CONFIG_XLOG_LZ_OUT_SIZE
+ * bytes at a time. The stream is LZ77 over a history of 2^CONFIG_XLOG_LZ_WINDOW_SHIFT
+ * bytes, as sequences of a token(literal count << 4 | match length - 4, either
+ * one extended by bytes of 255 and a last one below), the literals and the
+ * offset of the match(16 bits, little endian). An offset of 0 ends the chunk
+ * without match, so everything given is written on return and can be decoded
+ * by tools/xlog_lz.py, which must get the chunks of the stream in order.
+ * @param lz State of the stream.
+ * @param s Chunk to be compressed.
+ * @param len Length of the chunk.
+ * @param write Gets the compressed data.
+ *
+ * @retval None
+ */
+extern void xlog_lz_write(xlog_lz_t *lz, const char *s, uint32_t len, xlog_print_func_t write);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __XLOG_LZ_H */
@@ -23,9 +23,36 @@
 
 /*---------- includes ----------*/
 #include "xlog.h"
+#include "xlog_lz.h"
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
+#include <wchar.h>
+#ifdef __linux__
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/* segments handed to print_v() in one call
+ */
+#ifndef CONFIG_XLOG_IOV_MAX
+#define CONFIG_XLOG_IOV_MAX                 (16)
+#endif
+
+/* buffer xlog_print_v() gathers the segments in before writing them, off Linux
+ */
+#ifndef CONFIG_XLOG_PRINT_V_BUF_SIZE
+#define CONFIG_XLOG_PRINT_V_BUF_SIZE        (512)
+#endif
+
+/* file xlog_get_persist() maps on Linux
+ */
+#ifndef CONFIG_XLOG_PERSIST_FILE
+#define CONFIG_XLOG_PERSIST_FILE            "xlog.persist"
+#endif
 
 #ifdef CONFIG_USE_XLOG
 /*---------- macro ----------*/
@@ -37,31 +64,475 @@
 #define __LOG_BUF_LEN                       (1UL << CONFIG_XLOG_BUF_SHIFT)
 #define LOG_BUF_MASK                        (__LOG_BUF_LEN - 1)
 #define LOG_BUF(off)                        (log_buf[(off) & LOG_BUF_MASK])
+#define LOG_COPY_INLINE                     (16)    /*<< spans up to this length are copied without memcpy */
+/* commit marks of lockless mode, one per 2^LOG_MARK_SHIFT bytes of the log buffer.
+ * A record is longer than that, so no two records the producers can reach
+ * start in the same one.
+ */
+#define LOG_MARK_SHIFT                      (4)
+#define LOG_MARK(off)                       (log_marks[((off) & LOG_BUF_MASK) >> LOG_MARK_SHIFT])
 
 /* default log level
  */
 #define DEFAULT_MESSAGE_LOG_LEVEL           (1)     /*<< LOG_WARN */
 #define DEFAULT_CONSOLE_LOG_LEVEL           (4)     /*<< anything more serious than LOG_INFO */
 
+/* line prefix: color + "[%Y-%m-%d %H:%M:%S]" + "<t>", rendered by the console
+ */
+#define LOG_PREFIX_SIZE                     (48)
+#define LOG_TIME_SIZE                       (24)
+#define CONSOLE_PREFIX_SIZE                 (LOG_PREFIX_SIZE * 4)
+
+/* log records, a line longer than LOG_TEXT_MAX is split into continued records
+ */
+#define LOG_TEXT_MAX                        (__LOG_BUF_LEN / 4)
+#define LOG_TAG_NONE                        (0xFFFF)
+#define LOG_REC_CONT                        (1U << 0)   /*<< continues the line of the previous record, no prefix */
+#define LOG_REC_BREAK                       (1U << 1)   /*<< ends the line of the previous record first */
+#define LOG_REC_TIME                        (1U << 2)   /*<< ts is valid */
+#define LOG_REC_BIN                         (1U << 3)   /*<< binary record, see xlog_bin() */
+#define LOG_REC_EOL                         (1U << 4)   /*<< the binary record ends its line */
+#define LOG_REC_FLAGS                       (LOG_REC_CONT | LOG_REC_BREAK | LOG_REC_TIME | LOG_REC_BIN | LOG_REC_EOL)
+
+/* marker line printed in place of lost lines
+ */
+#define LOG_LOST_LEVEL                      (1)     /*<< LOG_WARN */
+#define LOG_LOST_TEXT                       " lines lost\n"
+#define LOG_LOST_SIZE                       (24)
+#define LOG_LOST_MAX                        (0xFFFF)    /*<< most lines a record can report */
+
+/* rows of xlog_hexdump(): offset, LOG_HEX_ROW bytes in hex and their ASCII
+ */
+#define LOG_HEX_ROW                         (16)
+#define LOG_HEX_ROW_SIZE                    (8 + 1 + LOG_HEX_ROW * 3 + 1 + 3 + LOG_HEX_ROW + 2)
+#define LOG_HEX_TAG_MAX                     (LOG_TEXT_MAX - LOG_HEX_ROW_SIZE - 2)   /*<< longest tag put in front of a row */
+#if defined(CONFIG_XLOG_LOCKLESS) && (LOG_TEXT_MAX < (LOG_HEX_ROW_SIZE + 2))
+#error "CONFIG_XLOG_BUF_SHIFT is too small for a row of xlog_hexdump() to fit into a record"
+#endif
+
+/* With CONFIG_XLOG_DEDUP defined, a line repeating the line logged last is not
+ * stored, the next line which differs is preceded by "last message repeated N
+ * times". Only whole lines logged by one call are collapsed, and not in lockless
+ * mode. Duplicates collapsed for CONFIG_XLOG_DEDUP_FLUSH_MS are reported by
+ * xlog_process(), or in front of the next duplicate, which is then stored, so a
+ * line repeated for good is still seen. That takes the time of the rate limits.
+ */
+#define LOG_REPEAT_TEXT                     "last message repeated "
+#define LOG_REPEAT_TIMES                    " times\n"
+#define LOG_REPEAT_SIZE                     (40)
+#ifndef CONFIG_XLOG_DEDUP_FLUSH_MS
+#define CONFIG_XLOG_DEDUP_FLUSH_MS          (30000)
+#endif
+
+#ifdef CONFIG_XLOG_BINARY
+/* With CONFIG_XLOG_BINARY defined the console, the sinks and xlog_read() put
+ * out every record as a frame: LOG_FRAME_SYNC, the length of the rest of the
+ * frame as a varint, the LOG_REC_* flags shifted left by 2 above the log level,
+ * the timestamp as a varint and the text of the record. A timestamp is the zigzag
+ * encoded difference to the one of the frame before, unless LOG_FRAME_ABS is set,
+ * which it is whenever the bits above LOG_FRAME_TS_SHIFT change. The lines are
+ * ended by the frames, the outputs never put a line break of their own.
+ */
+#define LOG_FRAME_SYNC                      (0xA5)
+#define LOG_FRAME_ABS                       (1U << 7)
+#ifdef CONFIG_XLOG_TIMESTAMP_MONOTONIC
+#define LOG_FRAME_TS_SHIFT                  (24)    /*<< about 16 seconds */
+#else
+#define LOG_FRAME_TS_SHIFT                  (8)
+#endif
+#define LOG_BIN_SIZE                        (5 + XLOG_BIN_ARGS_MAX * (5 + CONFIG_XLOG_BIN_STR_MAX))
+#define LOG_ENDS_LINE(c)                    (true)
+#define LOG_REC_PREFIXED(rec)               (true)
+#else
+#define LOG_ENDS_LINE(c)                    ((c) == '\n')
+#define LOG_REC_PREFIXED(rec)               (!((rec)->flags & LOG_REC_CONT))
+#endif
+
+/* log sinks, every sink renders its lines into a buffer of its own, which must
+ * hold at least a line break, a marker line and a prefix(SINK_RESERVE chars)
+ */
+#ifndef CONFIG_XLOG_SINK_MAX
+#define CONFIG_XLOG_SINK_MAX                (2)
+#endif
+#ifndef CONFIG_XLOG_SINK_BUF_SIZE
+#define CONFIG_XLOG_SINK_BUF_SIZE           (256)
+#endif
+#define SINK_RESERVE                        (1 + LOG_PREFIX_SIZE + LOG_LOST_SIZE + LOG_PREFIX_SIZE)
+
+/* formatter limits, floating point, pointer and wide char conversions are
+ * printed one by one by snprintf() into a buffer of LOG_CONV_SIZE chars on the
+ * stack, a longer spec is put as it is
+ */
+#define LOG_CONV_MAX                        (16)    /*<< longest conversion spec */
+#define LOG_CONV_SIZE                       (64)
+#define SPEC_LEFT                           (1UL << 0)
+#define SPEC_PLUS                           (1UL << 1)
+#define SPEC_SPACE                          (1UL << 2)
+#define SPEC_ALT                            (1UL << 3)
+#define SPEC_ZERO                           (1UL << 4)
+
+/* tag registry, a tag level of 0 follows the console log level. The names are
+ * copied, up to CONFIG_XLOG_TAG_NAME_SIZE - 1 chars of them tell the tags apart.
+ */
+#ifndef CONFIG_XLOG_TAG_MAX
+#define CONFIG_XLOG_TAG_MAX                 (16)
+#endif
+#ifndef CONFIG_XLOG_TAG_NAME_SIZE
+#define CONFIG_XLOG_TAG_NAME_SIZE           (16)
+#endif
+#define TAG_LEVEL_CONSOLE                   (0)
+#define TAG_FREE                            (0)
+#define TAG_NAMING                          (1)
+#define TAG_NAMED                           (2)
+
+/* storage class of the state of the task logging, which continues a line
+ * with LOG_CONT
+ */
+#ifndef CONFIG_XLOG_THREAD_LOCAL
+#define CONFIG_XLOG_THREAD_LOCAL            __thread
+#endif
+
+#ifdef CONFIG_XLOG_LOCKLESS
+/* In lockless mode every producer formats into a staging buffer on its own
+ * stack, so the size of one xlog() call output is limited by this value.
+ */
+#ifndef CONFIG_XLOG_LINE_SIZE
+#define CONFIG_XLOG_LINE_SIZE               (256)
+#endif
+/* A producer finding the log buffer full prints it, or waits for the task
+ * printing it with the yield() API function, up to this many times before
+ * its line is dropped.
+ */
+#ifndef CONFIG_XLOG_RESERVE_WAITS
+#define CONFIG_XLOG_RESERVE_WAITS           (100)
+#endif
+#endif
+
+#if defined(CONFIG_XLOG_DEFERRED) || defined(CONFIG_XLOG_ISR)
+#ifndef CONFIG_XLOG_DEFERRED_ARGS
+#define CONFIG_XLOG_DEFERRED_ARGS           (8)     /*<< argument words a deferred record can carry */
+#endif
+#endif
+
+#ifdef CONFIG_XLOG_DEFERRED
+/* deferred record queue, the number of slots must be power of 2
+ */
+#ifndef CONFIG_XLOG_DEFERRED_SLOTS
+#define CONFIG_XLOG_DEFERRED_SLOTS          (32)
+#endif
+#define DEFERRED_MASK                       (CONFIG_XLOG_DEFERRED_SLOTS - 1)
+#endif
+
+#ifdef CONFIG_XLOG_ISR
+/* staging rings of xlog_from_isr(), one per core, the number of slots must be
+ * power of 2
+ */
+#ifndef CONFIG_XLOG_ISR_CORES
+#define CONFIG_XLOG_ISR_CORES               (2)
+#endif
+#ifndef CONFIG_XLOG_ISR_SLOTS
+#define CONFIG_XLOG_ISR_SLOTS               (8)
+#endif
+#define ISR_MASK                            (CONFIG_XLOG_ISR_SLOTS - 1)
+#endif
+
+#ifdef CONFIG_XLOG_PERSIST
+/* With CONFIG_XLOG_PERSIST defined, the log buffer lives in a persistent log
+ * region which survives resets, eg. the watchdog reset following an assert: a
+ * section the startup code does not clear, unless the get_persist() API function
+ * provides one. Every record carries a checksum of its header and text, the
+ * records from the last one failing it on are printed once more by xlog_init().
+ * Keeping the region costs a checksum over every line logged, 8 more bytes per
+ * line and a few stores.
+ */
+#ifndef CONFIG_XLOG_PERSIST_SECTION
+#define CONFIG_XLOG_PERSIST_SECTION         ".noinit"
+#endif
+#define PERSIST_MAGIC                       (0x584C4F47UL)  /*<< "XLOG" */
+#endif
+
+#ifdef CONFIG_XLOG_ASYNC
+/* backlog of the log buffer above which the overflow policy applies
+ */
+#ifndef CONFIG_XLOG_ASYNC_WATERMARK
+#define CONFIG_XLOG_ASYNC_WATERMARK         ((__LOG_BUF_LEN * 3) / 4)
+#endif
+#ifndef CONFIG_XLOG_ASYNC_POLICY
+#define CONFIG_XLOG_ASYNC_POLICY            XLOG_ASYNC_BLOCK
+#endif
+#endif
+
 /*---------- type define ----------*/
+/* With CONFIG_XLOG_TIMESTAMP_MONOTONIC defined, timestamps are microseconds
+ * from get_timestamp_us(), otherwise seconds from get_timestamp().
+ */
+#ifdef CONFIG_XLOG_TIMESTAMP_MONOTONIC
+typedef uint64_t log_time_t;
+#else
+typedef time_t log_time_t;
+
+struct log_time_cache {
+    uint32_t seq;
+    uint32_t len;
+    time_t utc;
+    char str[LOG_TIME_SIZE];
+};
+#endif
+
+/* Every line in the log buffer is a record: this header followed by len chars
+ * of text, the prefix of the line is only rendered when it is printed. The
+ * header is copied in and out of the log buffer, as it may wrap around.
+ */
+struct log_record {
+    log_time_t ts;                                  /*<< time the line was logged */
+    uint64_t seq;                                   /*<< sequence number */
+    uint16_t len;                                   /*<< length of the text */
+    uint16_t tag;                                   /*<< tag id, LOG_TAG_NONE if the line has no tag */
+    uint16_t lost;                                  /*<< lines lost right before this record */
+    uint8_t level;
+    uint8_t flags;                                  /*<< LOG_REC_* */
+#ifdef CONFIG_XLOG_PERSIST
+    uint32_t sum;                                   /*<< checksum of the record, see _record_sum() */
+#endif
+};
+
 struct xlog_describe {
     struct {
         uint32_t default_level;
         uint32_t console_level;
+        uint32_t sink_level;                        /*<< most verbose level of the sinks, 0 without sinks */
     } log_level;
     bool hide_log_type;
+#ifdef CONFIG_XLOG_ASYNC
+    struct {
+        xlog_async_policy_t policy;
+        xlog_async_stats_t stats;
+    } async;
+#endif
     xlog_ops_t ops;
 };
 
+enum {
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_SIZE,
+    ARG_PTR,
+    ARG_DOUBLE,
+    ARG_STR,
+    ARG_LDOUBLE,
+    ARG_WINT,
+    ARG_WSTR,
+    ARG_COUNT,
+    ARG_UNSUPPORTED
+};
+
+struct xlog_conv {
+    const char *start;                              /*<< the '%' starting the conversion */
+    uint32_t len;                                   /*<< length of the conversion spec */
+    uint32_t stars;                                 /*<< number of '*' width and precision */
+    uint32_t type;                                  /*<< type of the argument */
+};
+
+/* parsed conversion spec
+ */
+struct log_spec {
+    uint32_t flags;                                 /*<< SPEC_* */
+    uint32_t width;
+    int32_t prec;                                   /*<< -1 when there is no precision */
+    uint32_t size;                                  /*<< size of a "hh" or "h" argument, 0 otherwise */
+    char conv;
+};
+
+/* an argument of a conversion, integers are kept sign extended
+ */
+union log_arg {
+    long long i;
+    double d;
+    long double ld;
+    const char *s;
+    void *p;
+};
+
+/* formatter output, put() is called for every span of the formatted text
+ */
+struct log_out {
+    void (*put)(struct log_out *out, const char *s, uint32_t len);
+    uint32_t len;                                   /*<< chars put so far */
+};
+
+#ifdef CONFIG_XLOG_LOCKLESS
+struct log_out_buf {
+    struct log_out out;
+    char *buf;
+    uint32_t size;
+};
+#else
+/* formats straight into the log buffer, one record per line
+ */
+struct log_out_ring {
+    struct log_out out;
+    struct log_record rec;                          /*<< header of the open record */
+    uint32_t rec_off;                               /*<< where the header of the open record goes */
+    bool open;
+    bool line_break;                                /*<< the next record gets LOG_REC_BREAK */
+    uint32_t start;                                 /*<< log_end before the message */
+    bool text_line;                                 /*<< next_text_line before the message */
+    bool full;                                      /*<< no room was left, the message is dropped */
+    uint32_t count;                                 /*<< records opened */
+    uint32_t lost;                                  /*<< lines lost reported by the records opened */
+};
+#endif
+
+#if defined(CONFIG_XLOG_DEFERRED) || defined(CONFIG_XLOG_ISR)
+struct xlog_deferred {
+    uint32_t seq;
+    uint16_t tag;
+    bool timed;                                     /*<< ts is valid */
+    const char *fmt;
+    log_time_t ts;
+    uint32_t args[CONFIG_XLOG_DEFERRED_ARGS];
+};
+#endif
+
+#ifdef CONFIG_XLOG_ISR
+/* Lines logged from interrupts of one core. Only the interrupts of that core
+ * push into the ring, and only one task at a time pops from it.
+ */
+struct xlog_isr_ring {
+    uint32_t head;                                  /*<< Index into slots: next slot to be claimed */
+    uint32_t tail;                                  /*<< Index into slots: next slot to be merged */
+    uint32_t order[CONFIG_XLOG_ISR_SLOTS];          /*<< isr_order of the line in the slot */
+    uint32_t lost[CONFIG_XLOG_ISR_SLOTS];           /*<< lines not staged right before the line in the slot */
+    struct xlog_deferred slots[CONFIG_XLOG_ISR_SLOTS];
+    uint32_t pending_lost;                          /*<< lines not staged since the last line staged */
+    uint32_t dropped[XLOG_LEVEL_COUNT];             /*<< lines which could not be staged */
+};
+#endif
+
+#ifdef CONFIG_XLOG_PERSIST
+/* Where the records kept start and end. It is saved into two slots in turn, so
+ * that one of them is whole when a reset hits while the other one is saved.
+ */
+struct xlog_persist_slot {
+    uint32_t first;                                 /*<< log_first */
+    uint32_t end;                                   /*<< end of the records committed */
+    uint32_t sum;
+};
+
+struct xlog_persist {
+    uint32_t magic;
+    uint32_t size;                                  /*<< size of buf */
+    uint32_t gen;                                   /*<< slots[(gen / 2) % 2] is saved next, odd while it is saved */
+    struct xlog_persist_slot slots[2];
+    char buf[__LOG_BUF_LEN];
+};
+#endif
+
+/* A reader walks the records from a cursor of its own without any lock, a
+ * record copied out is only used once log_first shows it was not overwritten
+ * meanwhile. The records overwritten before it got to them are lost to this
+ * reader only.
+ */
+struct log_reader {
+    uint32_t off;                                   /*<< Index into log_buf: next record to be read */
+    uint64_t seq;                                   /*<< sequence number of the next record, once a record is read */
+    bool read;                                      /*<< seq is valid */
+    bool overrun;                                   /*<< the cursor has been moved to log_first */
+};
+
+/* A sink reads the records with a reader of its own and renders them into buf.
+ */
+struct log_sink {
+    xlog_sink_t ops;
+    struct log_reader reader;
+    uint32_t level;                                 /*<< lines of a level below it are written */
+    uint32_t len;                                   /*<< chars rendered into buf */
+    bool used;
+    bool busy;
+    bool skip;                                      /*<< the line being read is filtered */
+    bool new_line;                                  /*<< buf ends at the start of a line */
+    log_time_t ts;                                  /*<< timestamp of the last frame, CONFIG_XLOG_BINARY */
+    char buf[CONFIG_XLOG_SINK_BUF_SIZE];
+};
+
 /*---------- variable prototype ----------*/
 /*---------- function prototype ----------*/
+#ifdef CONFIG_XLOG_BINARY
+static uint32_t _format_prefix(char *buf, const struct log_record *rec, log_time_t *last);
+#else
+/* the timestamp of a line is printed whole, only a frame is relative to the last one */
+static uint32_t __format_prefix(char *buf, const struct log_record *rec);
+#define _format_prefix(buf, rec, last)      __format_prefix(buf, rec)
+#endif
+static uint32_t _format_decimal(char *buf, uint32_t value, uint32_t width, char pad);
+
 /*---------- variable ----------*/
 static struct xlog_describe _xlog;
+static uint32_t log_first = 0;                      /*<< Index into log_buf: oldest record kept for the sinks */
 static uint32_t log_start = 0;                      /*<< Index into log_buf: next char to be sent to consoles */
 static uint32_t log_end = 0;                        /*<< Index into log_buf: most-recenrly-written + 1 */
+#ifndef CONFIG_XLOG_LOCKLESS
+static uint32_t log_commit = 0;                     /*<< Index into log_buf: end of the records the sinks can read */
+#endif
+#ifdef CONFIG_XLOG_LOCKLESS
+static uint32_t log_reserve = 0;                    /*<< Index into log_buf: most-recently-reserved + 1 */
+static bool log_marks[__LOG_BUF_LEN >> LOG_MARK_SHIFT]; /*<< The record starting there is committed, not published yet */
+static bool log_publishing = false;                 /*<< A producer is publishing the records committed */
+#endif
+static uint64_t log_seq = 0;                        /*<< Sequence number of the next record */
+static uint32_t log_lost = 0;                       /*<< Newest lines dropped, reported by the next record */
+#ifndef CONFIG_XLOG_LOCKLESS
+static uint32_t log_lost_front = 0;                 /*<< Oldest lines dropped, reported by the console */
+static bool log_printing = false;                   /*<< The console is printing from log_start on */
+#endif
+static xlog_stats_t log_stats;
+#ifdef CONFIG_XLOG_PERSIST
+static struct xlog_persist persist_region __attribute__((section(CONFIG_XLOG_PERSIST_SECTION)));
+static struct xlog_persist *log_persist = &persist_region;
+static char *log_buf = persist_region.buf;
+#else
 static char log_buf[__LOG_BUF_LEN];
+#endif
 static bool next_text_line = true;
-static char vprintf_buf[__LOG_BUF_LEN];
+static CONFIG_XLOG_THREAD_LOCAL bool cont_filtered = false; /*<< The line the task continues by LOG_CONT was filtered */
+#if defined(CONFIG_XLOG_DEDUP) && !defined(CONFIG_XLOG_LOCKLESS)
+static uint32_t log_last = 0;                       /*<< Index into log_buf: record of the last message */
+static bool log_last_line = false;                  /*<< The last message is a whole line of one record */
+static uint32_t log_repeats = 0;                    /*<< Duplicates of the last message not reported yet */
+static uint32_t log_repeat_stamp = 0;               /*<< Time in microseconds the first of them was collapsed */
+static uint8_t log_repeat_level = 0;
+static uint16_t log_repeat_tag = LOG_TAG_NONE;
+#endif
+static char tag_names[CONFIG_XLOG_TAG_MAX][CONFIG_XLOG_TAG_NAME_SIZE];
+static uint8_t tag_states[CONFIG_XLOG_TAG_MAX];    /*<< TAG_FREE, TAG_NAMING or TAG_NAMED */
+static uint8_t tag_levels[CONFIG_XLOG_TAG_MAX + 1]; /*<< Last one is for the tags not registered */
+#ifdef CONFIG_XLOG_DEFERRED
+static struct xlog_deferred deferred_slots[CONFIG_XLOG_DEFERRED_SLOTS];
+static uint32_t deferred_head = 0;                  /*<< Index into deferred_slots: next slot to be claimed */
+static uint32_t deferred_tail = 0;                  /*<< Index into deferred_slots: next slot to be formatted */
+#ifdef CONFIG_XLOG_LOCKLESS
+static bool deferred_busy = false;                  /*<< A consumer is storing a record */
+#endif
+#endif
+#ifdef CONFIG_XLOG_ISR
+static struct xlog_isr_ring isr_rings[CONFIG_XLOG_ISR_CORES];
+static uint32_t isr_order = 0;                      /*<< Order of the next line logged from an interrupt */
+static bool isr_busy = false;
+#endif
+#ifndef CONFIG_XLOG_TIMESTAMP_MONOTONIC
+static struct log_time_cache time_cache;
+#endif
+static xlog_iovec_t console_iov[CONFIG_XLOG_IOV_MAX];      /*<< Segments not yet handed to print_v(), guarded by the console */
+static uint32_t console_iov_count = 0;
+static char console_prefix[CONSOLE_PREFIX_SIZE];    /*<< Prefixes rendered for console_iov */
+static uint32_t console_prefix_len = 0;
+static bool console_new_line = true;                /*<< The console is at the start of a line */
+static bool console_skip = false;                   /*<< The line being printed is filtered */
+static log_time_t console_ts = 0;                   /*<< Timestamp of the last frame printed, CONFIG_XLOG_BINARY */
+static struct log_sink log_sinks[CONFIG_XLOG_SINK_MAX];
+static const char hex_digits[] = "0123456789ABCDEF";
+#ifndef CONFIG_XLOG_BINARY
 static char log_level_char[] = {
     [0] = 'E',
     [1] = 'W',
@@ -74,242 +545,3629 @@ static char *log_level_color[] = {
     [2] = "\033[32;22m",
     [3] = "\033[37;22m"
 };
+#endif
+
+/*---------- function ----------*/
+static inline void __lock(void)
+{
+    if(_xlog.ops.lock) {
+        _xlog.ops.lock();
+    }
+}
+
+static inline void __unlock(void)
+{
+    if(_xlog.ops.unlock) {
+        _xlog.ops.unlock();
+    }
+}
+
+static inline void __suspend(void)
+{
+    if(_xlog.ops.suspend) {
+        _xlog.ops.suspend();
+    }
+}
+
+static inline void __resume(void)
+{
+    if(_xlog.ops.resume) {
+        _xlog.ops.resume();
+    }
+}
+
+static inline void __yield(void)
+{
+    if(_xlog.ops.yield) {
+        _xlog.ops.yield();
+    }
+}
+
+static inline void __notify(void)
+{
+    if(_xlog.ops.notify) {
+        _xlog.ops.notify();
+    }
+}
+
+static inline bool __acquire_console(void)
+{
+    bool retval = true;
+
+    if(_xlog.ops.acquire_console) {
+        retval = _xlog.ops.acquire_console();
+    }
+
+    return retval;
+}
+
+static inline void __release_console(void)
+{
+    if(_xlog.ops.release_console) {
+        _xlog.ops.release_console();
+    }
+}
+
+/* Print the batch. The output functions may have been changed since it was
+ * gathered, the segments are handed to print() one by one then.
+ */
+static inline void __console_flush(void)
+{
+    xlog_print_v_func_t print_v = __atomic_load_n(&_xlog.ops.print_v, __ATOMIC_ACQUIRE);
+    xlog_print_func_t print = __atomic_load_n(&_xlog.ops.print, __ATOMIC_ACQUIRE);
+
+    if(console_iov_count && print_v) {
+        print_v(console_iov, console_iov_count);
+    } else if(print) {
+        for(uint32_t i = 0; i < console_iov_count; ++i) {
+            print(console_iov[i].base, console_iov[i].len);
+        }
+    }
+    console_iov_count = 0;
+    console_prefix_len = 0;
+}
+
+/* Returns true when s is batched, it must be kept until the batch is printed.
+ */
+static inline bool __console_put(const char *s, uint32_t len)
+{
+    xlog_print_func_t print = NULL;
+    bool retval = false;
+
+    if(__atomic_load_n(&_xlog.ops.print_v, __ATOMIC_ACQUIRE)) {
+        /* batch the segments, print_v() is called once the batch is full or the
+         * console is drained
+         */
+        if(console_iov_count == CONFIG_XLOG_IOV_MAX) {
+            __console_flush();
+        }
+        console_iov[console_iov_count].base = s;
+        console_iov[console_iov_count].len = len;
+        console_iov_count++;
+        retval = true;
+    } else if((print = __atomic_load_n(&_xlog.ops.print, __ATOMIC_ACQUIRE)) != NULL) {
+        print(s, len);
+    }
+
+    return retval;
+}
+
+static inline void __console_print(uint32_t start, uint32_t end)
+{
+    __console_put(&LOG_BUF(start), end - start);
+}
+
+/* Render the prefix of a record, it is kept in console_prefix until the batch
+ * it belongs to is printed.
+ */
+static inline void __console_prefix(const struct log_record *rec)
+{
+    char *buf = NULL;
+    uint32_t len = 0;
+
+    if(console_iov_count == CONFIG_XLOG_IOV_MAX || (console_prefix_len + LOG_PREFIX_SIZE) > sizeof(console_prefix)) {
+        __console_flush();
+    }
+    buf = &console_prefix[console_prefix_len];
+    len = _format_prefix(buf, rec, &console_ts);
+    if(__console_put(buf, len)) {
+        console_prefix_len += len;
+    }
+}
+
+/* Build the marker line "N lines lost", up to LOG_PREFIX_SIZE + LOG_LOST_SIZE chars.
+ */
+static uint32_t _format_lost(char *buf, uint32_t lost)
+{
+    struct log_record rec;
+    char digits[10];
+    uint32_t len = 0, n = 0;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.level = LOG_LOST_LEVEL;
+    n = _format_decimal(digits, lost, 0, ' ');
+    rec.len = n + sizeof(LOG_LOST_TEXT) - 1;
+    len = _format_prefix(buf, &rec, NULL);
+    memcpy(&buf[len], digits, n);
+    memcpy(&buf[len + n], LOG_LOST_TEXT, sizeof(LOG_LOST_TEXT) - 1);
+
+    return len + rec.len;
+}
+
+/* Print the marker line "N lines lost" where lines have been dropped.
+ */
+static inline void __console_lost(uint32_t lost)
+{
+    char *buf = NULL;
+    uint32_t len = 0;
+
+    if(!console_new_line) {
+        __console_put("\n", 1);
+    }
+    if(console_iov_count == CONFIG_XLOG_IOV_MAX || (console_prefix_len + LOG_PREFIX_SIZE + LOG_LOST_SIZE) > sizeof(console_prefix)) {
+        __console_flush();
+    }
+    buf = &console_prefix[console_prefix_len];
+    len = _format_lost(buf, lost);
+    if(__console_put(buf, len)) {
+        console_prefix_len += len;
+    }
+    console_new_line = true;
+}
+
+/* The counters are guarded by the log buffer lock, in lockless mode they are
+ * updated with atomic operations instead.
+ */
+static inline void _stats_add(uint32_t *counter, uint32_t n)
+{
+#ifdef CONFIG_XLOG_LOCKLESS
+    __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+#else
+    *counter += n;
+#endif
+}
+
+/* Account lines which never reach the console. The marker line for them is
+ * printed by the console, see log_lost and log_lost_front.
+ */
+static inline void _stats_dropped(uint32_t level, uint32_t lines, uint32_t bytes)
+{
+    _stats_add(&log_stats.dropped[level], lines);
+    _stats_add(&log_stats.dropped_bytes[level], bytes);
+}
+
+/* Newest lines dropped are reported by the record stored next, or by the
+ * console once it has printed everything.
+ */
+static inline void _log_lost(uint32_t lines)
+{
+    __atomic_fetch_add(&log_lost, lines, __ATOMIC_RELAXED);
+}
+
+static inline uint16_t _log_take_lost(void)
+{
+    uint32_t lost = 0;
+
+    if(__atomic_load_n(&log_lost, __ATOMIC_RELAXED)) {
+        lost = __atomic_exchange_n(&log_lost, 0, __ATOMIC_RELAXED);
+        if(lost > LOG_LOST_MAX) {
+            _log_lost(lost - LOG_LOST_MAX);
+            lost = LOG_LOST_MAX;
+        }
+    }
+
+    return (uint16_t)lost;
+}
+
+static inline void _stats_watermark(uint32_t used)
+{
+#ifdef CONFIG_XLOG_LOCKLESS
+    uint32_t old = __atomic_load_n(&log_stats.high_watermark, __ATOMIC_RELAXED);
+
+    while(used > old && !__atomic_compare_exchange_n(&log_stats.high_watermark, &old, used, true,
+                                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+#else
+    if(used > log_stats.high_watermark) {
+        log_stats.high_watermark = used;
+    }
+#endif
+}
+
+/* Copy a span into the log buffer at off, split in two at the end of the buffer.
+ */
+static inline void _log_copy(uint32_t off, const char *s, uint32_t len)
+{
+    uint32_t idx = off & LOG_BUF_MASK;
+    uint32_t first = __LOG_BUF_LEN - idx;
+
+    if(len <= first && len <= LOG_COPY_INLINE) {
+        /* calling memcpy costs more than copying a short span inline */
+        for(uint32_t i = 0; i < len; ++i) {
+            log_buf[idx + i] = s[i];
+        }
+    } else if(len <= first) {
+        memcpy(&log_buf[idx], s, len);
+    } else {
+        memcpy(&log_buf[idx], s, first);
+        memcpy(log_buf, s + first, len - first);
+    }
+}
+
+/* Copy len bytes out of the log buffer at off, the reverse of _log_copy().
+ */
+static inline void _log_read(uint32_t off, void *dst, uint32_t len)
+{
+    uint32_t idx = off & LOG_BUF_MASK;
+    uint32_t first = __LOG_BUF_LEN - idx;
+
+    if(len <= first) {
+        memcpy(dst, &log_buf[idx], len);
+    } else {
+        memcpy(dst, &log_buf[idx], first);
+        memcpy((char *)dst + first, log_buf, len - first);
+    }
+}
+
+static inline uint32_t _log_readable(void)
+{
+#ifdef CONFIG_XLOG_LOCKLESS
+    return __atomic_load_n(&log_end, __ATOMIC_ACQUIRE);
+#else
+    return __atomic_load_n(&log_commit, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/* Check whether a record ends its line, end is where its text ends.
+ */
+static inline bool _record_ends_line(const struct log_record *rec, uint32_t end)
+{
+    bool retval = true;
+
+    if(rec->flags & LOG_REC_BIN) {
+        retval = !!(rec->flags & LOG_REC_EOL);
+    } else if(rec->len) {
+        retval = (LOG_BUF(end - 1) == '\n');
+    }
+
+    return retval;
+}
+
+#ifdef CONFIG_XLOG_PERSIST
+static inline uint32_t _fnv(uint32_t sum, const char *p, uint32_t len)
+{
+    for(uint32_t i = 0; i < len; ++i) {
+        sum = (sum ^ (uint8_t)p[i]) * 16777619UL;
+    }
+
+    return sum;
+}
+
+/* Checksum of a record: FNV-1a over its header up to the checksum, and over
+ * its text, which is in the log buffer from text on.
+ */
+static uint32_t _record_sum(const struct log_record *rec, uint32_t text)
+{
+    uint32_t sum = _fnv(2166136261UL, (const char *)rec, offsetof(struct log_record, sum));
+    uint32_t idx = text & LOG_BUF_MASK;
+    uint32_t first = __LOG_BUF_LEN - idx;
+
+    if(rec->len <= first) {
+        sum = _fnv(sum, &log_buf[idx], rec->len);
+    } else {
+        sum = _fnv(sum, &log_buf[idx], first);
+        sum = _fnv(sum, log_buf, rec->len - first);
+    }
+
+    return sum;
+}
+
+static uint32_t _persist_sum(uint32_t first, uint32_t end)
+{
+    uint32_t sum = 2166136261UL;
+
+    /* FNV-1a over the words */
+    sum = (sum ^ PERSIST_MAGIC) * 16777619UL;
+    sum = (sum ^ first) * 16777619UL;
+    sum = (sum ^ end) * 16777619UL;
+
+    return sum;
+}
+#endif
+
+/* Write the header of a record at off, its text must be in the log buffer
+ * already, as it is covered by the checksum of the record with CONFIG_XLOG_PERSIST.
+ */
+static inline void _record_put(uint32_t off, struct log_record *rec)
+{
+#ifdef CONFIG_XLOG_PERSIST
+    rec->sum = _record_sum(rec, off + sizeof(*rec));
+#endif
+    _log_copy(off, (const char *)rec, sizeof(*rec));
+}
+
+/* Save where the records kept start and end into the persistent log region. It
+ * is called once log_first has moved, before the records passed are overwritten,
+ * and once records are committed. In lockless mode a producer finding a slot
+ * being saved leaves it to the next one, _persist_restore() copes with a log_first
+ * saved late.
+ */
+static inline void _persist_save(void)
+{
+#ifdef CONFIG_XLOG_PERSIST
+    struct xlog_persist_slot *slot = NULL;
+    uint32_t gen = __atomic_load_n(&log_persist->gen, __ATOMIC_RELAXED), first = 0, end = 0;
+
+#ifdef CONFIG_XLOG_LOCKLESS
+    if((gen & 1) || !__atomic_compare_exchange_n(&log_persist->gen, &gen, gen + 1, false,
+                                                 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return;
+    }
+#endif
+    end = _log_readable();
+    first = __atomic_load_n(&log_first, __ATOMIC_ACQUIRE);
+    slot = &log_persist->slots[(gen >> 1) & 1];
+    slot->first = first;
+    slot->end = end;
+    slot->sum = _persist_sum(first, end);
+    __atomic_store_n(&log_persist->gen, gen + 2, __ATOMIC_RELEASE);
+#endif
+}
+
+#ifdef CONFIG_XLOG_PERSIST
+/* Check that the records from off on chain up to end, with consecutive sequence
+ * numbers and checksums which match. *seq gets the sequence number following the last record, *text_line
+ * whether the last record ends its line.
+ * Returns the number of records, 0 if they do not chain up to end.
+ */
+static uint32_t _persist_chain(uint32_t off, uint32_t end, uint64_t *seq, bool *text_line)
+{
+    struct log_record rec;
+    uint32_t count = 0;
+
+    while((int32_t)(end - off) >= (int32_t)sizeof(rec)) {
+        _log_read(off, &rec, sizeof(rec));
+        if(rec.len > LOG_TEXT_MAX || rec.level >= XLOG_LEVEL_COUNT ||
+           (rec.flags & ~LOG_REC_FLAGS) || (count && rec.seq != *seq) ||
+           (int32_t)(end - off - sizeof(rec)) < (int32_t)rec.len ||
+           rec.sum != _record_sum(&rec, off + sizeof(rec))) {
+            break;
+        }
+        off += sizeof(rec) + rec.len;
+        *seq = rec.seq + 1;
+        *text_line = _record_ends_line(&rec, off);
+        count++;
+    }
+
+    return (off == end) ? count : 0;
+}
+
+/* Take the records the previous boot left in the persistent log region, once the
+ * region and the slot saved last check out. A log_first saved late in lockless
+ * mode may point at a record overwritten already, and a record may have been
+ * corrupted, the first record chaining up to the end is then searched from there on.
+ * Returns the number of records restored.
+ */
+static uint32_t _persist_restore(void)
+{
+    const struct xlog_persist_slot *slot = NULL, *s = NULL;
+    uint32_t count = 0, first = 0;
+    uint64_t seq = 0;
+    bool text_line = true;
+
+    if(log_persist->magic == PERSIST_MAGIC && log_persist->size == __LOG_BUF_LEN) {
+        for(uint32_t i = 0; i < 2; ++i) {
+            s = &log_persist->slots[i];
+            if(s->sum == _persist_sum(s->first, s->end) && (s->end - s->first) <= __LOG_BUF_LEN &&
+               (!slot || (int32_t)(s->end - slot->end) > 0)) {
+                slot = s;
+            }
+        }
+    }
+    if(slot) {
+        for(first = slot->first; first != slot->end; ++first) {
+            count = _persist_chain(first, slot->end, &seq, &text_line);
+            if(count) {
+                break;
+            }
+        }
+    }
+    if(count) {
+        /* the console prints the records once more, and the sinks start with them */
+        log_first = first;
+        log_start = first;
+        log_end = slot->end;
+#ifdef CONFIG_XLOG_LOCKLESS
+        log_reserve = log_end;
+#else
+        log_commit = log_end;
+#endif
+        log_seq = seq;
+        next_text_line = text_line;
+    }
+    log_persist->magic = PERSIST_MAGIC;
+    log_persist->size = __LOG_BUF_LEN;
+    log_persist->gen = 0;
+    _persist_save();
+
+    return count;
+}
+#endif
+
+#ifdef CONFIG_XLOG_LOCKLESS
+/* Reserve a byte range of the log buffer. The range is claimed by moving
+ * log_reserve with compare-and-swap, so producers on both cores never wait
+ * for each other here. Unlike the locked path, which drops the oldest lines
+ * when the console is not printing them, the oldest bytes are never
+ * overwritten: they may still be read by the console. The room is only given
+ * back by the console, see _log_wait_room().
+ */
+static bool _log_reserve(uint32_t len, uint32_t *off)
+{
+    uint32_t head = __atomic_load_n(&log_reserve, __ATOMIC_RELAXED);
+    uint32_t start = 0;
+
+    do {
+        start = __atomic_load_n(&log_start, __ATOMIC_ACQUIRE);
+        if((head + len - start) > __LOG_BUF_LEN) {
+            return false;
+        }
+    } while(!__atomic_compare_exchange_n(&log_reserve, &head, head + len, true,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    *off = head;
+
+    return true;
+}
+
+/* Move log_first past the records a reserved range up to end overwrites, they
+ * have all been printed by the console, see _log_reserve(). A header overwritten
+ * while it is read fails the compare-and-swap, as log_first has been moved past
+ * it by then.
+ */
+static void _log_first_advance(uint32_t end)
+{
+    struct log_record rec;
+    uint32_t first = __atomic_load_n(&log_first, __ATOMIC_RELAXED), next = 0;
+
+    while((int32_t)(end - first) > (int32_t)__LOG_BUF_LEN) {
+        _log_read(first, &rec, sizeof(rec));
+        next = first + sizeof(rec) + rec.len;
+        if(__atomic_compare_exchange_n(&log_first, &first, next, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            first = next;
+            _persist_save();
+        }
+    }
+    /* ordered before the records are overwritten, see _log_intact() */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/* Publish the records committed at log_end, in the order they were reserved.
+ * One producer publishes at a time, it gives every record its sequence number,
+ * and its checksum with CONFIG_XLOG_PERSIST, and moves log_end past it. A
+ * producer finding another one publishing leaves its records to it, the
+ * publisher looks for them once more after it is done. So a record is published
+ * as soon as the records reserved before it are committed, a producer preempted
+ * while copying its range only holds back the records reserved after it.
+ */
+static void _log_publish(void)
+{
+    struct log_record rec;
+    uint32_t end = 0;
+    bool published = false;
+
+    while(!__atomic_exchange_n(&log_publishing, true, __ATOMIC_SEQ_CST)) {
+        end = __atomic_load_n(&log_end, __ATOMIC_RELAXED);
+        published = false;
+        while(__atomic_load_n(&LOG_MARK(end), __ATOMIC_ACQUIRE)) {
+            /* cleared before log_end moves, the next record starting there is reserved after that */
+            __atomic_store_n(&LOG_MARK(end), false, __ATOMIC_RELAXED);
+            _log_read(end, &rec, sizeof(rec));
+            rec.seq = log_seq;
+            _record_put(end, &rec);
+            __atomic_store_n(&log_seq, log_seq + 1, __ATOMIC_RELAXED);
+            end += sizeof(rec) + rec.len;
+            __atomic_store_n(&log_end, end, __ATOMIC_RELEASE);
+            published = true;
+        }
+        if(published) {
+            _persist_save();
+        }
+        __atomic_store_n(&log_publishing, false, __ATOMIC_SEQ_CST);
+        /* a record committed by a producer which found log_publishing set */
+        if(!__atomic_load_n(&LOG_MARK(end), __ATOMIC_SEQ_CST)) {
+            break;
+        }
+    }
+}
+#else
+/* Drop the oldest record, the console reports it with the next batch. It must
+ * not be printing, see _log_reclaim().
+ */
+static void _log_drop_oldest(void)
+{
+    struct log_record rec;
+
+    _log_read(log_start, &rec, sizeof(rec));
+    log_start += sizeof(rec) + rec.len;
+    _stats_dropped(rec.level, 1, rec.len);
+    log_lost_front += 1 + rec.lost;
+}
+
+/* Drop the oldest records as a whole until len more bytes fit. A record is
+ * never longer than LOG_TEXT_MAX, so the one being written is never dropped.
+ * The console reports the records it had not printed yet, the sinks find the
+ * records they missed from log_first. The records the console is printing
+ * are never dropped, like in lockless mode.
+ * Returns false when len bytes do not fit before them.
+ */
+static bool _log_reclaim(uint32_t len)
+{
+    struct log_record rec;
+    uint32_t first = log_first;
+    bool retval = true;
+
+    while((log_end + len - first) > __LOG_BUF_LEN) {
+        if(first != log_start) {
+            _log_read(first, &rec, sizeof(rec));
+            first += sizeof(rec) + rec.len;
+        } else if(!log_printing) {
+            _log_drop_oldest();
+            first = log_start;
+        } else {
+            retval = false;
+            break;
+        }
+    }
+    if(first != log_first) {
+        __atomic_store_n(&log_first, first, __ATOMIC_RELAXED);
+        _persist_save();
+        /* ordered before the records are overwritten, see _log_intact() */
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+
+    return retval;
+}
+
+/* Make room for len more bytes. Once there is no room left, nothing more of
+ * the message is copied into the log buffer and _log_end() drops it.
+ */
+static inline bool _log_room(struct log_out_ring *ring, uint32_t len)
+{
+    if(!ring->full && (log_end + len - log_first) > __LOG_BUF_LEN) {
+        ring->full = !_log_reclaim(len);
+    }
+
+    return !ring->full;
+}
+
+static void emit_log_bytes(struct log_out_ring *ring, const char *s, uint32_t len)
+{
+    if(_log_room(ring, len)) {
+        _log_copy(log_end, s, len);
+    }
+    log_end += len;
+}
+
+/* Take a message back out of the log buffer, from ring->start on.
+ */
+static void _log_rewind(const struct log_out_ring *ring)
+{
+    log_end = ring->start;
+    next_text_line = ring->text_line;
+    /* a message longer than the free space has dropped the oldest lines */
+    if((int32_t)(log_start - log_end) > 0) {
+        log_start = log_end;
+    }
+    if((int32_t)(log_first - log_end) > 0) {
+        __atomic_store_n(&log_first, log_end, __ATOMIC_RELAXED);
+        _persist_save();
+    }
+}
+#endif
+
+static void __call_console(uint32_t start, uint32_t end)
+{
+    if(start != end) {
+        if((start & LOG_BUF_MASK) > (end & LOG_BUF_MASK)) {
+            __console_print(start & LOG_BUF_MASK, __LOG_BUF_LEN);
+            __console_print(0, end & LOG_BUF_MASK);
+        } else {
+            __console_print(start, end);
+        }
+    }
+}
+
+/* Check a record against the level of its tag, or the console log level. The
+ * lines are stored for the most verbose sink, the console skips the ones above
+ * its own level. A continued record follows the fate of the line it continues.
+ */
+static inline bool __console_filtered(const struct log_record *rec)
+{
+    uint32_t level = _xlog.log_level.console_level;
+
+    if(!(rec->flags & LOG_REC_CONT)) {
+        if(rec->tag <= CONFIG_XLOG_TAG_MAX && tag_levels[rec->tag] != TAG_LEVEL_CONSOLE) {
+            level = tag_levels[rec->tag];
+        }
+        console_skip = (rec->level >= level);
+    }
+
+    return console_skip;
+}
+
+/* Print the records from start to end, each one is found from the header of
+ * the previous one.
+ */
+static void _call_console(uint32_t start, uint32_t end)
+{
+    struct log_record rec;
+    uint32_t text = 0, lost = 0;
+
+    while((end - start) >= sizeof(rec)) {
+        _log_read(start, &rec, sizeof(rec));
+        text = start + sizeof(rec);
+        /* a record overwritten while it is read ends the batch */
+        if(rec.len > LOG_TEXT_MAX || (end - text) < rec.len) {
+            break;
+        }
+        /* the partial line may have been ended by a marker line already */
+        if((rec.flags & LOG_REC_BREAK) && !console_new_line) {
+            __console_put("\n", 1);
+            console_new_line = true;
+        }
+        if(rec.lost) {
+            __console_lost(rec.lost);
+        }
+        if(!__console_filtered(&rec)) {
+            if(LOG_REC_PREFIXED(&rec)) {
+                __console_prefix(&rec);
+            }
+            __call_console(text, text + rec.len);
+            if(rec.len) {
+                console_new_line = LOG_ENDS_LINE(LOG_BUF(text + rec.len - 1));
+            }
+        }
+        start = text + rec.len;
+    }
+    /* the newest lines dropped and not reported by a record yet */
+    lost = _log_take_lost();
+    if(lost) {
+        __console_lost(lost);
+    }
+    __console_flush();
+}
+
+#ifdef CONFIG_XLOG_LOCKLESS
+/* Print everything committed so far. The console is released before the
+ * buffer is checked again, so a line committed while the console was held
+ * by someone else is printed by whoever acquires the console next.
+ */
+static void _flush_console(void)
+{
+    uint32_t _con_start = 0, _con_end = 0;
+
+    while(__acquire_console()) {
+        _con_start = log_start;
+        _con_end = __atomic_load_n(&log_end, __ATOMIC_ACQUIRE);
+        _call_console(_con_start, _con_end);
+        /* the printed range can be reused by producers only from now on */
+        __atomic_store_n(&log_start, _con_end, __ATOMIC_RELEASE);
+        __release_console();
+        if(__atomic_load_n(&log_end, __ATOMIC_ACQUIRE) == _con_end) {
+            break;
+        }
+    }
+}
+
+/* Wait until len more bytes fit into the log buffer. The waiting producer
+ * prints the log buffer itself when the console is free, otherwise it yields to
+ * the task holding the console, *waits times at most. It must not be kept from
+ * being preempted meanwhile.
+ * Returns false when there is still no room, the line is dropped then.
+ */
+static bool _log_wait_room(uint32_t len, uint32_t *waits)
+{
+    uint32_t start = 0;
+
+#ifdef CONFIG_XLOG_ASYNC
+    /* only a producer which may block prints the log buffer */
+    if(_xlog.async.policy != XLOG_ASYNC_BLOCK) {
+        *waits = 0;
+    }
+#endif
+    while((__atomic_load_n(&log_reserve, __ATOMIC_RELAXED) + len -
+           __atomic_load_n(&log_start, __ATOMIC_ACQUIRE)) > __LOG_BUF_LEN) {
+        if(!*waits) {
+            return false;
+        }
+        (*waits)--;
+        start = __atomic_load_n(&log_start, __ATOMIC_RELAXED);
+        _flush_console();
+        if(__atomic_load_n(&log_start, __ATOMIC_RELAXED) == start) {
+            __yield();
+        }
+    }
+
+    return true;
+}
+#else
+static bool _acquire_console(void)
+{
+    __unlock();
+    
+    return __acquire_console();
+}
+
+/* The range is taken with the log buffer locked, so a record still being
+ * written by another task is never seen half done. log_start is moved only
+ * once the range is printed, the producers do not overwrite it meanwhile.
+ */
+static void _print_and_release_console(void)
+{
+    uint32_t _con_start = 0, _con_end = 0, lost = 0;
+
+    __lock();
+    _con_start = log_start;
+    _con_end = log_end;
+    lost = log_lost_front;
+    log_lost_front = 0;
+    log_printing = true;
+    __unlock();
+    /* the oldest lines dropped were in front of what is left */
+    if(lost) {
+        __console_lost(lost);
+    }
+    _call_console(_con_start, _con_end);
+    __lock();
+    log_start = _con_end;
+    log_printing = false;
+    __unlock();
+    __release_console();
+}
+#endif
+
+#ifdef CONFIG_XLOG_ASYNC
+static inline uint32_t _log_pending(void)
+{
+#ifdef CONFIG_XLOG_LOCKLESS
+    return __atomic_load_n(&log_reserve, __ATOMIC_RELAXED) - __atomic_load_n(&log_start, __ATOMIC_RELAXED);
+#else
+    return log_end - log_start;
+#endif
+}
+
+static inline void _async_count(uint32_t *counter)
+{
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+#ifdef CONFIG_XLOG_LOCKLESS
+/* Apply the overflow policy before len bytes are reserved.
+ * Returns false when the new line has to be dropped.
+ */
+static bool _async_admit(uint32_t len)
+{
+    bool retval = true;
+
+    if((_log_pending() + len) > CONFIG_XLOG_ASYNC_WATERMARK) {
+        switch(_xlog.async.policy) {
+            case XLOG_ASYNC_DROP_OLDEST:
+                /* Failthrough - the console may be reading the oldest bytes in lockless mode */
+            case XLOG_ASYNC_DROP_NEWEST:
+                _async_count(&_xlog.async.stats.dropped_newest);
+                retval = false;
+                break;
+            default:
+                break;
+        }
+    }
+
+    return retval;
+}
+#else
+/* Apply the overflow policy once a line is stored from start on, as its length
+ * is only known after it has been formatted into the log buffer.
+ * Returns false when the new line has been dropped again.
+ */
+static bool _async_admit(const struct log_out_ring *ring)
+{
+    uint32_t start = ring->start;
+    struct log_record rec;
+    uint32_t lost = 0;
+    bool retval = true;
+
+    if(_log_pending() > CONFIG_XLOG_ASYNC_WATERMARK) {
+        switch(_xlog.async.policy) {
+            case XLOG_ASYNC_DROP_OLDEST:
+                /* drop the records in front of the new line until it fits below the watermark,
+                 * the ones the console is printing are left
+                 */
+                while(!log_printing && (int32_t)(start - log_start) > 0 &&
+                      (log_end - log_start) > CONFIG_XLOG_ASYNC_WATERMARK) {
+                    _log_drop_oldest();
+                    _async_count(&_xlog.async.stats.dropped_oldest);
+                }
+                break;
+            case XLOG_ASYNC_DROP_NEWEST:
+                _async_count(&_xlog.async.stats.dropped_newest);
+                /* the records of the line dropped in front already are accounted */
+                for(uint32_t off = ((int32_t)(log_start - start) > 0) ? log_start : start; off != log_end; off += sizeof(rec) + rec.len) {
+                    _log_read(off, &rec, sizeof(rec));
+                    _stats_dropped(rec.level, 1, rec.len);
+                    lost += 1 + rec.lost;
+                }
+                _log_lost(lost);
+                _log_rewind(ring);
+                retval = false;
+                break;
+            default:
+                break;
+        }
+    }
+
+    return retval;
+}
+#endif
+
+/* Returns true when the producer has to print the backlog itself, that is the
+ * backlog stays above the watermark and the policy is to block.
+ */
+static bool _async_block(void)
+{
+    bool retval = false;
+
+    if(_xlog.async.policy == XLOG_ASYNC_BLOCK && _log_pending() > CONFIG_XLOG_ASYNC_WATERMARK) {
+        _async_count(&_xlog.async.stats.blocked);
+        retval = true;
+    }
+
+    return retval;
+}
+#endif
+
+#if defined(CONFIG_XLOG_ASYNC) || defined(CONFIG_XLOG_PERSIST)
+/* Print everything logged so far, from the caller's context.
+ */
+static void _drain_console(void)
+{
+#ifdef CONFIG_XLOG_LOCKLESS
+    _flush_console();
+#else
+    __lock();
+    if(_acquire_console()) {
+        _print_and_release_console();
+    }
+#endif
+}
+#endif
+
+/* Check that the bytes from off on, just copied out of the log buffer, have not
+ * been overwritten meanwhile. The writers move log_first past them first, with a
+ * release fence between, so a copy which saw them overwritten sees log_first
+ * moved.
+ */
+static inline bool _log_intact(uint32_t off)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    return ((int32_t)(off - __atomic_load_n(&log_first, __ATOMIC_RELAXED)) >= 0);
+}
+
+static inline void __sink_write(struct log_sink *sink)
+{
+    if(sink->len) {
+        if(sink->ops.lz) {
+            xlog_lz_write(sink->ops.lz, sink->buf, sink->len, sink->ops.write);
+        } else {
+            sink->ops.write(sink->buf, sink->len);
+        }
+        sink->len = 0;
+    }
+}
+
+static inline void __sink_new_line(struct log_sink *sink)
+{
+    if(!sink->new_line) {
+        sink->buf[sink->len++] = '\n';
+        sink->new_line = true;
+    }
+}
+
+/* Find the record at the cursor of a reader, up to end. A reader which fell
+ * behind by more than the log buffer goes on from log_first, *lost then counts
+ * the records it missed as well as the lines dropped in front of the record.
+ * Returns false when there is no complete record left.
+ */
+static bool _reader_next(struct log_reader *reader, uint32_t end, struct log_record *rec, uint64_t *lost)
+{
+    uint32_t first = 0;
+    bool retval = false;
+
+    while((int32_t)(end - reader->off) >= (int32_t)sizeof(*rec)) {
+        first = __atomic_load_n(&log_first, __ATOMIC_ACQUIRE);
+        if((int32_t)(reader->off - first) < 0) {
+            reader->off = first;
+            reader->overrun = true;
+            continue;
+        }
+        _log_read(reader->off, rec, sizeof(*rec));
+        if(!_log_intact(reader->off)) {
+            continue;
+        }
+        if(rec->len <= LOG_TEXT_MAX && (int32_t)(end - reader->off - sizeof(*rec)) >= (int32_t)rec->len) {
+            *lost = rec->lost;
+            if(reader->read && reader->overrun && rec->seq > reader->seq) {
+                *lost += rec->seq - reader->seq;
+            }
+            reader->overrun = false;
+            retval = true;
+        }
+        break;
+    }
+
+    return retval;
+}
+
+/* Copy len chars of the text of the record at the cursor, from n on.
+ * Returns false when the record has been overwritten meanwhile, the next
+ * _reader_next() then goes on from log_first.
+ */
+static inline bool _reader_copy(const struct log_reader *reader, uint32_t n, char *dst, uint32_t len)
+{
+    _log_read(reader->off + sizeof(struct log_record) + n, dst, len);
+
+    return _log_intact(reader->off);
+}
+
+static inline void _reader_skip(struct log_reader *reader, const struct log_record *rec)
+{
+    reader->seq = rec->seq + 1;
+    reader->read = true;
+    reader->off += sizeof(*rec) + rec->len;
+}
+
+static inline uint32_t _lost_lines(uint64_t lost)
+{
+    return (lost > UINT32_MAX) ? UINT32_MAX : (uint32_t)lost;
+}
+
+/* Read the records from the cursor of a sink up to the end of the log buffer.
+ * Returns the number of lines rendered.
+ */
+static uint32_t _sink_read(struct log_sink *sink)
+{
+    struct log_record rec;
+    uint32_t end = _log_readable(), mark = 0, n = 0, chunk = 0, count = 0;
+    uint64_t lost = 0;
+    log_time_t ts = 0;
+    bool new_line = false, written = false;
+
+    while(_reader_next(&sink->reader, end, &rec, &lost)) {
+        if((sizeof(sink->buf) - sink->len) < SINK_RESERVE) {
+            __sink_write(sink);
+        }
+        mark = sink->len;
+        new_line = sink->new_line;
+        ts = sink->ts;
+        written = false;
+        if(rec.flags & LOG_REC_BREAK) {
+            __sink_new_line(sink);
+        }
+        if(lost) {
+            __sink_new_line(sink);
+            sink->len += _format_lost(&sink->buf[sink->len], _lost_lines(lost));
+        }
+        if(!(rec.flags & LOG_REC_CONT)) {
+            sink->skip = (rec.level >= sink->level);
+            count += sink->skip ? 0 : 1;
+        }
+        if(!sink->skip && LOG_REC_PREFIXED(&rec)) {
+            sink->len += _format_prefix(&sink->buf[sink->len], &rec, &sink->ts);
+        }
+        for(n = 0; !sink->skip && n < rec.len; n += chunk) {
+            if(sink->len == sizeof(sink->buf)) {
+                __sink_write(sink);
+                written = true;
+            }
+            chunk = rec.len - n;
+            if(chunk > (sizeof(sink->buf) - sink->len)) {
+                chunk = sizeof(sink->buf) - sink->len;
+            }
+            if(!_reader_copy(&sink->reader, n, &sink->buf[sink->len], chunk)) {
+                break;
+            }
+            sink->len += chunk;
+            sink->new_line = LOG_ENDS_LINE(sink->buf[sink->len - 1]);
+        }
+        if(!sink->skip && n < rec.len) {
+            /* overwritten while it was copied, the record is reported lost */
+            if(!written) {
+                sink->len = mark;
+                sink->new_line = new_line;
+            }
+            /* a frame cut short is dropped by the decoder */
+            sink->ts = ts;
+            count -= (rec.flags & LOG_REC_CONT) ? 0 : 1;
+            continue;
+        }
+        _reader_skip(&sink->reader, &rec);
+    }
+
+    return count;
+}
+
+/* Read the log buffer for a sink and write what it got, once there is a batch
+ * of it or when flush is true. Whoever holds busy owns the sink.
+ */
+static uint32_t _sink_process(struct log_sink *sink, bool flush)
+{
+    uint32_t count = 0;
+
+    if(!__atomic_exchange_n(&sink->busy, true, __ATOMIC_ACQUIRE)) {
+        if(__atomic_load_n(&sink->used, __ATOMIC_ACQUIRE)) {
+            count = _sink_read(sink);
+            if(flush || sink->len >= sink->ops.batch) {
+                __sink_write(sink);
+            }
+        }
+        __atomic_store_n(&sink->busy, false, __ATOMIC_RELEASE);
+    }
+
+    return count;
+}
+
+static void _sink_update_level(void)
+{
+    uint32_t level = 0;
+
+    for(uint32_t i = 0; i < CONFIG_XLOG_SINK_MAX; ++i) {
+        if(__atomic_load_n(&log_sinks[i].used, __ATOMIC_ACQUIRE) && log_sinks[i].level > level) {
+            level = log_sinks[i].level;
+        }
+    }
+    _xlog.log_level.sink_level = level;
+}
+
+/* Get the current time from the timestamp API function.
+ * Returns false when there is no timestamp API function.
+ */
+static inline bool _log_now(log_time_t *ts)
+{
+    bool retval = false;
+
+#ifdef CONFIG_XLOG_TIMESTAMP_MONOTONIC
+    if(_xlog.ops.get_timestamp_us) {
+        _xlog.ops.get_timestamp_us(ts);
+        retval = true;
+    }
+#else
+    if(_xlog.ops.get_timestamp) {
+        _xlog.ops.get_timestamp(ts);
+        retval = true;
+    }
+#endif
+
+    return retval;
+}
+
+/* Get the time of the rate limits and of the duplicate lines in microseconds, it
+ * only has to be monotonic over an interval, as the differences are taken modulo 2^32.
+ * Returns false when there is no timestamp API function.
+ */
+static inline bool _log_clock_us(uint32_t *now)
+{
+    uint64_t us = 0;
+    time_t utc = 0;
+    bool retval = true;
+
+    if(_xlog.ops.get_timestamp_us) {
+        _xlog.ops.get_timestamp_us(&us);
+    } else if(_xlog.ops.get_timestamp) {
+        _xlog.ops.get_timestamp(&utc);
+        us = (uint64_t)utc * 1000000UL;
+    } else {
+        retval = false;
+    }
+    *now = (uint32_t)us;
+
+    return retval;
+}
+
+static uint32_t _format_decimal(char *buf, uint32_t value, uint32_t width, char pad)
+{
+    char digits[10];
+    uint32_t n = 0, len = 0;
+
+    do {
+        digits[n++] = '0' + (value % 10);
+        value /= 10;
+    } while(value);
+    for(; width > n; --width) {
+        buf[len++] = pad;
+    }
+    while(n) {
+        buf[len++] = digits[--n];
+    }
+
+    return len;
+}
+
+#ifndef CONFIG_XLOG_BINARY
+#ifdef CONFIG_XLOG_TIMESTAMP_MONOTONIC
+/* Format a monotonic timestamp as "[sec.usec]".
+ */
+static uint32_t _format_time(char *buf, log_time_t ts)
+{
+    uint32_t len = 0;
+
+    buf[len++] = '[';
+    len += _format_decimal(&buf[len], (uint32_t)(ts / 1000000), 5, ' ');
+    buf[len++] = '.';
+    len += _format_decimal(&buf[len], (uint32_t)(ts % 1000000), 6, '0');
+    buf[len++] = ']';
+
+    return len;
+}
+#else
+/* Format a calendar timestamp as "[%Y-%m-%d %H:%M:%S]". The string only
+ * changes once a second, so the last one is cached. The cache is guarded by
+ * a sequence count: it is odd while the cache is updated, and a reader that
+ * sees it change retries with strftime().
+ */
+static uint32_t _format_time(char *buf, log_time_t ts)
+{
+    uint32_t seq = __atomic_load_n(&time_cache.seq, __ATOMIC_ACQUIRE);
+    uint32_t len = 0;
+    struct tm tm;
+
+    if(!(seq & 1) && time_cache.len && time_cache.utc == ts) {
+        len = time_cache.len;
+        memcpy(buf, time_cache.str, len);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&time_cache.seq, __ATOMIC_RELAXED) == seq) {
+            return len;
+        }
+    }
+    localtime_r(&ts, &tm);
+    len = strftime(buf, LOG_TIME_SIZE, "[%Y-%m-%d %H:%M:%S]", &tm);
+    /* refresh the cache, unless someone else is doing so */
+    if(!(seq & 1) && __atomic_compare_exchange_n(&time_cache.seq, &seq, seq + 1, false,
+                                                 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        memcpy(time_cache.str, buf, len);
+        time_cache.len = len;
+        time_cache.utc = ts;
+        __atomic_store_n(&time_cache.seq, seq + 2, __ATOMIC_RELEASE);
+    }
+
+    return len;
+}
+#endif
+#endif
+
+#ifdef CONFIG_XLOG_BINARY
+static inline uint32_t _put_varint(uint8_t *buf, uint64_t value)
+{
+    uint32_t len = 0;
+
+    for(; value >= 0x80; value >>= 7) {
+        buf[len++] = (uint8_t)(value | 0x80);
+    }
+    buf[len++] = (uint8_t)value;
+
+    return len;
+}
+
+static inline uint64_t _zigzag(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+/* Build the frame header of a record, see LOG_FRAME_SYNC. *last is the timestamp
+ * of the frame before on the same output, 0 at its start, NULL for a frame
+ * without timestamp.
+ */
+static uint32_t _format_prefix(char *buf, const struct log_record *rec, log_time_t *last)
+{
+    uint8_t head[1 + 10];
+    uint32_t len = 0, n = 1;
+
+    head[0] = rec->level | ((rec->flags & LOG_REC_FLAGS) << 2);
+    if((rec->flags & LOG_REC_TIME) && last) {
+        if(!*last || ((uint64_t)(rec->ts ^ *last) >> LOG_FRAME_TS_SHIFT)) {
+            head[0] |= LOG_FRAME_ABS;
+            n += _put_varint(&head[n], (uint64_t)rec->ts);
+        } else {
+            n += _put_varint(&head[n], _zigzag((int64_t)(rec->ts - *last)));
+        }
+        *last = rec->ts;
+    } else {
+        head[0] &= ~(LOG_REC_TIME << 2);
+    }
+    buf[len++] = (char)LOG_FRAME_SYNC;
+    len += _put_varint((uint8_t *)&buf[len], n + rec->len);
+    memcpy(&buf[len], head, n);
+
+    return len + n;
+}
+#else
+/* Build the line prefix of a record: color, timestamp and log type.
+ */
+static uint32_t __format_prefix(char *buf, const struct log_record *rec)
+{
+    uint32_t len = 0;
+
+    /* coloring */
+    strcpy(&buf[len], log_level_color[rec->level]);
+    len += strlen(log_level_color[rec->level]);
+    /* timestamp */
+    if(rec->flags & LOG_REC_TIME) {
+        len += _format_time(&buf[len], rec->ts);
+    }
+    if(!_xlog.hide_log_type) {
+        /* log type */
+        buf[len++] = '<';
+        buf[len++] = log_level_char[rec->level];
+        buf[len++] = '>';
+    }
+
+    return len;
+}
+#endif
+
+/* Parse the log level header of a formatted message.
+ * Returns the number of chars to skip, *level is updated when the header
+ * carries a level and *newline is set when the message must start a new line.
+ */
+static uint32_t _parse_log_level(const char *p, uint32_t *level, bool *newline)
+{
+    uint32_t skip = 0;
+    char c = 0;
+
+    *newline = false;
+    if(p[0] == '<') {
+        c = p[1];
+        if(c && p[2] == '>') {
+            switch(c) {
+                case '0'...'3':
+                    /* Get log level */
+                    *level = c - '0';
+                case 'd':
+                    /* Failthrough - make sure we're on a new line */
+                    *newline = true;
+                case 'c':
+                    /* Failthrough - skip the log level */
+                    skip = 3;
+                    break;
+            }
+        }
+    }
+
+    return skip;
+}
+
+/* Find the next conversion in a format string and describe the argument
+ * it consumes. "%%" is not a conversion, a conversion the C standard does not
+ * define is ARG_UNSUPPORTED and consumes no argument. Returns the char
+ * following the conversion, or NULL when there is no more conversion.
+ */
+static const char *_next_conv(const char *fmt, struct xlog_conv *conv)
+{
+    const char *p = NULL;
+
+    for(fmt = strchr(fmt, '%'); fmt && fmt[1] == '%'; fmt = strchr(fmt + 2, '%')) {
+    }
+    if(!fmt) {
+        return NULL;
+    }
+    conv->start = fmt;
+    conv->stars = 0;
+    conv->type = ARG_INT;
+    p = fmt + 1;
+    /* flags */
+    while(*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') {
+        ++p;
+    }
+    /* width and precision */
+    if(*p == '*') {
+        conv->stars++;
+        ++p;
+    }
+    while(*p >= '0' && *p <= '9') {
+        ++p;
+    }
+    if(*p == '.') {
+        ++p;
+        if(*p == '*') {
+            conv->stars++;
+            ++p;
+        }
+        while(*p >= '0' && *p <= '9') {
+            ++p;
+        }
+    }
+    /* length modifier */
+    switch(*p) {
+        case 'h':
+            p += (p[1] == 'h') ? 2 : 1;
+            break;
+        case 'l':
+            conv->type = (p[1] == 'l') ? ARG_LLONG : ARG_LONG;
+            p += (p[1] == 'l') ? 2 : 1;
+            break;
+        case 'j':
+            conv->type = ARG_LLONG;
+            ++p;
+            break;
+        case 'z':
+        case 't':
+            conv->type = ARG_SIZE;
+            ++p;
+            break;
+        case 'L':
+            conv->type = ARG_LDOUBLE;
+            ++p;
+            break;
+    }
+    /* conversion */
+    switch(*p) {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            conv->type = (conv->type == ARG_LDOUBLE) ? ARG_UNSUPPORTED : conv->type;
+            break;
+        case 'c':
+            conv->type = (conv->type == ARG_INT) ? ARG_INT : (conv->type == ARG_LONG) ? ARG_WINT : ARG_UNSUPPORTED;
+            break;
+        case 'p':
+            conv->type = ARG_PTR;
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            conv->type = (conv->type == ARG_LDOUBLE) ? ARG_LDOUBLE : ARG_DOUBLE;
+            break;
+        case 's':
+            conv->type = (conv->type == ARG_INT) ? ARG_STR : (conv->type == ARG_LONG) ? ARG_WSTR : ARG_UNSUPPORTED;
+            break;
+        case 'n':
+            conv->type = ARG_COUNT;
+            break;
+        default:
+            conv->type = ARG_UNSUPPORTED;
+            break;
+    }
+    if(*p) {
+        ++p;
+    }
+    conv->len = p - fmt;
+
+    return p;
+}
+
+/* Put literal text up to end, or up to the end of the string when end is NULL.
+ * There is no conversion in there, every '%' is the first of a "%%".
+ */
+static void _out_literal(struct log_out *out, const char *s, const char *end)
+{
+    const char *q = NULL;
+
+    if(!end) {
+        end = s + strlen(s);
+    }
+    while(s != end) {
+        q = memchr(s, '%', end - s);
+        if(q) {
+            out->put(out, s, q - s + 1);
+            s = q + 2;
+        } else {
+            out->put(out, s, end - s);
+            s = end;
+        }
+    }
+}
+
+static void _out_pad(struct log_out *out, char c, uint32_t n)
+{
+    static const char spaces[] = "                ";
+    static const char zeros[] = "0000000000000000";
+    const char *pad = (c == '0') ? zeros : spaces;
+
+    for(; n > sizeof(spaces) - 1; n -= sizeof(spaces) - 1) {
+        out->put(out, pad, sizeof(spaces) - 1);
+    }
+    out->put(out, pad, n);
+}
+
+/* Copy a conversion spec, with '*' replaced by the width and precision.
+ */
+static void _conv_spec(char *spec, uint32_t size, const struct xlog_conv *conv, const int *stars)
+{
+    uint32_t len = 0, n = 0;
+
+    for(uint32_t i = 0; i < conv->len; ++i) {
+        if(conv->start[i] == '*' && spec[len - 1] == '.' && stars[n] < 0) {
+            /* a negative precision is taken as if it were omitted */
+            len--;
+            n++;
+        } else if(conv->start[i] == '*') {
+            len += snprintf(&spec[len], size - len, "%d", stars[n++]);
+        } else {
+            spec[len++] = conv->start[i];
+        }
+    }
+    spec[len] = '\0';
+}
+
+/* Parse flags, width, precision and length modifier of a conversion.
+ */
+static void _parse_spec(struct log_spec *spec, const struct xlog_conv *conv, const int *stars)
+{
+    const char *p = conv->start + 1;
+    uint32_t n = 0;
+
+    spec->flags = 0;
+    spec->width = 0;
+    spec->prec = -1;
+    spec->size = 0;
+    for(; *p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0'; ++p) {
+        switch(*p) {
+            case '-':
+                spec->flags |= SPEC_LEFT;
+                break;
+            case '+':
+                spec->flags |= SPEC_PLUS;
+                break;
+            case ' ':
+                spec->flags |= SPEC_SPACE;
+                break;
+            case '#':
+                spec->flags |= SPEC_ALT;
+                break;
+            default:
+                spec->flags |= SPEC_ZERO;
+                break;
+        }
+    }
+    if(*p == '*') {
+        /* a negative width is a '-' flag */
+        if(stars[n] < 0) {
+            spec->flags |= SPEC_LEFT;
+            spec->width = -(uint32_t)stars[n];
+        } else {
+            spec->width = stars[n];
+        }
+        n++;
+        p++;
+    }
+    for(; *p >= '0' && *p <= '9'; ++p) {
+        spec->width = spec->width * 10 + (*p - '0');
+    }
+    if(*p == '.') {
+        p++;
+        spec->prec = 0;
+        if(*p == '*') {
+            /* a negative precision is taken as if it were omitted */
+            spec->prec = (stars[n] < 0) ? -1 : stars[n];
+            p++;
+        }
+        for(; *p >= '0' && *p <= '9'; ++p) {
+            spec->prec = spec->prec * 10 + (*p - '0');
+        }
+    }
+    if(*p == 'h') {
+        spec->size = (p[1] == 'h') ? sizeof(char) : sizeof(short);
+    }
+    spec->conv = conv->start[conv->len - 1];
+}
+
+/* Put an integer conversion, the digits are generated backwards into a buffer
+ * big enough for 64 bits in octal, padding is put from constant strings so that
+ * any width costs no stack.
+ */
+static void _out_integer(struct log_out *out, const struct log_spec *spec, unsigned long long v, bool neg)
+{
+    static const char digits_dec[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    static const char digits_hex[] = "0123456789abcdef0123456789ABCDEF";
+    char buf[24], prefix[2];
+    char *p = &buf[sizeof(buf)];
+    const char *hex = NULL;
+    uint32_t prefix_len = 0, len = 0, zeros = 0, pad = 0, v32 = 0;
+
+    switch(spec->conv) {
+        case 'x':
+        case 'X':
+            hex = (spec->conv == 'x') ? digits_hex : &digits_hex[16];
+            for(; v > UINT32_MAX; v >>= 4) {
+                *--p = hex[v & 0xf];
+            }
+            for(v32 = v; v32; v32 >>= 4) {
+                *--p = hex[v32 & 0xf];
+            }
+            if((spec->flags & SPEC_ALT) && v) {
+                prefix[prefix_len++] = '0';
+                prefix[prefix_len++] = spec->conv;
+            }
+            break;
+        case 'o':
+            for(; v; v >>= 3) {
+                *--p = '0' + (v & 0x7);
+            }
+            break;
+        default:
+            /* 64 bits division is a library call on 32 bits targets */
+            for(; v > UINT32_MAX; v /= 100) {
+                p -= 2;
+                memcpy(p, &digits_dec[(v % 100) * 2], 2);
+            }
+            for(v32 = v; v32 >= 100; v32 /= 100) {
+                p -= 2;
+                memcpy(p, &digits_dec[(v32 % 100) * 2], 2);
+            }
+            if(v32 >= 10) {
+                p -= 2;
+                memcpy(p, &digits_dec[v32 * 2], 2);
+            } else if(v32) {
+                *--p = '0' + v32;
+            }
+            if(spec->conv == 'u') {
+                break;
+            }
+            if(neg) {
+                prefix[prefix_len++] = '-';
+            } else if(spec->flags & SPEC_PLUS) {
+                prefix[prefix_len++] = '+';
+            } else if(spec->flags & SPEC_SPACE) {
+                prefix[prefix_len++] = ' ';
+            }
+            break;
+    }
+    len = &buf[sizeof(buf)] - p;
+    /* precision 0 prints no digit for a zero */
+    if(!len && spec->prec != 0) {
+        *--p = '0';
+        len = 1;
+    }
+    if(spec->prec >= 0 && (uint32_t)spec->prec > len) {
+        zeros = spec->prec - len;
+    }
+    if(spec->conv == 'o' && (spec->flags & SPEC_ALT) && !zeros && (!len || *p != '0')) {
+        zeros = 1;
+    }
+    if((spec->flags & (SPEC_ZERO | SPEC_LEFT)) == SPEC_ZERO && spec->prec < 0 &&
+       spec->width > (prefix_len + zeros + len)) {
+        zeros = spec->width - prefix_len - len;
+    }
+    if(spec->width > (prefix_len + zeros + len)) {
+        pad = spec->width - prefix_len - zeros - len;
+    }
+    if(pad && !(spec->flags & SPEC_LEFT)) {
+        _out_pad(out, ' ', pad);
+    }
+    if(prefix_len) {
+        out->put(out, prefix, prefix_len);
+    }
+    if(zeros) {
+        _out_pad(out, '0', zeros);
+    }
+    out->put(out, p, len);
+    if(pad && (spec->flags & SPEC_LEFT)) {
+        _out_pad(out, ' ', pad);
+    }
+}
+
+/* Put a string with the width and precision of its spec, the string is put
+ * as it is, so that it can be of any length.
+ */
+static void _out_string(struct log_out *out, const struct log_spec *spec, const char *str, uint32_t len)
+{
+    uint32_t pad = (spec->width > len) ? (spec->width - len) : 0;
+
+    if(pad && !(spec->flags & SPEC_LEFT)) {
+        _out_pad(out, ' ', pad);
+    }
+    out->put(out, str, len);
+    if(pad && (spec->flags & SPEC_LEFT)) {
+        _out_pad(out, ' ', pad);
+    }
+}
+
+static void __attribute__((format(printf, 2, 0))) _out_vprintf(struct log_out *out, const char *spec, va_list args)
+{
+    char buf[LOG_CONV_SIZE];
+    int r = 0;
+
+    r = vsnprintf(buf, sizeof(buf), spec, args);
+    if(r > 0) {
+        out->put(out, buf, ((uint32_t)r >= sizeof(buf)) ? (sizeof(buf) - 1) : (uint32_t)r);
+    }
+}
+
+static void __attribute__((format(printf, 2, 3))) _out_printf(struct log_out *out, const char *spec, ...)
+{
+    va_list args;
+
+    va_start(args, spec);
+    _out_vprintf(out, spec, args);
+    va_end(args);
+}
+
+/* Put a conversion through snprintf(), the argument was read as its type.
+ */
+static void _out_fallback(struct log_out *out, const struct xlog_conv *conv, const int *stars, const union log_arg *arg)
+{
+    char fmt[LOG_CONV_MAX + 24];
+
+    if(conv->len > LOG_CONV_MAX) {
+        out->put(out, conv->start, conv->len);
+        return;
+    }
+    _conv_spec(fmt, sizeof(fmt), conv, stars);
+    switch(conv->type) {
+        case ARG_PTR:
+            _out_printf(out, fmt, arg->p);
+            break;
+        case ARG_LDOUBLE:
+            _out_printf(out, fmt, arg->ld);
+            break;
+        case ARG_WINT:
+            _out_printf(out, fmt, (wint_t)arg->i);
+            break;
+        case ARG_WSTR:
+            _out_printf(out, fmt, (const wchar_t *)arg->p);
+            break;
+        default:
+            _out_printf(out, fmt, arg->d);
+            break;
+    }
+}
+
+/* Put one conversion. Integers, chars and strings are converted here, the
+ * others are handed to snprintf() one by one. "%n" stores nothing.
+ */
+static void _out_conv(struct log_out *out, const struct xlog_conv *conv, const int *stars, const union log_arg *arg)
+{
+    struct log_spec spec;
+    unsigned long long u = 0;
+    long long i = arg->i;
+    const char *q = NULL;
+    char c = 0;
+
+    _parse_spec(&spec, conv, stars);
+    switch(spec.conv) {
+        case 'd':
+        case 'i':
+            if(conv->type == ARG_SIZE) {
+                i = (ptrdiff_t)i;
+            } else if(spec.size == sizeof(char)) {
+                i = (signed char)i;
+            } else if(spec.size == sizeof(short)) {
+                i = (short)i;
+            }
+            u = (i < 0) ? -(unsigned long long)i : (unsigned long long)i;
+            _out_integer(out, &spec, u, i < 0);
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            switch(conv->type) {
+                case ARG_LONG:
+                    u = (unsigned long)i;
+                    break;
+                case ARG_LLONG:
+                    u = (unsigned long long)i;
+                    break;
+                case ARG_SIZE:
+                    u = (size_t)i;
+                    break;
+                default:
+                    u = (unsigned int)i;
+                    break;
+            }
+            if(spec.size == sizeof(char)) {
+                u = (unsigned char)u;
+            } else if(spec.size == sizeof(short)) {
+                u = (unsigned short)u;
+            }
+            _out_integer(out, &spec, u, false);
+            break;
+        case 'n':
+            break;
+        case 'c':
+            if(conv->type == ARG_INT) {
+                c = (char)i;
+                _out_string(out, &spec, &c, 1);
+                break;
+            }
+            /* fall through */
+        case 's':
+            if(conv->type == ARG_STR) {
+                q = arg->s ? arg->s : "(null)";
+                if(spec.prec < 0) {
+                    _out_string(out, &spec, q, strlen(q));
+                } else {
+                    const char *z = memchr(q, '\0', spec.prec);
+                    _out_string(out, &spec, q, z ? (uint32_t)(z - q) : (uint32_t)spec.prec);
+                }
+                break;
+            }
+            /* fall through */
+        default:
+            _out_fallback(out, conv, stars, arg);
+            break;
+    }
+}
+
+/* Format a message into out. Literal text and strings are put as they are,
+ * the other conversions are generated on a small buffer on the stack, one at
+ * a time.
+ */
+static void __attribute__((format(printf, 2, 0))) _vformat(struct log_out *out, const char *fmt, va_list args)
+{
+    struct xlog_conv conv = {0};
+    union log_arg arg = {0};
+    const char *p = NULL;
+    int stars[2] = {0};
+
+    while(*fmt) {
+        p = _next_conv(fmt, &conv);
+        _out_literal(out, fmt, p ? conv.start : NULL);
+        if(!p) {
+            break;
+        }
+        if(conv.type == ARG_UNSUPPORTED) {
+            /* the argument it would take is unknown, it is put as it is */
+            out->put(out, conv.start, conv.len);
+            fmt = p;
+            continue;
+        }
+        for(uint32_t i = 0; i < conv.stars; ++i) {
+            stars[i] = va_arg(args, int);
+        }
+        switch(conv.type) {
+            case ARG_INT:
+                arg.i = va_arg(args, int);
+                break;
+            case ARG_LONG:
+                arg.i = va_arg(args, long);
+                break;
+            case ARG_LLONG:
+                arg.i = va_arg(args, long long);
+                break;
+            case ARG_SIZE:
+                arg.i = va_arg(args, size_t);
+                break;
+            case ARG_PTR:
+                arg.p = va_arg(args, void *);
+                break;
+            case ARG_DOUBLE:
+                arg.d = va_arg(args, double);
+                break;
+            case ARG_STR:
+                arg.s = va_arg(args, const char *);
+                break;
+            case ARG_LDOUBLE:
+                arg.ld = va_arg(args, long double);
+                break;
+            case ARG_WINT:
+                arg.i = va_arg(args, wint_t);
+                break;
+            case ARG_WSTR:
+            case ARG_COUNT:
+                arg.p = va_arg(args, void *);
+                break;
+            default:
+                break;
+        }
+        _out_conv(out, &conv, stars, &arg);
+        fmt = p;
+    }
+}
+
+#ifdef CONFIG_XLOG_LOCKLESS
+static void _out_buf_put(struct log_out *out, const char *s, uint32_t len)
+{
+    struct log_out_buf *b = (struct log_out_buf *)out;
+
+    if(len > (b->size - 1 - out->len)) {
+        len = b->size - 1 - out->len;
+    }
+    if(len <= LOG_COPY_INLINE) {
+        for(uint32_t i = 0; i < len; ++i) {
+            b->buf[out->len + i] = s[i];
+        }
+    } else {
+        memcpy(&b->buf[out->len], s, len);
+    }
+    out->len += len;
+    b->buf[out->len] = '\0';
+}
+
+static inline void _out_buf_init(struct log_out_buf *b, char *buf, uint32_t size)
+{
+    b->out.put = _out_buf_put;
+    b->out.len = 0;
+    b->buf = buf;
+    b->size = size;
+    buf[0] = '\0';
+}
+#endif
+
+/* Length of the text of the record starting at s: up to and including the
+ * next '\n', at most LOG_TEXT_MAX.
+ */
+static inline uint32_t _record_len(const char *s, uint32_t len)
+{
+    const char *q = NULL;
+
+    if(len > LOG_TEXT_MAX) {
+        len = LOG_TEXT_MAX;
+    }
+    q = memchr(s, '\n', len);
+
+    return q ? (uint32_t)(q - s + 1) : len;
+}
+
+#ifdef CONFIG_XLOG_LOCKLESS
+/* Reserve total bytes of the log buffer for count records of a message of size
+ * chars logged at level, waiting for the room waits times at most, see
+ * _log_wait_room(). The task is kept from being preempted from then on, it
+ * calls __resume() once it has published the records.
+ * Returns false when the message is dropped, the task is not kept then.
+ */
+static bool _log_claim(uint32_t total, uint32_t count, uint32_t level, uint32_t size, uint32_t waits, uint32_t *off)
+{
+    bool reserved = false;
+
+    _stats_add(&log_stats.written[level], count);
+#ifdef CONFIG_XLOG_ASYNC
+    if(!_async_admit(total)) {
+        _stats_dropped(level, count, size);
+        _log_lost(count);
+        return false;
+    }
+#endif
+    __suspend();
+    while(!(reserved = _log_reserve(total, off)) && waits) {
+        __resume();
+        if(!_log_wait_room(total, &waits)) {
+            __suspend();
+            break;
+        }
+        __suspend();
+    }
+    if(!reserved) {
+        _stats_dropped(level, count, size);
+        _log_lost(count);
+        __resume();
+    } else {
+        _log_first_advance(*off + total);
+        _stats_watermark(*off + total - __atomic_load_n(&log_start, __ATOMIC_RELAXED));
+    }
+
+    return reserved;
+}
+
+/* Commit the record at off, its header and the rec->len chars of text, which
+ * _log_publish() publishes once the records reserved before it are committed.
+ */
+static void _log_commit(uint32_t off, const struct log_record *rec, const char *text)
+{
+    _log_copy(off + sizeof(*rec), text, rec->len);
+    /* the sequence number and the checksum are put by _log_publish() */
+    _log_copy(off, (const char *)rec, sizeof(*rec));
+    __atomic_store_n(&LOG_MARK(off), true, __ATOMIC_RELEASE);
+}
+
+/* Store a formatted message of size chars into the log buffer, one record per
+ * line, and print it to the console. A binary message(bin is LOG_REC_BIN, with
+ * LOG_REC_EOL when it ends its line) goes into one record as it is. ts is the
+ * time the message was logged, NULL means now. A caller kept from being preempted
+ * passes waits 0, the message is dropped at once when it does not fit, otherwise
+ * the room is waited for, see _log_wait_room(). Nothing is printed, the return
+ * value tells whether _log_output() should be called.
+ */
+static bool __log_store(const char *text, uint32_t size, uint8_t bin, const log_time_t *ts, uint16_t tag,
+                        uint32_t waits, uint32_t *printed_len)
+{
+    struct log_record rec;
+    uint32_t total = 0, count = 0, off = 0, len = 0;
+    uint32_t level = _xlog.log_level.default_level;
+    bool new_line = next_text_line, newline = false, line_break = false;
+    const char *p = NULL;
+
+    memset(&rec, 0, sizeof(rec));
+    p = text + _parse_log_level(text, &level, &newline);
+    rec.level = level;
+    rec.tag = tag;
+    if(ts) {
+        rec.ts = *ts;
+        rec.flags = LOG_REC_TIME;
+    } else if(_log_now(&rec.ts)) {
+        rec.flags = LOG_REC_TIME;
+    }
+    line_break = (newline && !new_line);
+    /* measure the records, so that they can be reserved in one go */
+    size -= (uint32_t)(p - text);
+    for(uint32_t n = 0; n < size; n += len, count++) {
+        len = bin ? size : _record_len(&p[n], size - n);
+        total += sizeof(rec) + len;
+    }
+    if(!count && line_break) {
+        total += sizeof(rec);
+        count++;
+    }
+    if(!count) {
+        return false;
+    }
+    if(!_log_claim(total, count, level, size, waits, &off)) {
+        return false;
+    }
+    rec.lost = _log_take_lost();
+    for(uint32_t n = 0; count--; n += len) {
+        len = (n < size) ? (bin ? size : _record_len(&p[n], size - n)) : 0;
+        rec.len = len;
+        rec.flags &= LOG_REC_TIME;
+        rec.flags |= bin;
+        rec.flags |= (new_line || line_break) ? 0 : LOG_REC_CONT;
+        rec.flags |= line_break ? LOG_REC_BREAK : 0;
+        /* an empty record only ends the previous line */
+        rec.flags |= len ? 0 : LOG_REC_CONT;
+        _log_commit(off, &rec, &p[n]);
+        off += sizeof(rec) + len;
+        new_line = bin ? !!(bin & LOG_REC_EOL) : ((len && p[n + len - 1] == '\n') || (line_break && !len));
+        line_break = false;
+        rec.lost = 0;
+    }
+    _log_publish();
+    /* a continued line is not SMP-safe, see LOG_CONT */
+    next_text_line = new_line;
+    *printed_len = size;
+    __resume();
+
+    return true;
+}
+
+/* Print the lines stored to the console, in asynchronous mode only the
+ * task draining them is woken up if the backlog allows it.
+ */
+static void _log_output(void)
+{
+#ifdef CONFIG_XLOG_ASYNC
+    if(!_async_block()) {
+        __notify();
+        return;
+    }
+#endif
+    _flush_console();
+}
+
+/* Store a formatted message into the log buffer and print it to the console,
+ * see __log_store().
+ */
+static uint32_t _log_store(const char *text, uint32_t size, uint8_t bin, const log_time_t *ts, uint16_t tag)
+{
+    uint32_t printed_len = 0;
+
+    if(__log_store(text, size, bin, ts, tag, CONFIG_XLOG_RESERVE_WAITS, &printed_len)) {
+        _log_output();
+    }
+
+    return printed_len;
+}
+
+static uint32_t __attribute__((format(printf, 2, 0))) _vprint(uint16_t tag, const char *fmt, va_list args)
+{
+    char text[CONFIG_XLOG_LINE_SIZE];
+    struct log_out_buf b;
+
+    _out_buf_init(&b, text, sizeof(text));
+    _vformat(&b.out, fmt, args);
+
+    return _log_store(text, strlen(text), 0, NULL, tag);
+}
+#else
+/* Finish the open record, its header is written once its length is known.
+ */
+static void _record_close(struct log_out_ring *ring)
+{
+    if(!ring->full) {
+        _record_put(ring->rec_off, &ring->rec);
+    }
+    ring->open = false;
+}
+
+/* Open a record at the end of the log buffer, only room for its header is
+ * taken until the record is closed.
+ */
+static void _record_open(struct log_out_ring *ring)
+{
+    _log_room(ring, sizeof(ring->rec));
+    ring->rec_off = log_end;
+    log_end += sizeof(ring->rec);
+    ring->rec.seq = log_seq++;
+    ring->rec.len = 0;
+    ring->rec.lost = _log_take_lost();
+    ring->count++;
+    ring->lost += ring->rec.lost;
+    ring->rec.flags &= LOG_REC_TIME;
+    ring->rec.flags |= next_text_line ? 0 : LOG_REC_CONT;
+    if(ring->line_break) {
+        ring->rec.flags |= LOG_REC_BREAK;
+        ring->line_break = false;
+    }
+    ring->open = true;
+    _stats_add(&log_stats.written[ring->rec.level], 1);
+}
+
+static void _out_ring_put(struct log_out *out, const char *s, uint32_t len)
+{
+    struct log_out_ring *ring = (struct log_out_ring *)out;
+    uint32_t n = 0;
+
+    for(; len; s += n, len -= n) {
+        if(!ring->open) {
+            _record_open(ring);
+        }
+        n = _record_len(s, (len < (LOG_TEXT_MAX - ring->rec.len)) ? len : (LOG_TEXT_MAX - ring->rec.len));
+        emit_log_bytes(ring, s, n);
+        ring->rec.len += n;
+        out->len += n;
+        next_text_line = (s[n - 1] == '\n');
+        /* one record per line */
+        if(next_text_line || ring->rec.len == LOG_TEXT_MAX) {
+            _record_close(ring);
+        }
+    }
+}
+
+/* Start a message in the log buffer, must be called with the log buffer locked.
+ * ts is the time the message was logged, NULL means now.
+ * Returns the number of chars of the log level header of fmt.
+ */
+static uint32_t _log_begin(struct log_out_ring *ring, const char *fmt, const log_time_t *ts, uint16_t tag)
+{
+    uint32_t skip = 0, level = _xlog.log_level.default_level;
+    bool newline = false;
+
+    ring->out.put = _out_ring_put;
+    ring->out.len = 0;
+    ring->open = false;
+    ring->start = log_end;
+    ring->text_line = next_text_line;
+    ring->full = false;
+    ring->count = 0;
+    ring->lost = 0;
+    memset(&ring->rec, 0, sizeof(ring->rec));
+    ring->rec.tag = tag;
+    if(ts) {
+        ring->rec.ts = *ts;
+        ring->rec.flags = LOG_REC_TIME;
+    } else if(_log_now(&ring->rec.ts)) {
+        ring->rec.flags = LOG_REC_TIME;
+    }
+    /* Do we have a log level in the string? */
+    skip = _parse_log_level(fmt, &level, &newline);
+    ring->rec.level = level;
+    ring->line_break = (newline && !next_text_line);
+    if(ring->line_break) {
+        next_text_line = true;
+    }
+
+    return skip;
+}
+
+#ifdef CONFIG_XLOG_DEDUP
+/* Only a message which is a whole line of one record is collapsed.
+ */
+static inline bool _dedup_line(const struct log_out_ring *ring)
+{
+    return ring->rec.len && ring->rec_off == ring->start && next_text_line &&
+           !(ring->rec.flags & (LOG_REC_CONT | LOG_REC_BREAK)) &&
+           log_end == (ring->rec_off + sizeof(ring->rec) + ring->rec.len);
+}
+
+/* Compare len bytes of the log buffer at a with those at b, a span at a time
+ * neither wraps around in.
+ */
+static bool _log_equal(uint32_t a, uint32_t b, uint32_t len)
+{
+    uint32_t n = 0;
+    bool retval = true;
+
+    for(; retval && len; a += n, b += n, len -= n) {
+        n = __LOG_BUF_LEN - (((a & LOG_BUF_MASK) > (b & LOG_BUF_MASK)) ? (a & LOG_BUF_MASK) : (b & LOG_BUF_MASK));
+        n = (n < len) ? n : len;
+        retval = !memcmp(&LOG_BUF(a), &LOG_BUF(b), n);
+    }
+
+    return retval;
+}
+
+/* Move len bytes of the log buffer at src up to dst, a span at a time neither
+ * wraps around in, from the end as the two overlap.
+ */
+static void _log_move_up(uint32_t dst, uint32_t src, uint32_t len)
+{
+    uint32_t n = 0;
+
+    for(; len; len -= n) {
+        n = ((dst + len - 1) & LOG_BUF_MASK) < ((src + len - 1) & LOG_BUF_MASK) ?
+            ((dst + len - 1) & LOG_BUF_MASK) : ((src + len - 1) & LOG_BUF_MASK);
+        n = (n < len) ? (n + 1) : len;
+        memmove(&LOG_BUF(dst + len - n), &LOG_BUF(src + len - n), n);
+    }
+}
+
+/* Compare the record of the last message with the one ring has just closed.
+ */
+static bool _dedup_same(const struct log_out_ring *ring)
+{
+    struct log_record rec;
+    bool retval = false;
+
+    _log_read(log_last, &rec, sizeof(rec));
+    if(rec.len == ring->rec.len && rec.level == ring->rec.level && rec.tag == ring->rec.tag &&
+       !((rec.flags ^ ring->rec.flags) & LOG_REC_BIN)) {
+        retval = _log_equal(log_last + sizeof(rec), ring->rec_off + sizeof(rec), rec.len);
+    }
+
+    return retval;
+}
+
+/* Put the line reporting the duplicates in front of the message from ring->start
+ * on. The line takes the sequence number of the message, whose records move on.
+ * Returns false when there is no room for the line, the duplicates are then
+ * still to be reported.
+ */
+static bool _dedup_report(struct log_out_ring *ring)
+{
+    struct log_record rec, first;
+    char text[LOG_REPEAT_SIZE];
+    uint32_t len = 0, total = 0, off = 0;
+
+    memcpy(text, LOG_REPEAT_TEXT, sizeof(LOG_REPEAT_TEXT) - 1);
+    len = sizeof(LOG_REPEAT_TEXT) - 1;
+    len += _format_decimal(&text[len], log_repeats, 0, ' ');
+    memcpy(&text[len], LOG_REPEAT_TIMES, sizeof(LOG_REPEAT_TIMES) - 1);
+    len += sizeof(LOG_REPEAT_TIMES) - 1;
+    total = sizeof(rec) + len;
+    /* a message too long to be moved safely goes without the report */
+    if((log_end - ring->start) > (__LOG_BUF_LEN / 2) || !_log_room(ring, total)) {
+        return false;
+    }
+    _log_move_up(ring->start + total, ring->start, log_end - ring->start);
+    memset(&rec, 0, sizeof(rec));
+    rec.seq = log_seq;
+    if(log_end != ring->start) {
+        _log_read(ring->start + total, &first, sizeof(first));
+        rec.seq = first.seq;
+        rec.ts = first.ts;
+        rec.flags = first.flags & LOG_REC_TIME;
+        rec.lost = first.lost;
+        first.lost = 0;
+        _record_put(ring->start + total, &first);
+    }
+    for(off = ring->start + total; off != (log_end + total); off += sizeof(first) + first.len) {
+        _log_read(off, &first, sizeof(first));
+        first.seq++;
+        _record_put(off, &first);
+    }
+    rec.len = len;
+    rec.level = log_repeat_level;
+    rec.tag = log_repeat_tag;
+    _log_copy(ring->start + sizeof(rec), text, len);
+    _record_put(ring->start, &rec);
+    log_end += total;
+    log_seq++;
+    ring->rec_off += total;
+    log_repeats = 0;
+    _stats_add(&log_stats.written[rec.level], 1);
+
+    return true;
+}
+
+/* The duplicates not reported yet were first collapsed CONFIG_XLOG_DEDUP_FLUSH_MS
+ * ago or more, a clock is needed to tell.
+ */
+static inline bool _dedup_expired(void)
+{
+    uint32_t now = 0;
+
+    return _log_clock_us(&now) && (now - log_repeat_stamp) >= (CONFIG_XLOG_DEDUP_FLUSH_MS * 1000UL);
+}
+
+/* Collapse a message duplicating the last one, the duplicates are reported by
+ * a line in front of the next message which differs, or which comes once they
+ * have expired.
+ * Returns true when the message has been taken back.
+ */
+static bool _log_dedup(struct log_out_ring *ring)
+{
+    bool line = _dedup_line(ring), retval = false;
+
+    if(line && log_last_line && (int32_t)(log_last - log_first) >= 0 &&
+       (int32_t)(ring->start - log_last) > 0 && _dedup_same(ring) &&
+       !(log_repeats && _dedup_expired())) {
+        log_end = ring->start;
+        log_seq--;
+        _log_lost(ring->rec.lost);
+        if(!log_repeats++) {
+            _log_clock_us(&log_repeat_stamp);
+        }
+        retval = true;
+    } else if(!log_repeats || _dedup_report(ring)) {
+        log_last = ring->rec_off;
+        log_last_line = line;
+        log_repeat_level = ring->rec.level;
+        log_repeat_tag = ring->rec.tag;
+    } else {
+        /* the report goes in front of a later message, nothing is collapsed
+         * into this one until then
+         */
+        log_last = ring->rec_off;
+        log_last_line = false;
+    }
+
+    return retval;
+}
+#endif
+
+/* Finish a message formatted into the log buffer and print it to the console,
+ * the lock is released on return.
+ */
+static uint32_t _log_end(struct log_out_ring *ring)
+{
+    uint32_t printed_len = ring->out.len;
+
+    if(ring->open) {
+        _record_close(ring);
+    } else if(ring->line_break) {
+        /* an empty message still ends the previous line */
+        _record_open(ring);
+        ring->rec.flags |= LOG_REC_CONT;
+        _record_close(ring);
+    }
+    if(ring->full) {
+        /* the console is printing what the message would overwrite */
+        _stats_dropped(ring->rec.level, ring->count, ring->out.len);
+        _log_lost(ring->count + ring->lost);
+        _log_rewind(ring);
+        __unlock();
+        return 0;
+    }
+#ifdef CONFIG_XLOG_DEDUP
+    if(_log_dedup(ring)) {
+        __unlock();
+        return printed_len;
+    }
+#endif
+    _stats_watermark(log_end - log_start);
+#ifdef CONFIG_XLOG_ASYNC
+    if(!_async_admit(ring)) {
+        __unlock();
+        return 0;
+    }
+#endif
+    /* the sinks see the line once it has been admitted */
+    __atomic_store_n(&log_commit, log_end, __ATOMIC_RELEASE);
+    _persist_save();
+#ifdef CONFIG_XLOG_ASYNC
+    if(!_async_block()) {
+        __unlock();
+        __notify();
+        return printed_len;
+    }
+#endif
+    if(_acquire_console()) {
+        _print_and_release_console();
+    }
+
+    return printed_len;
+}
+
+#ifdef CONFIG_XLOG_DEDUP
+/* Report the duplicates once they have expired, when the line repeated is the
+ * last one logged for a while, or for good. The next duplicate is stored again.
+ */
+static void _dedup_flush(void)
+{
+    struct log_out_ring ring;
+
+    if(__atomic_load_n(&log_repeats, __ATOMIC_RELAXED)) {
+        __lock();
+        if(log_repeats && _dedup_expired()) {
+            _log_begin(&ring, "", NULL, log_repeat_tag);
+            ring.rec_off = log_end;
+            _dedup_report(&ring);
+            _log_end(&ring);
+        } else {
+            __unlock();
+        }
+    }
+}
+#endif
+
+static uint32_t __attribute__((format(printf, 2, 0))) _vprint(uint16_t tag, const char *fmt, va_list args)
+{
+    struct log_out_ring ring;
+    uint32_t skip = 0;
+
+    __lock();
+    skip = _log_begin(&ring, fmt, NULL, tag);
+    _vformat(&ring.out, fmt + skip, args);
+
+    return _log_end(&ring);
+}
+
+#ifdef CONFIG_XLOG_BINARY
+/* Store a binary message into one record, see _log_store().
+ */
+static uint32_t _log_bin(const char *level, const uint8_t *data, uint32_t size, uint8_t bin, uint16_t tag)
+{
+    struct log_out_ring ring;
+
+    __lock();
+    _log_begin(&ring, level, NULL, tag);
+    _record_open(&ring);
+    emit_log_bytes(&ring, (const char *)data, size);
+    ring.rec.len = size;
+    ring.rec.flags |= bin;
+    ring.out.len = size;
+    next_text_line = !!(bin & LOG_REC_EOL);
+
+    return _log_end(&ring);
+}
+#endif
+#endif
+
+#if defined(CONFIG_XLOG_DEFERRED) || defined(CONFIG_XLOG_ISR)
+static inline bool _deferred_put(struct xlog_deferred *d, uint32_t *n, const void *arg, uint32_t size)
+{
+    uint32_t words = (size + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    if((*n + words) > CONFIG_XLOG_DEFERRED_ARGS) {
+        return false;
+    }
+    memcpy(&d->args[*n], arg, size);
+    *n += words;
+
+    return true;
+}
+
+static inline void _deferred_get(const struct xlog_deferred *d, uint32_t *n, void *arg, uint32_t size)
+{
+    memcpy(arg, &d->args[*n], size);
+    *n += (size + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+}
+
+/* Copy the raw argument words of a line into a deferred record.
+ * Returns false when the line can not be deferred.
+ */
+static bool _deferred_capture(struct xlog_deferred *d, const char *fmt, va_list args)
+{
+    struct xlog_conv conv = {0};
+    const char *p = fmt;
+    uint32_t n = 0;
+    bool retval = true;
+
+    d->fmt = fmt;
+    d->ts = 0;
+    while(retval && (p = _next_conv(p, &conv)) != NULL) {
+        for(uint32_t i = 0; retval && i < conv.stars; ++i) {
+            int v = va_arg(args, int);
+            retval = _deferred_put(d, &n, &v, sizeof(v));
+        }
+        if(!retval) {
+            break;
+        }
+        switch(conv.type) {
+            case ARG_INT: {
+                int v = va_arg(args, int);
+                retval = _deferred_put(d, &n, &v, sizeof(v));
+                break;
+            }
+            case ARG_LONG: {
+                long v = va_arg(args, long);
+                retval = _deferred_put(d, &n, &v, sizeof(v));
+                break;
+            }
+            case ARG_LLONG: {
+                long long v = va_arg(args, long long);
+                retval = _deferred_put(d, &n, &v, sizeof(v));
+                break;
+            }
+            case ARG_SIZE: {
+                size_t v = va_arg(args, size_t);
+                retval = _deferred_put(d, &n, &v, sizeof(v));
+                break;
+            }
+            case ARG_PTR: {
+                void *v = va_arg(args, void *);
+                retval = _deferred_put(d, &n, &v, sizeof(v));
+                break;
+            }
+            case ARG_DOUBLE: {
+                double v = va_arg(args, double);
+                retval = _deferred_put(d, &n, &v, sizeof(v));
+                break;
+            }
+            default:
+                /* %s may point to a buffer gone before the line is formatted */
+                retval = false;
+                break;
+        }
+    }
+    if(retval) {
+        d->timed = _log_now(&d->ts);
+    }
+
+    return retval;
+}
+
+/* Format a deferred record into out, like _vformat() does with the captured
+ * arguments. fmt is the format string of the record, or a tail of it with no
+ * conversion cut off.
+ */
+static void _deferred_format(const struct xlog_deferred *d, const char *fmt, struct log_out *out)
+{
+    struct xlog_conv conv = {0};
+    union log_arg arg = {0};
+    const char *p = NULL;
+    int stars[2] = {0};
+    uint32_t n = 0;
+
+    while(*fmt) {
+        p = _next_conv(fmt, &conv);
+        _out_literal(out, fmt, p ? conv.start : NULL);
+        if(!p) {
+            break;
+        }
+        for(uint32_t i = 0; i < conv.stars; ++i) {
+            _deferred_get(d, &n, &stars[i], sizeof(stars[i]));
+        }
+        switch(conv.type) {
+            case ARG_INT: {
+                int v = 0;
+                _deferred_get(d, &n, &v, sizeof(v));
+                arg.i = v;
+                break;
+            }
+            case ARG_LONG: {
+                long v = 0;
+                _deferred_get(d, &n, &v, sizeof(v));
+                arg.i = v;
+                break;
+            }
+            case ARG_LLONG:
+                _deferred_get(d, &n, &arg.i, sizeof(arg.i));
+                break;
+            case ARG_SIZE: {
+                size_t v = 0;
+                _deferred_get(d, &n, &v, sizeof(v));
+                arg.i = v;
+                break;
+            }
+            case ARG_PTR:
+                _deferred_get(d, &n, &arg.p, sizeof(arg.p));
+                break;
+            case ARG_DOUBLE:
+                _deferred_get(d, &n, &arg.d, sizeof(arg.d));
+                break;
+            default:
+                break;
+        }
+        _out_conv(out, &conv, stars, &arg);
+        fmt = p;
+    }
+}
+
+#ifdef CONFIG_XLOG_LOCKLESS
+/* Format a captured line and put it into the log buffer without printing it,
+ * waiting for room as __log_store() does. The return value tells whether
+ * _log_output() should be called.
+ */
+static bool __log_captured(const struct xlog_deferred *d, uint32_t waits)
+{
+    char text[CONFIG_XLOG_LINE_SIZE];
+    struct log_out_buf b;
+    uint32_t len = 0;
+
+    _out_buf_init(&b, text, sizeof(text));
+    _deferred_format(d, d->fmt, &b.out);
+
+    return __log_store(text, strlen(text), 0, d->timed ? &d->ts : NULL, d->tag, waits, &len);
+}
+
+/* Format a captured line and put it into the log buffer.
+ */
+static inline void _log_captured(const struct xlog_deferred *d)
+{
+    if(__log_captured(d, CONFIG_XLOG_RESERVE_WAITS)) {
+        _log_output();
+    }
+}
+#else
+/* Format a captured line into the log buffer with the lock held, the lock is
+ * released on return.
+ */
+static void __log_captured(const struct xlog_deferred *d)
+{
+    struct log_out_ring ring;
+    uint32_t skip = 0;
+
+    skip = _log_begin(&ring, d->fmt, d->timed ? &d->ts : NULL, d->tag);
+    _deferred_format(d, d->fmt + skip, &ring.out);
+    _log_end(&ring);
+}
+
+/* Format a captured line and put it into the log buffer.
+ */
+static inline void _log_captured(const struct xlog_deferred *d)
+{
+    __lock();
+    __log_captured(d);
+}
+#endif
+#endif
+
+#ifdef CONFIG_XLOG_DEFERRED
+/* Deferred records are kept in a bounded multi-producer queue: a producer
+ * claims a slot by moving deferred_head, then publishes it by writing the
+ * slot sequence. It is not preempted in between, as _deferred_drain() waits
+ * for the slots claimed before it to be published.
+ */
+static bool _deferred_push(const struct xlog_deferred *d)
+{
+    struct xlog_deferred *slot = NULL;
+    uint32_t pos = 0;
+    int32_t dif = 0;
+
+    __suspend();
+    pos = __atomic_load_n(&deferred_head, __ATOMIC_RELAXED);
+    for(;;) {
+        slot = &deferred_slots[pos & DEFERRED_MASK];
+        dif = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+        if(dif == 0) {
+            if(__atomic_compare_exchange_n(&deferred_head, &pos, pos + 1, true,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if(dif < 0) {
+            /* queue full */
+            __resume();
+            return false;
+        } else {
+            pos = __atomic_load_n(&deferred_head, __ATOMIC_RELAXED);
+        }
+    }
+    slot->tag = d->tag;
+    slot->fmt = d->fmt;
+    slot->timed = d->timed;
+    slot->ts = d->ts;
+    memcpy(slot->args, d->args, sizeof(slot->args));
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    __resume();
+
+    return true;
+}
+
+static bool _deferred_pop(struct xlog_deferred *d)
+{
+    struct xlog_deferred *slot = &deferred_slots[deferred_tail & DEFERRED_MASK];
+
+    if(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != (deferred_tail + 1)) {
+        return false;
+    }
+    d->tag = slot->tag;
+    d->fmt = slot->fmt;
+    d->timed = slot->timed;
+    d->ts = slot->ts;
+    memcpy(d->args, slot->args, sizeof(d->args));
+    __atomic_store_n(&slot->seq, deferred_tail + CONFIG_XLOG_DEFERRED_SLOTS, __ATOMIC_RELEASE);
+    __atomic_store_n(&deferred_tail, deferred_tail + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/* Take the record at the tail of the queue and put it into the log buffer.
+ * A record is taken and stored in one go, under the lock, or in lockless mode
+ * with deferred_busy taken and without being preempted, so that it is never
+ * out of both the queue and the log buffer for long. In lockless mode *output
+ * is set when _log_output() should be called, once the caller is done.
+ * Returns false if the queue is empty, its tail is not published yet or
+ * another consumer is storing a record.
+ */
+static bool _deferred_store(bool *output)
+{
+    struct xlog_deferred d;
+    bool retval = false;
+#ifdef CONFIG_XLOG_LOCKLESS
+    uint32_t waits = CONFIG_XLOG_RESERVE_WAITS;
+
+    /* the record is stored without being preempted, the room for a line is waited for first */
+    if(__atomic_load_n(&deferred_head, __ATOMIC_RELAXED) != __atomic_load_n(&deferred_tail, __ATOMIC_RELAXED)) {
+        _log_wait_room(sizeof(struct log_record) + CONFIG_XLOG_LINE_SIZE, &waits);
+    }
+    __suspend();
+    if(!__atomic_exchange_n(&deferred_busy, true, __ATOMIC_ACQUIRE)) {
+        retval = _deferred_pop(&d);
+        if(retval && __log_captured(&d, 0)) {
+            *output = true;
+        }
+        __atomic_store_n(&deferred_busy, false, __ATOMIC_RELEASE);
+    }
+    __resume();
+#else
+    __lock();
+    retval = _deferred_pop(&d);
+    if(retval) {
+        __log_captured(&d);
+    } else {
+        __unlock();
+    }
+#endif
+
+    return retval;
+}
+
+/* Print the records _deferred_store() put into the log buffer.
+ */
+static inline void _deferred_output(bool output)
+{
+#ifdef CONFIG_XLOG_LOCKLESS
+    if(output) {
+        _log_output();
+    }
+#endif
+}
+
+static uint32_t _deferred_process(void)
+{
+    uint32_t count = 0;
+    bool output = false;
+
+    while(_deferred_store(&output)) {
+        count++;
+    }
+    _deferred_output(output);
+
+    return count;
+}
+
+/* Tell whether the records queued before end are in the log buffer.
+ */
+static inline bool _deferred_drained(uint32_t end)
+{
+    bool retval = ((int32_t)(end - __atomic_load_n(&deferred_tail, __ATOMIC_ACQUIRE)) <= 0);
+
+#ifdef CONFIG_XLOG_LOCKLESS
+    /* the record taken last may not be stored yet */
+    retval = retval && !__atomic_load_n(&deferred_busy, __ATOMIC_ACQUIRE);
+#endif
+
+    return retval;
+}
+
+/* Put every record queued until now into the log buffer, before a line which
+ * is stored in place. The records claimed but not published yet and the one
+ * another consumer is storing are waited for, neither can be preempted, the
+ * task yields to them meanwhile. In locked mode the record stored last by
+ * another consumer may still hold the lock, the line stored in place waits for
+ * it. The records are printed once they are all stored.
+ */
+static void _deferred_drain(void)
+{
+    uint32_t end = __atomic_load_n(&deferred_head, __ATOMIC_ACQUIRE);
+    bool output = false;
+
+    while(!_deferred_drained(end)) {
+        if(!_deferred_store(&output)) {
+            __yield();
+        }
+    }
+    _deferred_output(output);
+}
+
+static uint32_t __attribute__((format(printf, 2, 0))) _deferred_vprint(uint16_t tag, const char *fmt, va_list args)
+{
+    struct xlog_deferred d;
+    uint32_t len = 0;
+    va_list args_copy;
+
+    va_copy(args_copy, args);
+    d.tag = tag;
+    if(!_deferred_capture(&d, fmt, args_copy) || !_deferred_push(&d)) {
+        /* format in place, after the lines queued before this one */
+        _deferred_drain();
+        len = _vprint(tag, fmt, args);
+    }
+    va_end(args_copy);
+
+    return len;
+}
+#endif
+
+#ifdef CONFIG_XLOG_ISR
+static inline uint32_t __core_id(void)
+{
+    uint32_t retval = 0;
+
+    if(_xlog.ops.core_id) {
+        retval = _xlog.ops.core_id();
+    }
+
+    return retval;
+}
+
+/* Stage a line in the ring of the current core. The slot is claimed with a
+ * compare-and-swap, which only fails when a nested interrupt of the same core
+ * claimed a slot in between, so it is retried at most once per nesting level.
+ * The order is taken after the slot is claimed: while the line is not
+ * published yet, the merge stops at this slot and can not pass it with a line
+ * of a greater order.
+ */
+static bool _isr_push(struct xlog_isr_ring *ring, const struct xlog_deferred *d)
+{
+    struct xlog_deferred *slot = NULL;
+    uint32_t pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+    do {
+        slot = &ring->slots[pos & ISR_MASK];
+        if(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos) {
+            /* ring full */
+            return false;
+        }
+    } while(!__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, false,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    ring->order[pos & ISR_MASK] = __atomic_fetch_add(&isr_order, 1, __ATOMIC_RELAXED);
+    ring->lost[pos & ISR_MASK] = 0;
+    if(__atomic_load_n(&ring->pending_lost, __ATOMIC_RELAXED)) {
+        ring->lost[pos & ISR_MASK] = __atomic_exchange_n(&ring->pending_lost, 0, __ATOMIC_RELAXED);
+    }
+    slot->tag = d->tag;
+    slot->fmt = d->fmt;
+    slot->timed = d->timed;
+    slot->ts = d->ts;
+    memcpy(slot->args, d->args, sizeof(slot->args));
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/* Find the ring holding the line of the lowest order. NULL is returned when
+ * no line is staged, or when a line is still being staged by an interrupt
+ * of the other core, as it may come before the others.
+ */
+static struct xlog_isr_ring *_isr_oldest(void)
+{
+    struct xlog_isr_ring *ring = NULL, *retval = NULL;
+    uint32_t tail = 0;
+
+    for(uint32_t i = 0; i < CONFIG_XLOG_ISR_CORES; ++i) {
+        ring = &isr_rings[i];
+        tail = ring->tail;
+        if(__atomic_load_n(&ring->slots[tail & ISR_MASK].seq, __ATOMIC_ACQUIRE) == (tail + 1)) {
+            if(!retval || (int32_t)(ring->order[tail & ISR_MASK] - retval->order[retval->tail & ISR_MASK]) < 0) {
+                retval = ring;
+            }
+        } else if(__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) != tail) {
+            retval = NULL;
+            break;
+        }
+    }
+
+    return retval;
+}
+
+static inline bool _isr_pending(void)
+{
+    bool retval = false;
+
+    for(uint32_t i = 0; !retval && i < CONFIG_XLOG_ISR_CORES; ++i) {
+        retval = (__atomic_load_n(&isr_rings[i].head, __ATOMIC_RELAXED) != isr_rings[i].tail) ||
+                 __atomic_load_n(&isr_rings[i].pending_lost, __ATOMIC_RELAXED);
+    }
+
+    return retval;
+}
+
+/* Move the staged lines into the log buffer in the order they were logged.
+ * In deferred mode they are queued after the deferred lines logged before.
+ */
+static void _isr_merge(void)
+{
+    struct xlog_isr_ring *ring = NULL;
+    struct xlog_deferred d;
+    uint32_t tail = 0, lost = 0;
+
+    /* only one consumer at a time */
+    if(!_isr_pending() || __atomic_exchange_n(&isr_busy, true, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    while((ring = _isr_oldest()) != NULL) {
+        tail = ring->tail;
+        d = ring->slots[tail & ISR_MASK];
+        lost = ring->lost[tail & ISR_MASK];
+        __atomic_store_n(&ring->slots[tail & ISR_MASK].seq, tail + CONFIG_XLOG_ISR_SLOTS, __ATOMIC_RELEASE);
+        ring->tail = tail + 1;
+        if(lost) {
+            _log_lost(lost);
+        }
+#ifdef CONFIG_XLOG_DEFERRED
+        if(_deferred_push(&d)) {
+            continue;
+        }
+        _deferred_drain();
+#endif
+        _log_captured(&d);
+    }
+    /* the lines not staged after the last line merged */
+    for(uint32_t i = 0; i < CONFIG_XLOG_ISR_CORES; ++i) {
+        lost = __atomic_exchange_n(&isr_rings[i].pending_lost, 0, __ATOMIC_RELAXED);
+        if(lost) {
+            _log_lost(lost);
+        }
+    }
+    __atomic_store_n(&isr_busy, false, __ATOMIC_RELEASE);
+}
+#endif
+
+/* Log level the lines are stored up to, the most verbose of the console and
+ * the sinks.
+ */
+static inline uint32_t _log_store_level(void)
+{
+    uint32_t level = _xlog.log_level.console_level;
+
+    if(level < _xlog.log_level.sink_level) {
+        level = _xlog.log_level.sink_level;
+    }
+
+    return level;
+}
+
+/* Check the log level in the format string before anything is formatted.
+ * A continued line follows the fate of the line the same task logged last.
+ */
+static bool _log_filtered(const char *fmt)
+{
+    uint32_t level = _xlog.log_level.default_level;
+    bool newline = false, retval = cont_filtered;
+
+    if(!(fmt[0] == '<' && fmt[1] == 'c' && fmt[2] == '>')) {
+        _parse_log_level(fmt, &level, &newline);
+        retval = (level >= _log_store_level());
+        if(newline && cont_filtered != retval) {
+            cont_filtered = retval;
+        }
+    }
+
+    return retval;
+}
+
+/* Put the lines logged from interrupts and the deferred lines into the log buffer,
+ * ahead of a message which is put there in place.
+ */
+static inline void _log_in_place(void)
+{
+#ifdef CONFIG_XLOG_ISR
+    _isr_merge();
+#endif
+#ifdef CONFIG_XLOG_DEFERRED
+    _deferred_drain();
+#endif
+}
+
+static uint32_t __attribute__((format(printf, 2, 0))) _xlog_vprint(uint16_t tag, const char *fmt, va_list args)
+{
+    uint32_t len = 0;
+
+#ifdef CONFIG_XLOG_ISR
+    /* the lines logged from interrupts until now go first */
+    _isr_merge();
+#endif
+#ifdef CONFIG_XLOG_DEFERRED
+    len = _deferred_vprint(tag, fmt, args);
+#else
+    len = _vprint(tag, fmt, args);
+#endif
+
+    return len;
+}
+
+uint32_t __attribute__((format(printf, 1, 0))) xlog(const char *fmt, ...)
+{
+    va_list args;
+    uint32_t len = 0;
+
+    if(_log_filtered(fmt)) {
+        return 0;
+    }
+    va_start(args, fmt);
+    len = _xlog_vprint(LOG_TAG_NONE, fmt, args);
+    va_end(args);
+
+    return len;
+}
+
+void xlog_compiled_out(void)
+{
+    /* only written when it changes, as by _log_filtered() */
+    if(!cont_filtered) {
+        cont_filtered = true;
+    }
+}
+
+bool __attribute__((format(printf, 1, 0))) xlog_from_isr(const char *fmt, ...)
+{
+    bool retval = false;
+#ifdef CONFIG_XLOG_ISR
+    struct xlog_isr_ring *ring = NULL;
+    struct xlog_deferred d;
+    uint32_t level = _xlog.log_level.default_level;
+    bool newline = false;
+    va_list args;
+
+    _parse_log_level(fmt, &level, &newline);
+    if(level < _log_store_level()) {
+        ring = &isr_rings[__core_id() % CONFIG_XLOG_ISR_CORES];
+        d.tag = LOG_TAG_NONE;
+        va_start(args, fmt);
+        retval = _deferred_capture(&d, fmt, args) && _isr_push(ring, &d);
+        va_end(args);
+        if(!retval) {
+            /* a staged line is accounted once it is stored */
+            __atomic_fetch_add(&ring->dropped[level], 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&ring->pending_lost, 1, __ATOMIC_RELAXED);
+        }
+    }
+#else
+    (void)fmt;
+#endif
+
+    return retval;
+}
+
+/* Find the id of a tag or register it. A free slot is claimed with a CAS so
+ * that producers registering at the same time never share a slot, the name is
+ * copied into it, so the tag needs not outlive the call. If no slot is left
+ * CONFIG_XLOG_TAG_MAX is returned, and -1 when a slot met is still being named
+ * by another task, as it may be this very tag.
+ */
+static int16_t _tag_lookup(const char *tag)
+{
+    int16_t id = 0;
+    uint8_t state = TAG_FREE;
+
+    for(id = 0; id < CONFIG_XLOG_TAG_MAX; ++id) {
+        state = __atomic_load_n(&tag_states[id], __ATOMIC_ACQUIRE);
+        if(state == TAG_FREE &&
+           __atomic_compare_exchange_n(&tag_states[id], &state, TAG_NAMING, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+            strncpy(tag_names[id], tag, CONFIG_XLOG_TAG_NAME_SIZE - 1);
+            __atomic_store_n(&tag_states[id], TAG_NAMED, __ATOMIC_RELEASE);
+            break;
+        }
+        if(state == TAG_NAMING) {
+            id = -1;
+            break;
+        }
+        if(!strncmp(tag_names[id], tag, CONFIG_XLOG_TAG_NAME_SIZE - 1)) {
+            break;
+        }
+    }
+
+    return id;
+}
+
+bool xlog_tag_enabled(int16_t *id, const char *tag, uint32_t level)
+{
+    uint32_t tag_level = 0;
+    int16_t tag_id = *id;
+    bool retval = false;
+
+    if(tag_id < 0) {
+        tag_id = _tag_lookup(tag);
+        /* looked up again next time while the registry is being written */
+        *id = tag_id;
+        tag_id = (tag_id < 0) ? CONFIG_XLOG_TAG_MAX : tag_id;
+    }
+    tag_level = tag_levels[tag_id];
+    if(tag_level == TAG_LEVEL_CONSOLE) {
+        tag_level = _xlog.log_level.console_level;
+    }
+    /* the sinks do not follow the tag levels */
+    if(tag_level < _xlog.log_level.sink_level) {
+        tag_level = _xlog.log_level.sink_level;
+    }
+    retval = (level < tag_level);
+    /* only written when it changes, most lines leave it as it is */
+    if(cont_filtered == retval) {
+        cont_filtered = !retval;
+    }
+
+    return retval;
+}
+
+uint32_t __attribute__((format(printf, 2, 0))) xlog_tag_print(int16_t id, const char *fmt, ...)
+{
+    va_list args;
+    uint32_t len = 0;
+
+    va_start(args, fmt);
+    len = _xlog_vprint(id, fmt, args);
+    va_end(args);
+
+    return len;
+}
+
+#ifdef CONFIG_XLOG_BINARY
+/* Encode the arguments of a binary record after the id of its format string.
+ * Returns the length of the record.
+ */
+static uint32_t _bin_encode(uint8_t *data, uint32_t fmt, uint32_t desc, va_list args)
+{
+    uint32_t len = 0, n = 0, size = 0, narg = (desc >> XLOG_BIN_NARG_SHIFT) & 0xF;
+    const char *s = NULL;
+    double d = 0;
+
+    len = _put_varint(data, fmt);
+    for(; n < narg && n < XLOG_BIN_ARGS_MAX; ++n, desc >>= 2) {
+        switch(desc & 0x3) {
+            case XLOG_BIN_INT:
+                len += _put_varint(&data[len], _zigzag((int32_t)va_arg(args, int)));
+                break;
+            case XLOG_BIN_INT64:
+                len += _put_varint(&data[len], _zigzag((int64_t)va_arg(args, long long)));
+                break;
+            case XLOG_BIN_DOUBLE:
+                d = va_arg(args, double);
+                memcpy(&data[len], &d, sizeof(d));
+                len += sizeof(d);
+                break;
+            case XLOG_BIN_STR:
+                s = va_arg(args, const char *);
+                s = s ? s : "(null)";
+                for(size = 0; size < CONFIG_XLOG_BIN_STR_MAX && s[size]; ++size) {
+                }
+                len += _put_varint(&data[len], size);
+                memcpy(&data[len], s, size);
+                len += size;
+                break;
+        }
+    }
+
+    return len;
+}
+
+uint32_t xlog_bin(int16_t id, const char *level, uint32_t fmt, uint32_t desc, ...)
+{
+    uint8_t bin = LOG_REC_BIN | ((desc & XLOG_BIN_EOL) ? LOG_REC_EOL : 0);
+    uint16_t tag = (id < 0) ? LOG_TAG_NONE : (uint16_t)id;
+    va_list args;
+    uint32_t len = 0;
+#ifdef CONFIG_XLOG_LOCKLESS
+    char text[3 + LOG_BIN_SIZE];
+#else
+    uint8_t data[LOG_BIN_SIZE];
+#endif
+
+    /* the level of a tagged line has been checked by xlog_tag_enabled() */
+    if(id < 0 && _log_filtered(level)) {
+        return 0;
+    }
+    _log_in_place();
+    va_start(args, desc);
+#ifdef CONFIG_XLOG_LOCKLESS
+    memcpy(text, level, 3);
+    len = _bin_encode((uint8_t *)&text[3], fmt, desc, args);
+    len = _log_store(text, 3 + len, bin, NULL, tag);
+#else
+    len = _bin_encode(data, fmt, desc, args);
+    len = _log_bin(level, data, len, bin, tag);
+#endif
+    va_end(args);
+
+    return len;
+}
+#endif
+
+/* Render a row of xlog_hexdump(), n bytes from p at offset off.
+ */
+static uint32_t _hexdump_row(char *row, const uint8_t *p, uint32_t n, uint32_t off, uint32_t digits)
+{
+    uint32_t len = 0;
+
+    while(digits--) {
+        row[len++] = hex_digits[(off >> (digits * 4)) & 0xF];
+    }
+    row[len++] = ':';
+    for(uint32_t i = 0; i < LOG_HEX_ROW; ++i) {
+        row[len++] = ' ';
+        if(i == (LOG_HEX_ROW / 2)) {
+            row[len++] = ' ';
+        }
+        row[len++] = (i < n) ? hex_digits[p[i] >> 4] : ' ';
+        row[len++] = (i < n) ? hex_digits[p[i] & 0xF] : ' ';
+    }
+    row[len++] = ' ';
+    row[len++] = ' ';
+    row[len++] = '|';
+    for(uint32_t i = 0; i < n; ++i) {
+        row[len++] = (p[i] >= 0x20 && p[i] < 0x7F) ? (char)p[i] : '.';
+    }
+    row[len++] = '|';
+    row[len++] = '\n';
+
+    return len;
+}
+
+#ifdef CONFIG_XLOG_LOCKLESS
+/* Store the rows of xlog_hexdump() into the log buffer, one record per row.
+ * Every row is put into a range reserved for all of them as it is rendered, so no
+ * line of another task gets in between. A dump the log buffer cannot hold at
+ * once is stored as many rows at a time as it holds.
+ * Returns the number of chars stored.
+ */
+static uint32_t _hexdump_store(const char *level, const char *tag, const uint8_t *p, uint32_t len,
+                               uint32_t digits, uint16_t rec_tag)
+{
+    struct log_record rec;
+    char row[LOG_TEXT_MAX];
+    uint32_t level_no = _xlog.log_level.default_level, prefix = 0, row_max = 0, rows = 0, n = 0;
+    uint32_t off = 0, total = 0, bytes = 0;
+    bool newline = false, line_break = false;
+    uint32_t retval = 0;
+
+    memset(&rec, 0, sizeof(rec));
+    _parse_log_level(level, &level_no, &newline);
+    rec.level = level_no;
+    rec.tag = rec_tag;
+    if(_log_now(&rec.ts)) {
+        rec.flags = LOG_REC_TIME;
+    }
+    if(tag) {
+        prefix = strlen(tag);
+        prefix = (prefix > LOG_HEX_TAG_MAX) ? LOG_HEX_TAG_MAX : prefix;
+        row[0] = '(';
+        memcpy(&row[1], tag, prefix);
+        row[prefix + 1] = ')';
+        prefix += 2;
+    }
+    /* a record of a full row, the last row lacks the ASCII of the bytes it lacks */
+    row_max = sizeof(rec) + prefix + digits + LOG_HEX_ROW * 3 + 7 + LOG_HEX_ROW;
+    for(uint32_t base = 0; base < len; base += bytes) {
+        rows = __LOG_BUF_LEN / row_max;
+        bytes = ((len - base) < rows * LOG_HEX_ROW) ? (len - base) : rows * LOG_HEX_ROW;
+        rows = (bytes + LOG_HEX_ROW - 1) / LOG_HEX_ROW;
+        total = rows * (row_max - LOG_HEX_ROW) + bytes;
+        if(!_log_claim(total, rows, level_no, total - rows * sizeof(rec), CONFIG_XLOG_RESERVE_WAITS, &off)) {
+            continue;
+        }
+        rec.lost = _log_take_lost();
+        line_break = (newline && !next_text_line);
+        for(uint32_t i = 0; i < bytes; i += n) {
+            n = ((bytes - i) < LOG_HEX_ROW) ? (bytes - i) : LOG_HEX_ROW;
+            rec.len = prefix + _hexdump_row(&row[prefix], &p[base + i], n, base + i, digits);
+            rec.flags &= LOG_REC_TIME;
+            rec.flags |= (next_text_line || line_break) ? 0 : LOG_REC_CONT;
+            rec.flags |= line_break ? LOG_REC_BREAK : 0;
+            _log_commit(off, &rec, row);
+            off += sizeof(rec) + rec.len;
+            next_text_line = true;
+            line_break = false;
+            rec.lost = 0;
+        }
+        _log_publish();
+        __resume();
+        retval += total - rows * sizeof(rec);
+        _log_output();
+    }
 
-/*---------- function ----------*/
-static inline void __lock(void)
+    return retval;
+}
+#endif
+
+uint32_t xlog_tag_hexdump(int16_t *id, const char *level, const char *tag, const void *buf, uint32_t len)
 {
-    if(_xlog.ops.lock) {
-        _xlog.ops.lock();
+    const uint8_t *p = (const uint8_t *)buf;
+    uint32_t digits = (len > 0x10000) ? 8 : 4, level_no = _xlog.log_level.default_level;
+    uint16_t rec_tag = LOG_TAG_NONE;
+#ifndef CONFIG_XLOG_LOCKLESS
+    char row[LOG_HEX_ROW_SIZE];
+    uint32_t n = 0, size = 0;
+    struct log_out_ring ring;
+    struct log_out *out = NULL;
+#endif
+    uint32_t retval = 0;
+
+    if(level[1] >= '0' && level[1] <= '3') {
+        level_no = level[1] - '0';
+    }
+    if((tag && !xlog_tag_enabled(id, tag, level_no)) || (!tag && _log_filtered(level))) {
+        return 0;
     }
+    if(tag && *id >= 0) {
+        rec_tag = (uint16_t)*id;
+    }
+    _log_in_place();
+#ifdef CONFIG_XLOG_LOCKLESS
+    retval = _hexdump_store(level, tag, p, len, digits, rec_tag);
+#else
+    /* every row is put under one lock */
+    __lock();
+    _log_begin(&ring, level, NULL, rec_tag);
+    out = &ring.out;
+    for(uint32_t off = 0; off < len; off += n) {
+        n = ((len - off) < LOG_HEX_ROW) ? (len - off) : LOG_HEX_ROW;
+        size = _hexdump_row(row, &p[off], n, off, digits);
+        if(tag) {
+            out->put(out, "(", 1);
+            out->put(out, tag, strlen(tag));
+            out->put(out, ")", 1);
+        }
+        out->put(out, row, size);
+    }
+    retval = _log_end(&ring);
+#endif
+
+    return retval;
 }
 
-static inline void __unlock(void)
+/* Earn the tokens due by now, one for the deadline and one for every step
+ * after it. The task moving the deadline gets them, the others earn nothing.
+ * Returns the number of tokens earned.
+ */
+static uint32_t _ratelimit_refill(xlog_ratelimit_t *rs, uint32_t now)
 {
-    if(_xlog.ops.unlock) {
-        _xlog.ops.unlock();
+    uint32_t deadline = __atomic_load_n(&rs->deadline, __ATOMIC_RELAXED), next = 0, earned = 0;
+
+    if((int32_t)(now - deadline) >= 0) {
+        earned = rs->step ? ((now - deadline) / rs->step + 1) : rs->burst;
+        if(earned >= rs->burst) {
+            earned = rs->burst;
+            next = now + rs->step;
+        } else {
+            next = deadline + earned * rs->step;
+        }
+        if(!__atomic_compare_exchange_n(&rs->deadline, &deadline, next, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            earned = 0;
+        }
     }
+
+    return earned;
 }
 
-static inline bool __acquire_console(void)
+bool xlog_ratelimit(xlog_ratelimit_t *rs, const char *fmt, const char *func)
 {
+    uint32_t now = 0, missed = 0, tokens = 0, earned = 0;
     bool retval = true;
 
-    if(_xlog.ops.acquire_console) {
-        retval = _xlog.ops.acquire_console();
+    /* a line xlog() filters anyway takes no token */
+    if(!fmt || !_log_filtered(fmt)) {
+        tokens = __atomic_load_n(&rs->tokens, __ATOMIC_RELAXED);
+        if(!tokens) {
+            /* nothing is limited without a clock */
+            earned = _log_clock_us(&now) ? _ratelimit_refill(rs, now) : rs->burst;
+            if(earned > 1) {
+                __atomic_fetch_add(&rs->tokens, earned - 1, __ATOMIC_RELAXED);
+            }
+        } else {
+            if(tokens >= rs->burst && _log_clock_us(&now)) {
+                /* a full bucket has earned nothing since, its lines are earned back from now on */
+                __atomic_store_n(&rs->deadline, now + rs->step, __ATOMIC_RELAXED);
+            }
+            while(tokens && !__atomic_compare_exchange_n(&rs->tokens, &tokens, tokens - 1, true, __ATOMIC_RELAXED,
+                                                         __ATOMIC_RELAXED)) {
+            }
+            earned = tokens ? 1 : 0;
+        }
+        if(earned) {
+            missed = __atomic_load_n(&rs->missed, __ATOMIC_RELAXED);
+            missed = missed ? __atomic_exchange_n(&rs->missed, 0, __ATOMIC_RELAXED) : 0;
+        } else {
+            __atomic_fetch_add(&rs->missed, 1, __ATOMIC_RELAXED);
+            /* and so are the lines continuing it */
+            if(!cont_filtered) {
+                cont_filtered = true;
+            }
+            retval = false;
+        }
+    }
+    if(missed) {
+        xlog(LOG_WARN "xlog: %u lines suppressed in %s()\n", missed, func);
     }
 
     return retval;
 }
 
-static inline void __release_console(void)
+bool xlog_set_tag_level(const char *tag, const char *level)
 {
-    if(_xlog.ops.release_console) {
-        _xlog.ops.release_console();
+    int16_t id = _tag_lookup(tag);
+    bool retval = false;
+
+    if(id >= 0 && id < CONFIG_XLOG_TAG_MAX) {
+        if(!level) {
+            tag_levels[id] = TAG_LEVEL_CONSOLE;
+            retval = true;
+        } else if(level[0] == '<' && level[1] >= '0' && level[1] <= '3' && level[2] == '>') {
+            tag_levels[id] = (level[1] - '0') + 1;
+            retval = true;
+        }
     }
+
+    return retval;
 }
 
-static inline void __console_print(uint32_t start, uint32_t end)
+uint32_t xlog_process(void)
 {
-    if(_xlog.ops.print) {
-        _xlog.ops.print(&LOG_BUF(start), end - start);
+    uint32_t count = 0;
+
+#ifdef CONFIG_XLOG_ISR
+    _isr_merge();
+#endif
+#ifdef CONFIG_XLOG_DEFERRED
+    count = _deferred_process();
+#endif
+#if defined(CONFIG_XLOG_DEDUP) && !defined(CONFIG_XLOG_LOCKLESS)
+    _dedup_flush();
+#endif
+#ifdef CONFIG_XLOG_ASYNC
+    _drain_console();
+#endif
+    for(uint32_t i = 0; i < CONFIG_XLOG_SINK_MAX; ++i) {
+        if(__atomic_load_n(&log_sinks[i].used, __ATOMIC_ACQUIRE) && !log_sinks[i].ops.manual) {
+            _sink_process(&log_sinks[i], false);
+        }
     }
+
+    return count;
 }
 
-static void emit_log_char(char c)
+bool xlog_set_async_policy(xlog_async_policy_t policy)
 {
-    uint32_t cache_len = 0;
+    bool retval = false;
 
-    LOG_BUF(log_end) = c;
-    log_end++;
-    /* buf overflow, drop some str */
-    if(log_end < log_start) {
-        cache_len = UINT32_MAX - log_start + log_end + 1;
-    } else {
-        cache_len = log_end - log_start;
-    }
-    if(cache_len > __LOG_BUF_LEN) {
-        log_start++;
+#ifdef CONFIG_XLOG_ASYNC
+    if(policy == XLOG_ASYNC_BLOCK || policy == XLOG_ASYNC_DROP_OLDEST || policy == XLOG_ASYNC_DROP_NEWEST) {
+        _xlog.async.policy = policy;
+        retval = true;
     }
+#else
+    (void)policy;
+#endif
+
+    return retval;
 }
 
-static void __call_console(uint32_t start, uint32_t end, uint32_t log_level)
+void xlog_get_async_stats(xlog_async_stats_t *stats)
 {
-    if(log_level < _xlog.log_level.console_level && start != end) {
-        if((start & LOG_BUF_MASK) > (end & LOG_BUF_MASK)) {
-            __console_print(start & LOG_BUF_MASK, __LOG_BUF_LEN);
-            __console_print(0, end & LOG_BUF_MASK);
-        } else {
-            __console_print(start, end);
+#ifdef CONFIG_XLOG_ASYNC
+    stats->blocked = __atomic_load_n(&_xlog.async.stats.blocked, __ATOMIC_RELAXED);
+    stats->dropped_oldest = __atomic_load_n(&_xlog.async.stats.dropped_oldest, __ATOMIC_RELAXED);
+    stats->dropped_newest = __atomic_load_n(&_xlog.async.stats.dropped_newest, __ATOMIC_RELAXED);
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
+}
+
+void xlog_get_stats(xlog_stats_t *stats)
+{
+    uint32_t isr_dropped = 0;
+
+    for(uint32_t i = 0; i < XLOG_LEVEL_COUNT; ++i) {
+        isr_dropped = 0;
+#ifdef CONFIG_XLOG_ISR
+        for(uint32_t j = 0; j < CONFIG_XLOG_ISR_CORES; ++j) {
+            isr_dropped += __atomic_load_n(&isr_rings[j].dropped[i], __ATOMIC_RELAXED);
         }
+#endif
+        stats->written[i] = __atomic_load_n(&log_stats.written[i], __ATOMIC_RELAXED) + isr_dropped;
+        stats->dropped[i] = __atomic_load_n(&log_stats.dropped[i], __ATOMIC_RELAXED) + isr_dropped;
+        stats->dropped_bytes[i] = __atomic_load_n(&log_stats.dropped_bytes[i], __ATOMIC_RELAXED);
     }
+    stats->high_watermark = __atomic_load_n(&log_stats.high_watermark, __ATOMIC_RELAXED);
+    stats->size = __LOG_BUF_LEN;
 }
 
-static void _call_console(uint32_t start, uint32_t end)
+int32_t xlog_add_sink(const xlog_sink_t *sink)
 {
-    uint32_t cur_off = start, print_off = start;
-    static int32_t msg_level = -1;
-    bool overflow = false;
-
-    if((int32_t)(start - end) > 0) {
-        overflow = true;
-    }
-    while(cur_off != end) {
-        if((msg_level < 0) &&
-                ((!overflow && ((end - cur_off) > 2)) ||
-                (overflow && ((UINT32_MAX - cur_off + end + 1) > 2))) &&
-                LOG_BUF(cur_off + 0) == '<' &&
-                LOG_BUF(cur_off + 1) >= '0' &&
-                LOG_BUF(cur_off + 1) <= '3' &&
-                LOG_BUF(cur_off + 2) == '>') {
-            msg_level = LOG_BUF(cur_off + 1) - '0';
-            LOG_BUF(cur_off + 1) = log_level_char[msg_level];
-            cur_off += 3;
-            print_off += 3;
-        }
-        while(cur_off != end) {
-            char c = LOG_BUF(cur_off);
-            cur_off++;
-            if(c == '\n') {
-                if(msg_level < 0) {
-                    msg_level = _xlog.log_level.default_level;
-                }
-                __call_console(print_off, cur_off, msg_level);
-                msg_level = -1;
-                print_off = cur_off;
-                break;
+    struct log_sink *s = NULL;
+    struct log_record rec;
+    bool busy = false;
+    int32_t retval = -1;
+
+    if(!sink || !sink->write || (sink->level && !(sink->level[0] == '<' && sink->level[1] >= '0' &&
+                                                  sink->level[1] <= '3' && sink->level[2] == '>'))) {
+        return retval;
+    }
+    for(int32_t i = 0; i < CONFIG_XLOG_SINK_MAX && retval < 0; ++i) {
+        s = &log_sinks[i];
+        busy = false;
+        if(__atomic_load_n(&s->used, __ATOMIC_ACQUIRE) ||
+           !__atomic_compare_exchange_n(&s->busy, &busy, true, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        if(!__atomic_load_n(&s->used, __ATOMIC_ACQUIRE)) {
+            s->ops = *sink;
+            s->level = sink->level ? (sink->level[1] - '0') + 1 : XLOG_LEVEL_COUNT;
+            /* the new sink starts with the oldest lines kept, the lines overwritten
+             * before it first reads are reported lost as well
+             */
+            memset(&s->reader, 0, sizeof(s->reader));
+            s->reader.off = __atomic_load_n(&log_first, __ATOMIC_ACQUIRE);
+            s->reader.seq = __atomic_load_n(&log_seq, __ATOMIC_RELAXED);
+            if(s->reader.off != _log_readable()) {
+                _log_read(s->reader.off, &rec, sizeof(rec));
+                s->reader.seq = _log_intact(s->reader.off) ? rec.seq : s->reader.seq;
+            }
+            s->reader.read = true;
+            s->len = 0;
+            s->skip = false;
+            s->new_line = true;
+            s->ts = 0;
+            if(sink->lz) {
+                xlog_lz_reset(sink->lz);
             }
+            __atomic_store_n(&s->used, true, __ATOMIC_RELEASE);
+            retval = i;
         }
+        __atomic_store_n(&s->busy, false, __ATOMIC_RELEASE);
     }
-    __call_console(print_off, end, msg_level);
+    if(retval >= 0) {
+        _sink_update_level();
+    }
+
+    return retval;
 }
 
-static bool _acquire_console(void)
+bool xlog_remove_sink(int32_t id)
 {
-    __unlock();
-    
-    return __acquire_console();
+    struct log_sink *s = NULL;
+    bool retval = false;
+
+    if(id >= 0 && id < CONFIG_XLOG_SINK_MAX) {
+        s = &log_sinks[id];
+        if(!__atomic_exchange_n(&s->busy, true, __ATOMIC_ACQUIRE)) {
+            if(__atomic_load_n(&s->used, __ATOMIC_ACQUIRE)) {
+                __sink_write(s);
+                __atomic_store_n(&s->used, false, __ATOMIC_RELEASE);
+                retval = true;
+            }
+            __atomic_store_n(&s->busy, false, __ATOMIC_RELEASE);
+        }
+    }
+    if(retval) {
+        _sink_update_level();
+    }
+
+    return retval;
 }
 
-static void _print_and_release_console(void)
+bool xlog_set_sink_level(int32_t id, const char *level)
 {
-    uint32_t _con_start = log_start, _con_end = log_end;
+    bool retval = false;
 
-    log_start = log_end;
-    _call_console(_con_start, _con_end);
-    __release_console();
+    if(id >= 0 && id < CONFIG_XLOG_SINK_MAX && __atomic_load_n(&log_sinks[id].used, __ATOMIC_ACQUIRE)) {
+        if(!level) {
+            log_sinks[id].level = XLOG_LEVEL_COUNT;
+            retval = true;
+        } else if(level[0] == '<' && level[1] >= '0' && level[1] <= '3' && level[2] == '>') {
+            log_sinks[id].level = (level[1] - '0') + 1;
+            retval = true;
+        }
+    }
+    if(retval) {
+        _sink_update_level();
+    }
+
+    return retval;
 }
 
-static inline uint32_t _vscnprint(char *buf, uint32_t size, const char *fmt, va_list args)
+uint32_t xlog_flush_sink(int32_t id)
 {
-    uint32_t len = 0;
+    uint32_t count = 0;
 
-    len = vsnprintf(buf, size, fmt, args);
+    if(id >= 0 && id < CONFIG_XLOG_SINK_MAX) {
+        count = _sink_process(&log_sinks[id], true);
+    }
 
-    return (len >= size) ? (size - 1) : len;
+    return count;
 }
 
-static uint32_t __attribute__((format(printf, 1, 0))) _vprint(const char *fmt, va_list args)
+uint32_t xlog_read(uint64_t *seq, char *buf, uint32_t len)
 {
-    uint32_t printed_len = 0;
-    uint32_t cur_log_level = _xlog.log_level.default_level;
-    char *p = NULL;
-    char c = 0;
-    uint32_t len = 0;
+    struct log_reader reader;
+    struct log_record rec;
+    char head[SINK_RESERVE];
+    uint32_t end = _log_readable(), n = 0, size = 0, text = 0;
+    uint64_t lost = 0;
+    log_time_t ts = 0, last = 0;
+    bool new_line = true, head_line = false;
 
-    __lock();
-    printed_len = _vscnprint(vprintf_buf, sizeof(vprintf_buf), fmt, args);
-    p = vprintf_buf;
-    /* Do we have a log level in the string? */
-    if(p[0] == '<') {
-        c = p[1];
-        if(c && p[2] == '>') {
-            switch(c) {
-                case '0'...'3':
-                    /* Get log level */
-                    cur_log_level = c - '0';
-                case 'd':
-                    /* Failthrough - make sure we're on a new line */
-                    if(!next_text_line) {
-                        emit_log_char('\n');
-                        printed_len += 1;
-                        next_text_line = true;
-                    }
-                case 'c':
-                    /* Failthrough - skip the log level */
-                    p += 3;
-                    printed_len -= 3;
-                    break;
-            }
+    reader.off = __atomic_load_n(&log_first, __ATOMIC_ACQUIRE);
+    reader.seq = *seq;
+    reader.read = (*seq != 0);
+    reader.overrun = true;
+    while(n < len && _reader_next(&reader, end, &rec, &lost)) {
+        if(rec.seq < *seq) {
+            /* read already, the gap to the first record wanted is still counted from *seq */
+            reader.off += sizeof(rec) + rec.len;
+            continue;
         }
-    }
-    for(; *p; ++p) {
-        if(next_text_line) {
-            emit_log_char('<');
-            emit_log_char(cur_log_level + '0');
-            emit_log_char('>');
-            printed_len += 3;
-            /* coloring */
-            len = strlen(log_level_color[cur_log_level]);
-            for(uint32_t i = 0; i < len; ++i) {
-                emit_log_char(log_level_color[cur_log_level][i]);
-            }
-            printed_len += len;
-            /* timestamp */
-            if(_xlog.ops.get_timestamp) {
-                time_t utc = 0;
-                struct tm *ptm = NULL;
-                char time_str[30] = {0};
-                _xlog.ops.get_timestamp(&utc);
-                ptm = localtime(&utc);
-                strftime(time_str, sizeof(time_str), "[%Y-%m-%d %H:%M:%S]", ptm);
-                len = strlen(time_str);
-                for(uint32_t i = 0; i < len; ++i) {
-                    emit_log_char(time_str[i]);
-                }
-                printed_len += len;
-            }
-            if(!_xlog.hide_log_type) {
-                /* log type */
-                emit_log_char('<');
-                emit_log_char(log_level_char[cur_log_level]);
-                emit_log_char('>');
-                printed_len += 3;
-            }
-            next_text_line = false;
+        size = 0;
+        head_line = new_line;
+        if(((rec.flags & LOG_REC_BREAK) || lost) && !head_line) {
+            head[size++] = '\n';
+            head_line = true;
         }
-        emit_log_char(*p);
-        if(*p == '\n') {
-            next_text_line = true;
+        if(lost) {
+            size += _format_lost(&head[size], _lost_lines(lost));
         }
+        last = ts;
+        if(LOG_REC_PREFIXED(&rec)) {
+            size += _format_prefix(&head[size], &rec, &last);
+        }
+        if(n && (size + rec.len) > (len - n)) {
+            /* the record goes first next time */
+            break;
+        }
+        /* a record longer than buf is cut */
+        size = (size < len) ? size : len;
+        text = (rec.len < (len - size)) ? rec.len : (len - size);
+        if(!_reader_copy(&reader, 0, &buf[n + size], text)) {
+            continue;
+        }
+        memcpy(&buf[n], head, size);
+        n += size + text;
+        ts = last;
+        new_line = rec.len ? LOG_ENDS_LINE(buf[n - 1]) : head_line;
+        _reader_skip(&reader, &rec);
     }
-    if(_acquire_console()) {
-        _print_and_release_console();
-    }
+    *seq = reader.seq;
 
-    return printed_len;
+    return n;
 }
 
-uint32_t __attribute__((format(printf, 1, 0))) xlog(const char *fmt, ...)
+/* Both setters end up here. The console reads the functions once per segment,
+ * a batch gathered for the old print_v() is printed by the new functions.
+ */
+static void _set_output(xlog_print_func_t print, xlog_print_v_func_t print_v)
 {
-    va_list args;
-    uint32_t len = 0;
-
-    va_start(args, fmt);
-    len = _vprint(fmt, args);
-    va_end(args);
-
-    return len;
+    __atomic_store_n(&_xlog.ops.print, print, __ATOMIC_RELEASE);
+    __atomic_store_n(&_xlog.ops.print_v, print_v, __ATOMIC_RELEASE);
 }
 
 xlog_print_func_t xlog_set_print_func(xlog_print_func_t print)
 {
     xlog_print_func_t old_print = _xlog.ops.print;
 
-    _xlog.ops.print = print;
+    /* print_v() would take precedence, the new function replaces it */
+    _set_output(print, NULL);
 
     return old_print;
 }
 
+xlog_print_v_func_t xlog_set_print_v_func(xlog_print_v_func_t print_v)
+{
+    xlog_print_v_func_t old_print_v = _xlog.ops.print_v;
+
+    _set_output(_xlog.ops.print, print_v);
+
+    return old_print_v;
+}
+
 bool xlog_set_log_level(const char *level)
 {
     bool retval = false;
@@ -329,15 +4187,82 @@ void xlog_hide_log_type(bool hide)
 
 void xlog_init(xlog_ops_t *ops)
 {
+#ifdef CONFIG_XLOG_PERSIST
+    uint32_t restored = 0;
+
+#endif
+    log_first = 0;
     log_start = 0;
     log_end = 0;
+#ifdef CONFIG_XLOG_LOCKLESS
+    log_reserve = 0;
+    memset(log_marks, 0, sizeof(log_marks));
+    log_publishing = false;
+#else
+    log_commit = 0;
+#endif
+    log_seq = 0;
+    log_lost = 0;
+    console_new_line = true;
+    console_skip = false;
+    console_ts = 0;
+    memset(log_sinks, 0, sizeof(log_sinks));
+#ifndef CONFIG_XLOG_LOCKLESS
+    log_lost_front = 0;
+    log_printing = false;
+#endif
+    memset(&log_stats, 0, sizeof(log_stats));
     next_text_line = true;
+    cont_filtered = false;
+#if defined(CONFIG_XLOG_DEDUP) && !defined(CONFIG_XLOG_LOCKLESS)
+    log_last_line = false;
+    log_repeats = 0;
+#endif
+    memset(tag_levels, TAG_LEVEL_CONSOLE, sizeof(tag_levels));
+#ifndef CONFIG_XLOG_TIMESTAMP_MONOTONIC
+    memset(&time_cache, 0, sizeof(time_cache));
+#endif
+#ifdef CONFIG_XLOG_DEFERRED
+    deferred_head = 0;
+    deferred_tail = 0;
+    for(uint32_t i = 0; i < CONFIG_XLOG_DEFERRED_SLOTS; ++i) {
+        deferred_slots[i].seq = i;
+    }
+#endif
+#ifdef CONFIG_XLOG_ISR
+    memset(isr_rings, 0, sizeof(isr_rings));
+    for(uint32_t i = 0; i < CONFIG_XLOG_ISR_CORES; ++i) {
+        for(uint32_t j = 0; j < CONFIG_XLOG_ISR_SLOTS; ++j) {
+            isr_rings[i].slots[j].seq = j;
+        }
+    }
+    isr_order = 0;
+#endif
     _xlog.log_level.default_level = DEFAULT_MESSAGE_LOG_LEVEL;
     _xlog.log_level.console_level = DEFAULT_CONSOLE_LOG_LEVEL;
+    _xlog.log_level.sink_level = 0;
     _xlog.hide_log_type = true;
+#ifdef CONFIG_XLOG_ASYNC
+    _xlog.async.policy = CONFIG_XLOG_ASYNC_POLICY;
+    memset(&_xlog.async.stats, 0, sizeof(_xlog.async.stats));
+#endif
     if(ops) {
         _xlog.ops = *ops;
     }
+#ifdef CONFIG_XLOG_PERSIST
+    log_persist = &persist_region;
+    if(_xlog.ops.get_persist) {
+        log_persist = _xlog.ops.get_persist(sizeof(*log_persist));
+        log_persist = log_persist ? log_persist : &persist_region;
+    }
+    log_buf = log_persist->buf;
+    restored = _persist_restore();
+    if(restored) {
+        /* the records restored are printed first, making room for the line telling about them */
+        _drain_console();
+        xlog(LOG_WARN "xlog: %u records restored from the previous boot\n", restored);
+    }
+#endif
 }
 
 void xlog_deinit(void)
@@ -346,7 +4271,14 @@ void xlog_deinit(void)
     _xlog.ops.unlock = NULL;
     _xlog.ops.acquire_console = NULL;
     _xlog.ops.release_console = NULL;
+    _xlog.ops.suspend = NULL;
+    _xlog.ops.resume = NULL;
+    _xlog.ops.notify = NULL;
+    _xlog.ops.yield = NULL;
     _xlog.ops.print = NULL;
+    _xlog.ops.print_v = NULL;
+    _xlog.ops.core_id = NULL;
+    _xlog.ops.get_persist = NULL;
 }
 #else
 xlog_print_func_t xlog_set_print_func(xlog_print_func_t print)
@@ -356,6 +4288,13 @@ xlog_print_func_t xlog_set_print_func(xlog_print_func_t print)
     return print;
 }
 
+xlog_print_v_func_t xlog_set_print_v_func(xlog_print_v_func_t print_v)
+{
+    (void)print_v;
+
+    return print_v;
+}
+
 bool xlog_set_log_level(const char *level)
 {
     (void)level;
@@ -368,6 +4307,74 @@ void xlog_hide_log_type(bool hide)
     (void)hide;
 }
 
+bool xlog_set_tag_level(const char *tag, const char *level)
+{
+    (void)tag;
+    (void)level;
+
+    return true;
+}
+
+uint32_t xlog_process(void)
+{
+    return 0;
+}
+
+bool xlog_set_async_policy(xlog_async_policy_t policy)
+{
+    (void)policy;
+
+    return false;
+}
+
+void xlog_get_async_stats(xlog_async_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+void xlog_get_stats(xlog_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+int32_t xlog_add_sink(const xlog_sink_t *sink)
+{
+    (void)sink;
+
+    return -1;
+}
+
+bool xlog_remove_sink(int32_t id)
+{
+    (void)id;
+
+    return false;
+}
+
+bool xlog_set_sink_level(int32_t id, const char *level)
+{
+    (void)id;
+    (void)level;
+
+    return false;
+}
+
+uint32_t xlog_flush_sink(int32_t id)
+{
+    (void)id;
+
+    return 0;
+}
+
+uint32_t xlog_read(uint64_t *seq, char *buf, uint32_t len)
+{
+    (void)seq;
+    (void)buf;
+    (void)len;
+
+    return 0;
+}
+
 void xlog_init(xlog_ops_t *ops)
 {
     (void)ops;
@@ -378,3 +4385,96 @@ void xlog_deinit(void)
 }
 
 #endif
+
+#ifdef __linux__
+/* Write n segments, what a signal or a full pipe leaves unwritten is written
+ * again, vec is changed.
+ * Returns false on an error.
+ */
+static bool _writev_all(struct iovec *vec, uint32_t n)
+{
+    ssize_t written = 0;
+    uint32_t i = 0;
+    bool retval = true;
+
+    while(retval && i < n) {
+        written = writev(STDOUT_FILENO, &vec[i], n - i);
+        if(written < 0) {
+            retval = (errno == EINTR);
+            continue;
+        }
+        for(; i < n && (size_t)written >= vec[i].iov_len; ++i) {
+            written -= vec[i].iov_len;
+        }
+        if(i < n) {
+            vec[i].iov_base = (char *)vec[i].iov_base + written;
+            vec[i].iov_len -= written;
+        }
+    }
+
+    return retval;
+}
+
+void xlog_print_v(const xlog_iovec_t *iov, uint32_t count)
+{
+    struct iovec vec[CONFIG_XLOG_IOV_MAX];
+    uint32_t n = 0;
+    bool ok = true;
+
+    for(; ok && count; iov += n, count -= n) {
+        n = (count > CONFIG_XLOG_IOV_MAX) ? CONFIG_XLOG_IOV_MAX : count;
+        for(uint32_t i = 0; i < n; ++i) {
+            vec[i].iov_base = (void *)iov[i].base;
+            vec[i].iov_len = iov[i].len;
+        }
+        ok = _writev_all(vec, n);
+    }
+}
+#else
+static char print_v_buf[CONFIG_XLOG_PRINT_V_BUF_SIZE];  /*<< Segments gathered by xlog_print_v(), guarded by the console */
+
+void xlog_print_v(const xlog_iovec_t *iov, uint32_t count)
+{
+    uint32_t len = 0;
+
+    /* the segments are gathered and written with one call of the stdout driver,
+     * a segment which does not fit is written on its own
+     */
+    for(uint32_t i = 0; i < count; ++i) {
+        if((len + iov[i].len) > sizeof(print_v_buf) && len) {
+            fwrite(print_v_buf, 1, len, stdout);
+            len = 0;
+        }
+        if(iov[i].len > sizeof(print_v_buf)) {
+            fwrite(iov[i].base, 1, iov[i].len, stdout);
+        } else {
+            memcpy(&print_v_buf[len], iov[i].base, iov[i].len);
+            len += iov[i].len;
+        }
+    }
+    if(len) {
+        fwrite(print_v_buf, 1, len, stdout);
+    }
+    fflush(stdout);
+}
+#endif
+
+void *xlog_get_persist(uint32_t size)
+{
+    void *region = NULL;
+#ifdef __linux__
+    int fd = open(CONFIG_XLOG_PERSIST_FILE, O_RDWR | O_CREAT, 0644);
+
+    if(fd >= 0) {
+        if(ftruncate(fd, size) == 0) {
+            region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            region = (region == MAP_FAILED) ? NULL : region;
+        }
+        close(fd);
+    }
+#else
+    (void)size;
+#endif
+
+    return region;
+}
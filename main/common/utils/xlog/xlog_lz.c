@@ -0,0 +1,191 @@
+/**
+ * @file common/utils/xlog/xlog_lz.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_lz.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ */
+
+/*---------- includes ----------*/
+#include "xlog_lz.h"
+#include <string.h>
+
+/*---------- macro ----------*/
+#define LZ_WINDOW                           (1UL << CONFIG_XLOG_LZ_WINDOW_SHIFT)
+#define LZ_WINDOW_MASK                      (LZ_WINDOW - 1)
+#define LZ_MIN_MATCH                        (4)
+#define LZ_RUN_MAX                          (15)    /*<< count of a token extended by the bytes following */
+
+/*---------- type define ----------*/
+/*---------- variable prototype ----------*/
+/*---------- function prototype ----------*/
+/*---------- variable ----------*/
+/* Static dictionary the history of a stream starts with, what xlog puts out at
+ * the start of the lines goes last, as the nearest matches are found first.
+ * tools/xlog_lz.py holds a copy, they must be kept the same.
+ */
+static const char lz_dict[] =
+    " records restored from the previous boot\n"
+    " lines suppressed in ()\n"
+    "last message repeated  times\n"
+    " lines lost\n"
+    "xlog: "
+    "[2026-01-01 00:00:00]"
+    "\n\033[31;22m[    0.000000]"
+    "\n\033[32;22m[    0.000000]"
+    "\n\033[33;22m[    0.000000]"
+    "\n\033[37;22m[    0.000000]";
+
+/*---------- function ----------*/
+/* Get the char at position q of the stream, the chunk being compressed starts
+ * at base, what comes before it is in the history.
+ */
+static inline uint8_t _lz_byte(const xlog_lz_t *lz, const uint8_t *p, uint32_t base, uint32_t q)
+{
+    return ((int32_t)(q - base) < 0) ? lz->history[q & LZ_WINDOW_MASK] : p[q - base];
+}
+
+static inline uint32_t _lz_hash(const xlog_lz_t *lz, const uint8_t *p, uint32_t base, uint32_t q)
+{
+    uint32_t v = _lz_byte(lz, p, base, q) | ((uint32_t)_lz_byte(lz, p, base, q + 1) << 8) |
+                 ((uint32_t)_lz_byte(lz, p, base, q + 2) << 16) | ((uint32_t)_lz_byte(lz, p, base, q + 3) << 24);
+
+    return (uint32_t)(v * 2654435761UL) >> (32 - CONFIG_XLOG_LZ_HASH_SHIFT);
+}
+
+static inline void _lz_flush(xlog_lz_t *lz, xlog_print_func_t write)
+{
+    if(lz->out_len) {
+        write((const char *)lz->out, lz->out_len);
+        lz->out_len = 0;
+    }
+}
+
+static inline void _lz_put(xlog_lz_t *lz, uint8_t c, xlog_print_func_t write)
+{
+    if(lz->out_len == sizeof(lz->out)) {
+        _lz_flush(lz, write);
+    }
+    lz->out[lz->out_len++] = c;
+}
+
+/* Put the part of a count a token can not hold.
+ */
+static void _lz_put_run(xlog_lz_t *lz, uint32_t n, xlog_print_func_t write)
+{
+    for(; n >= 255; n -= 255) {
+        _lz_put(lz, 255, write);
+    }
+    _lz_put(lz, (uint8_t)n, write);
+}
+
+/* Put a sequence: the literals and the match following them, if any.
+ */
+static void _lz_sequence(xlog_lz_t *lz, const uint8_t *lit, uint32_t nlit, uint32_t dist, uint32_t mlen,
+                         xlog_print_func_t write)
+{
+    uint32_t m = mlen ? (mlen - LZ_MIN_MATCH) : 0, n = 0;
+
+    _lz_put(lz, (uint8_t)(((nlit < LZ_RUN_MAX) ? nlit : LZ_RUN_MAX) << 4 | ((m < LZ_RUN_MAX) ? m : LZ_RUN_MAX)), write);
+    if(nlit >= LZ_RUN_MAX) {
+        _lz_put_run(lz, nlit - LZ_RUN_MAX, write);
+    }
+    for(; nlit; lit += n, nlit -= n) {
+        if(lz->out_len == sizeof(lz->out)) {
+            _lz_flush(lz, write);
+        }
+        n = sizeof(lz->out) - lz->out_len;
+        n = (n < nlit) ? n : nlit;
+        memcpy(&lz->out[lz->out_len], lit, n);
+        lz->out_len += n;
+    }
+    _lz_put(lz, (uint8_t)dist, write);
+    _lz_put(lz, (uint8_t)(dist >> 8), write);
+    if(mlen && m >= LZ_RUN_MAX) {
+        _lz_put_run(lz, m - LZ_RUN_MAX, write);
+    }
+}
+
+/* Append a chunk to the history, only its last LZ_WINDOW chars are kept.
+ */
+static void _lz_history(xlog_lz_t *lz, const uint8_t *p, uint32_t len)
+{
+    uint32_t n = 0, off = 0;
+
+    if(len > LZ_WINDOW) {
+        p += len - LZ_WINDOW;
+        lz->pos += len - LZ_WINDOW;
+        len = LZ_WINDOW;
+    }
+    for(; len; p += n, len -= n) {
+        off = lz->pos & LZ_WINDOW_MASK;
+        n = LZ_WINDOW - off;
+        n = (n < len) ? n : len;
+        memcpy(&lz->history[off], p, n);
+        lz->pos += n;
+    }
+}
+
+void xlog_lz_reset(xlog_lz_t *lz)
+{
+    lz->pos = 0;
+    lz->hashed = 0;
+    lz->out_len = 0;
+    memset(lz->hash, 0, sizeof(lz->hash));
+    _lz_history(lz, (const uint8_t *)lz_dict, sizeof(lz_dict) - 1);
+    for(; (lz->hashed + LZ_MIN_MATCH) <= lz->pos; lz->hashed++) {
+        lz->hash[_lz_hash(lz, NULL, lz->pos, lz->hashed)] = (uint16_t)lz->hashed;
+    }
+}
+
+void xlog_lz_write(xlog_lz_t *lz, const char *s, uint32_t len, xlog_print_func_t write)
+{
+    const uint8_t *p = (const uint8_t *)s;
+    uint32_t base = lz->pos, end = lz->pos + len, cur = lz->pos, anchor = lz->pos;
+    uint32_t h = 0, dist = 0, mlen = 0;
+
+    while((cur + LZ_MIN_MATCH) <= end) {
+        /* the positions passed by a match, and the last ones of the chunk before */
+        for(; lz->hashed < cur; lz->hashed++) {
+            lz->hash[_lz_hash(lz, p, base, lz->hashed)] = (uint16_t)lz->hashed;
+        }
+        h = _lz_hash(lz, p, base, cur);
+        /* a stale position only finds chars which do not match */
+        dist = (uint16_t)(cur - lz->hash[h]);
+        lz->hash[h] = (uint16_t)cur;
+        lz->hashed = cur + 1;
+        mlen = 0;
+        if(dist && dist < LZ_WINDOW) {
+            while((cur + mlen) < end && _lz_byte(lz, p, base, cur - dist + mlen) == p[cur + mlen - base]) {
+                mlen++;
+            }
+        }
+        if(mlen < LZ_MIN_MATCH) {
+            cur++;
+            continue;
+        }
+        _lz_sequence(lz, &p[anchor - base], cur - anchor, dist, mlen, write);
+        cur += mlen;
+        anchor = cur;
+    }
+    if(anchor != end) {
+        _lz_sequence(lz, &p[anchor - base], end - anchor, 0, 0, write);
+    }
+    _lz_history(lz, p, len);
+    _lz_flush(lz, write);
+}
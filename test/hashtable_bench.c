@@ -0,0 +1,178 @@
+/**
+ * @file test/hashtable_bench.c
+ *
+ * Copyright (C) 2022
+ *
+ * hashtable_bench.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Adds to a growing table, with the incremental resize and with the whole
+ * rehash done at once: the mean add and the worst single add, each the
+ * best of a few runs. Then lookups by name and by integer key, against a
+ * walk of a list, for a few table sizes.
+ *
+ * Usage: hashtable_bench [runs]
+ */
+
+/*---------- includes ----------*/
+#include <string.h>
+#include "test.h"
+#include "hashtable.h"
+
+/*---------- macro ----------*/
+#define ENTRIES                             (1UL << 16)
+
+/*---------- type define ----------*/
+struct entry {
+    uint32_t key;
+    struct hash_node node;
+    struct list_head list;
+    char name[16];
+};
+
+/*---------- variable ----------*/
+static struct entry entries[ENTRIES];
+/* the bucket arrays of every size, so that no allocation is timed */
+static struct hlist_head pool[18][1UL << 17];
+
+/*---------- function ----------*/
+static bool match_key(const struct hash_node *node, const void *key)
+{
+    return container_of(node, struct entry, node)->key == *(const uint32_t *)key;
+}
+
+static bool match_name(const struct hash_node *node, const void *key)
+{
+    return !strcmp(container_of(node, struct entry, node)->name, key);
+}
+
+static void bench_adds(bool rehash, int runs)
+{
+    struct hash_table tbl;
+    double worst = 0, best = 1e9, mean = 1e9, t = 0, start = 0;
+
+    for(int run = 0; run < runs; ++run) {
+        worst = 0;
+        hash_table_init(&tbl, pool[1], 1, NULL);
+        start = test_now();
+        for(uint32_t i = 0; i < ENTRIES; ++i) {
+            t = test_now();
+            if(hash_table_grow_needed(&tbl)) {
+                hash_table_resize(&tbl, pool[tbl.shift + 1], tbl.shift + 1);
+                if(rehash) {
+                    hash_table_move(&tbl, UINT32_MAX);
+                }
+            }
+            hash_table_add(&tbl, &entries[i].node, entries[i].key);
+            t = test_now() - t;
+            worst = (t > worst) ? t : worst;
+        }
+        t = (test_now() - start) / ENTRIES;
+        mean = (t < mean) ? t : mean;
+        best = (worst < best) ? worst : best;
+    }
+    printf("%-12s: %lu adds, mean %.1f ns, worst add %.0f ns\n", rehash ? "whole rehash" : "incremental",
+           ENTRIES, mean * 1e9, best * 1e9);
+}
+
+static void bench_finds(uint32_t n)
+{
+    struct hash_table tbl;
+    struct entry *pos = NULL;
+    volatile uintptr_t sink = 0;
+    unsigned long rounds = 20000000UL / n;
+    double hash = 0, list = 0;
+    uint32_t key = 0;
+    LIST_HEAD(head);
+
+    hash_table_init(&tbl, pool[1], 1, NULL);
+    for(uint32_t i = 0; i < n; ++i) {
+        if(hash_table_grow_needed(&tbl)) {
+            hash_table_resize(&tbl, pool[tbl.shift + 1], tbl.shift + 1);
+        }
+        hash_table_add(&tbl, &entries[i].node, hash_str(entries[i].name));
+        list_add_tail(&entries[i].list, &head);
+    }
+    hash_table_move(&tbl, UINT32_MAX);
+    hash = test_now();
+    for(unsigned long r = 0; r < rounds; ++r) {
+        sink += (uintptr_t)hash_table_find(&tbl, hash_str(entries[r % n].name), match_name, entries[r % n].name);
+    }
+    hash = test_now() - hash;
+    list = test_now();
+    for(unsigned long r = 0; r < rounds; ++r) {
+        list_for_each_entry(pos, struct entry, &head, list) {
+            if(!strcmp(pos->name, entries[r % n].name)) {
+                break;
+            }
+        }
+        sink += (uintptr_t)pos;
+    }
+    list = test_now() - list;
+    printf("%5u names: hash %6.1f ns, list %8.1f ns, x%.1f\n", n, hash * 1e9 / rounds, list * 1e9 / rounds,
+           list / hash);
+    /* integer keys hash to themselves */
+    hash_table_init(&tbl, pool[1], 1, NULL);
+    for(uint32_t i = 0; i < n; ++i) {
+        if(hash_table_grow_needed(&tbl)) {
+            hash_table_resize(&tbl, pool[tbl.shift + 1], tbl.shift + 1);
+        }
+        hash_table_add(&tbl, &entries[i].node, entries[i].key);
+    }
+    hash_table_move(&tbl, UINT32_MAX);
+    hash = test_now();
+    for(unsigned long r = 0; r < rounds; ++r) {
+        key = entries[r % n].key;
+        sink += (uintptr_t)hash_table_find(&tbl, key, match_key, &key);
+    }
+    hash = test_now() - hash;
+    list = test_now();
+    for(unsigned long r = 0; r < rounds; ++r) {
+        key = entries[r % n].key;
+        list_for_each_entry(pos, struct entry, &head, list) {
+            if(pos->key == key) {
+                break;
+            }
+        }
+        sink += (uintptr_t)pos;
+    }
+    list = test_now() - list;
+    printf("%5u keys : hash %6.1f ns, list %8.1f ns, x%.1f\n", n, hash * 1e9 / rounds, list * 1e9 / rounds,
+           list / hash);
+}
+
+int main(int argc, char *argv[])
+{
+    static const uint32_t sizes[] = {10, 100, 1000};
+    int runs = 20;
+
+    if(argc > 1) {
+        runs = atoi(argv[1]);
+    }
+    for(uint32_t i = 0; i < ENTRIES; ++i) {
+        entries[i].key = i * 7919UL;
+        snprintf(entries[i].name, sizeof(entries[i].name), "attr%u", i);
+    }
+    printf("hashtable_bench:\n");
+    bench_adds(false, runs);
+    bench_adds(true, runs);
+    for(uint32_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        bench_finds(sizes[i]);
+    }
+
+    return 0;
+}
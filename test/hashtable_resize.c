@@ -0,0 +1,159 @@
+/**
+ * @file test/hashtable_resize.c
+ *
+ * Copyright (C) 2022
+ *
+ * hashtable_resize.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Random adds, dels and finds against a shadow array, while the table
+ * grows as hash_table_grow_needed() tells and is resized to random sizes,
+ * smaller or bigger, into bucket arrays filled with garbage. After each
+ * resize every key is looked up while the old buckets are still being
+ * moved. Some keys share a hash, so that a bucket holds nodes of the same
+ * hash with other keys. Every old array must be released once.
+ *
+ * Usage: hashtable_resize [seed] [operations]
+ */
+
+/*---------- includes ----------*/
+#include <string.h>
+#include "test.h"
+#include "hashtable.h"
+
+/*---------- macro ----------*/
+#define ENTRIES                             (20000)
+#define SHARED_HASH                         (0x12345678UL)
+
+/*---------- type define ----------*/
+struct entry {
+    uint32_t key;
+    struct hash_node node;
+};
+
+/*---------- variable ----------*/
+static struct entry entries[ENTRIES];
+static bool in_table[ENTRIES];
+static unsigned long allocated, released;
+
+/*---------- function ----------*/
+static bool match(const struct hash_node *node, const void *key)
+{
+    return container_of(node, struct entry, node)->key == *(const uint32_t *)key;
+}
+
+static void release(struct hlist_head *buckets)
+{
+    released++;
+    free(buckets);
+}
+
+/* A bucket array of garbage, hash_table_resize() must not need it cleared.
+ */
+static struct hlist_head *buckets_alloc(uint32_t shift)
+{
+    struct hlist_head *buckets = malloc(sizeof(*buckets) * HASH_TABLE_BUCKETS(shift));
+
+    TEST_ASSERT(buckets);
+    memset(buckets, 0xAB, sizeof(*buckets) * HASH_TABLE_BUCKETS(shift));
+    allocated++;
+
+    return buckets;
+}
+
+static uint32_t entry_hash(uint32_t i)
+{
+    return (i % 97) ? hash_mem(&entries[i].key, sizeof(entries[i].key)) : SHARED_HASH;
+}
+
+/* Look the entry up, it must be found if and only if it is in the table.
+ */
+static void check_find(struct hash_table *tbl, uint32_t i)
+{
+    struct hash_node *node = hash_table_find(tbl, entry_hash(i), match, &entries[i].key);
+
+    TEST_ASSERT(in_table[i] ? (node == &entries[i].node) : (node == NULL));
+}
+
+int main(int argc, char *argv[])
+{
+    struct hash_table tbl;
+    unsigned long ops = 2000000, resizes = 0, finds_resizing = 0, sweeps = 0;
+    uint32_t count = 0, i = 0, shift = 0;
+
+    srand(argc > 1 ? atoi(argv[1]) : 1);
+    if(argc > 2) {
+        ops = strtoul(argv[2], NULL, 0);
+    }
+    for(i = 0; i < ENTRIES; ++i) {
+        entries[i].key = i * 7919UL;
+    }
+    hash_table_init(&tbl, buckets_alloc(1), 1, release);
+    for(unsigned long n = 0; n < ops; ++n) {
+        i = rand() % ENTRIES;
+        if(rand() % 5000 == 0) {
+            /* any size, the resize in progress is finished first */
+            shift = rand() % 16;
+            hash_table_resize(&tbl, buckets_alloc(shift), shift);
+            resizes++;
+            if(tbl.old) {
+                for(uint32_t k = 0; k < ENTRIES; ++k) {
+                    check_find(&tbl, k);
+                }
+                sweeps++;
+            }
+        }
+        switch(rand() % 3) {
+            case 0:
+                if(!in_table[i]) {
+                    if(hash_table_grow_needed(&tbl)) {
+                        hash_table_resize(&tbl, buckets_alloc(tbl.shift + 1), tbl.shift + 1);
+                        resizes++;
+                    }
+                    hash_table_add(&tbl, &entries[i].node, entry_hash(i));
+                    in_table[i] = true;
+                    count++;
+                }
+                break;
+            case 1:
+                if(in_table[i]) {
+                    hash_table_del(&tbl, &entries[i].node);
+                    in_table[i] = false;
+                    count--;
+                }
+                break;
+            default:
+                finds_resizing += tbl.old ? 1 : 0;
+                check_find(&tbl, i);
+                break;
+        }
+        TEST_ASSERT(hash_table_count(&tbl) == count);
+    }
+    /* the resize in progress, if any, is finished when idle */
+    while(!hash_table_move(&tbl, 1)) {
+    }
+    for(i = 0; i < ENTRIES; ++i) {
+        check_find(&tbl, i);
+    }
+    printf("hashtable_resize: %lu operations, %lu resizes, %lu finds while resizing, %lu sweeps, "
+           "%u entries in 2^%u buckets\n", ops, resizes, finds_resizing, sweeps, count, tbl.shift);
+    TEST_ASSERT(finds_resizing && sweeps);
+    TEST_ASSERT(released == allocated - 1);
+    free(tbl.buckets);
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file test/list_sort_bench.c
+ *
+ * Copyright (C) 2022
+ *
+ * list_sort_bench.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Sorting a list of 10k nodes, random, sorted and reversed: list_sort(),
+ * an insertion sort moving the nodes with list_move(), and copying the
+ * nodes into an array for qsort() before linking them again. The best of
+ * a few runs, and the compares list_sort() took.
+ *
+ * Usage: list_sort_bench [runs]
+ */
+
+/*---------- includes ----------*/
+#include "test.h"
+#include "lists.h"
+
+/*---------- macro ----------*/
+#define ENTRIES                             (10000)
+
+/*---------- type define ----------*/
+struct entry {
+    int key;
+    int seq;
+    struct list_head list;
+};
+
+/*---------- variable ----------*/
+static struct entry entries[ENTRIES];
+static struct entry *array[ENTRIES];
+
+/*---------- function ----------*/
+static int cmp(void *priv, const struct list_head *a, const struct list_head *b)
+{
+    (*(unsigned long *)priv)++;
+
+    return list_entry(a, struct entry, list)->key - list_entry(b, struct entry, list)->key;
+}
+
+static int cmp_array(const void *a, const void *b)
+{
+    const struct entry *x = *(struct entry *const *)a, *y = *(struct entry *const *)b;
+
+    /* qsort() is not stable, the position makes it so */
+    return (x->key != y->key) ? (x->key - y->key) : (x->seq - y->seq);
+}
+
+static void fill(struct list_head *head, int kind)
+{
+    INIT_LIST_HEAD(head);
+    for(int i = 0; i < ENTRIES; ++i) {
+        entries[i].key = (kind == 0) ? rand() : (kind == 1) ? i : (ENTRIES - i);
+        entries[i].seq = i;
+        list_add_tail(&entries[i].list, head);
+    }
+}
+
+static void insertion_sort(struct list_head *head)
+{
+    struct list_head *pos = NULL, *n = NULL, *at = NULL;
+    LIST_HEAD(sorted);
+
+    list_for_each_safe(pos, n, head) {
+        list_for_each_prev(at, &sorted) {
+            if(list_entry(at, struct entry, list)->key <= list_entry(pos, struct entry, list)->key) {
+                break;
+            }
+        }
+        list_move(pos, at);
+    }
+    list_splice(&sorted, head);
+}
+
+static void array_sort(struct list_head *head)
+{
+    struct list_head *pos = NULL;
+    int n = 0;
+
+    list_for_each(pos, head) {
+        array[n++] = list_entry(pos, struct entry, list);
+    }
+    qsort(array, n, sizeof(array[0]), cmp_array);
+    INIT_LIST_HEAD(head);
+    for(int i = 0; i < n; ++i) {
+        list_add_tail(&array[i]->list, head);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *const kinds[] = {"random", "sorted", "reversed"};
+    double best[3], t = 0;
+    unsigned long compares = 0;
+    int runs = 3;
+    LIST_HEAD(head);
+
+    if(argc > 1) {
+        runs = atoi(argv[1]);
+    }
+    srand(1);
+    printf("list_sort_bench: %d nodes\n", ENTRIES);
+    for(int kind = 0; kind < 3; ++kind) {
+        best[0] = best[1] = best[2] = 1e9;
+        for(int run = 0; run < runs; ++run) {
+            fill(&head, kind);
+            compares = 0;
+            t = test_now();
+            list_sort(&compares, &head, cmp);
+            t = test_now() - t;
+            best[0] = (t < best[0]) ? t : best[0];
+            fill(&head, kind);
+            t = test_now();
+            insertion_sort(&head);
+            t = test_now() - t;
+            best[1] = (t < best[1]) ? t : best[1];
+            fill(&head, kind);
+            t = test_now();
+            array_sort(&head);
+            t = test_now() - t;
+            best[2] = (t < best[2]) ? t : best[2];
+        }
+        printf("%-8s: list_sort %7.0f us (%lu compares), insertion %8.0f us, array and qsort %6.0f us\n",
+               kinds[kind], best[0] * 1e6, compares, best[1] * 1e6, best[2] * 1e6);
+    }
+
+    return 0;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file test/list_sort_stable.c
+ *
+ * Copyright (C) 2022
+ *
+ * list_sort_stable.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * list_sort() of lists of every length up to a few hundred, then of random
+ * lengths, with keys from a random range so that they repeat more or less.
+ * The sorted list must be ordered by key, the entries of a key must keep
+ * the order they had, and the prev links and the tail must be rebuilt.
+ *
+ * Usage: list_sort_stable [seed] [lists]
+ */
+
+/*---------- includes ----------*/
+#include "test.h"
+#include "lists.h"
+
+/*---------- macro ----------*/
+#define ENTRIES                             (3000)
+
+/*---------- type define ----------*/
+struct entry {
+    int key;
+    int seq;                                        /*<< position before the sort */
+    struct list_head list;
+};
+
+/*---------- variable ----------*/
+static struct entry entries[ENTRIES];
+
+/*---------- function ----------*/
+static int cmp(void *priv, const struct list_head *a, const struct list_head *b)
+{
+    (*(unsigned long *)priv)++;
+
+    return list_entry(a, struct entry, list)->key - list_entry(b, struct entry, list)->key;
+}
+
+static void check_sorted(const struct list_head *head, int n)
+{
+    const struct list_head *pos = NULL, *prev = head;
+    const struct entry *a = NULL, *b = NULL;
+    int count = 0;
+
+    list_for_each(pos, head) {
+        TEST_ASSERT(pos->prev == prev);
+        if(prev != head) {
+            a = list_entry(prev, struct entry, list);
+            b = list_entry(pos, struct entry, list);
+            TEST_ASSERT(a->key < b->key || (a->key == b->key && a->seq < b->seq));
+        }
+        prev = pos;
+        count++;
+    }
+    TEST_ASSERT(count == n);
+    TEST_ASSERT(head->prev == prev);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long lists = 5000, compares = 0;
+    int n = 0, range = 0;
+
+    srand(argc > 1 ? atoi(argv[1]) : 1);
+    if(argc > 2) {
+        lists = strtoul(argv[2], NULL, 0);
+    }
+    for(unsigned long k = 0; k < lists; ++k) {
+        LIST_HEAD(head);
+
+        n = (k < 300) ? (int)k : rand() % ENTRIES;
+        range = 1 + rand() % (n + 1);
+        for(int i = 0; i < n; ++i) {
+            entries[i].key = rand() % range;
+            entries[i].seq = i;
+            list_add_tail(&entries[i].list, &head);
+        }
+        list_sort(&compares, &head, cmp);
+        check_sorted(&head, n);
+    }
+    printf("list_sort_stable: %lu lists sorted, %lu compares\n", lists, compares);
+
+    return 0;
+}
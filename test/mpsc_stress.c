@@ -0,0 +1,266 @@
+/**
+ * @file test/mpsc_stress.c
+ *
+ * Copyright (C) 2022
+ *
+ * mpsc_stress.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Producer threads push numbered entries while one consumer pops them.
+ * A timer interrupts the first producer with a signal, whose handler
+ * pushes entries of its own, the way an ISR would in the middle of a
+ * push, and lets the consumer run before it returns. Every entry must be
+ * popped once, those of a producer in the order they were pushed. Then
+ * the same without the timer, timed against a list guarded by a mutex.
+ *
+ * Usage: mpsc_stress [producers] [entries per producer]
+ */
+
+/*---------- includes ----------*/
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include "test.h"
+#include "mpsc.h"
+#include "lists.h"
+
+/*---------- macro ----------*/
+#define PRODUCER_MAX                        (16)
+#define SIGNALED_MAX                        (100000)
+#define TIMER_PERIOD_NS                     (20000)
+#define STALL_TIMEOUT                       (10.0)
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id              _sigev_un._tid
+#endif
+
+/*---------- type define ----------*/
+struct entry {
+    uint32_t producer;
+    uint32_t seq;
+    struct mpsc_node node;
+    struct list_head list;
+};
+
+/*---------- variable ----------*/
+static struct mpsc_queue queue;
+static pthread_mutex_t list_mutex = PTHREAD_MUTEX_INITIALIZER;
+static LIST_HEAD(list);
+static pthread_t threads[PRODUCER_MAX];
+/* the entries of each producer, those pushed by the signal handler last */
+static struct entry *entries[PRODUCER_MAX + 1];
+static unsigned long per_producer = 1000000;
+static uint32_t signaled;                           /*<< entries pushed by the signal handler */
+static bool interrupt;
+
+/*---------- function ----------*/
+/* Only the first producer gets the signal, one at a time.
+ */
+static void on_signal(int sig)
+{
+    struct entry *e = NULL;
+
+    if(signaled < SIGNALED_MAX) {
+        e = &entries[PRODUCER_MAX][signaled];
+        e->producer = PRODUCER_MAX;
+        e->seq = signaled;
+        __atomic_store_n(&signaled, signaled + 1, __ATOMIC_RELEASE);
+        mpsc_push(&queue, &e->node);
+        /* the push it interrupted may not be done */
+        sched_yield();
+    }
+}
+
+static void *producer(void *arg)
+{
+    uint32_t id = (uint32_t)(long)arg;
+    struct itimerspec period = {
+        .it_interval = {.tv_nsec = TIMER_PERIOD_NS},
+        .it_value = {.tv_nsec = TIMER_PERIOD_NS},
+    };
+    struct sigevent sev;
+    struct entry *e = NULL;
+    timer_t timer;
+
+    if(!id && interrupt) {
+        memset(&sev, 0, sizeof(sev));
+        sev.sigev_notify = SIGEV_THREAD_ID;
+        sev.sigev_signo = SIGUSR1;
+        sev.sigev_notify_thread_id = gettid();
+        TEST_ASSERT(!timer_create(CLOCK_MONOTONIC, &sev, &timer));
+        TEST_ASSERT(!timer_settime(timer, 0, &period, NULL));
+    }
+    for(uint32_t i = 0; i < per_producer; ++i) {
+        e = &entries[id][i];
+        e->producer = id;
+        e->seq = i;
+        mpsc_push(&queue, &e->node);
+        if(id && !(i & 1023)) {
+            /* let the others push in between on a single core, the first
+             * one is only preempted, so that the signal may come anywhere
+             */
+            sched_yield();
+        }
+    }
+    if(!id && interrupt) {
+        timer_delete(timer);
+    }
+
+    return NULL;
+}
+
+static void *producer_list(void *arg)
+{
+    uint32_t id = (uint32_t)(long)arg;
+
+    for(uint32_t i = 0; i < per_producer; ++i) {
+        pthread_mutex_lock(&list_mutex);
+        list_add_tail(&entries[id][i].list, &list);
+        pthread_mutex_unlock(&list_mutex);
+        if(id && !(i & 1023)) {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+/* Pop every entry of the producers, and those the signal handler pushed.
+ * Returns the time it took.
+ */
+static double run_mpsc(int producers)
+{
+    uint32_t next[PRODUCER_MAX + 1] = {0};
+    unsigned long popped = 0, total = producers * per_producer, idle = 0;
+    struct mpsc_node *node = NULL;
+    struct entry *e = NULL;
+    double t = 0, progress = 0;
+    bool joined = false;
+
+    mpsc_init(&queue);
+    signaled = 0;
+    t = progress = test_now();
+    for(long i = 0; i < producers; ++i) {
+        TEST_ASSERT(!pthread_create(&threads[i], NULL, producer, (void *)i));
+    }
+    /* the signal may still come until the first producer is joined */
+    while(!joined || next[PRODUCER_MAX] < signaled) {
+        if(popped == total && !joined) {
+            t = test_now() - t;
+            for(int i = 0; i < producers; ++i) {
+                pthread_join(threads[i], NULL);
+            }
+            joined = true;
+            continue;
+        }
+        node = mpsc_pop(&queue);
+        if(!node) {
+            /* a push is not done or nothing is pushed yet, unless an entry is lost */
+            if(!(++idle & 1023)) {
+                TEST_ASSERT(test_now() - progress < STALL_TIMEOUT);
+            }
+            sched_yield();
+            continue;
+        }
+        if(idle) {
+            idle = 0;
+            progress = test_now();
+        }
+        e = mpsc_entry(node, struct entry, node);
+        TEST_ASSERT(e->seq == next[e->producer]);
+        next[e->producer]++;
+        popped += (e->producer != PRODUCER_MAX);
+    }
+    for(int i = 0; i < producers; ++i) {
+        TEST_ASSERT(next[i] == per_producer);
+    }
+    TEST_ASSERT(next[PRODUCER_MAX] == signaled);
+    TEST_ASSERT(mpsc_empty(&queue) && !mpsc_pop(&queue));
+
+    return t;
+}
+
+static double run_list(int producers)
+{
+    unsigned long popped = 0, total = producers * per_producer;
+    bool got = false;
+    double t = test_now();
+
+    for(long i = 0; i < producers; ++i) {
+        TEST_ASSERT(!pthread_create(&threads[i], NULL, producer_list, (void *)i));
+    }
+    while(popped < total) {
+        pthread_mutex_lock(&list_mutex);
+        got = !list_empty(&list);
+        if(got) {
+            list_del(list.next);
+            popped++;
+        }
+        pthread_mutex_unlock(&list_mutex);
+        if(!got) {
+            sched_yield();
+        }
+    }
+    t = test_now() - t;
+    for(int i = 0; i < producers; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    return t;
+}
+
+int main(int argc, char *argv[])
+{
+    struct sigaction sa;
+    uint32_t isr = 0;
+    double mpsc = 0, list = 0, total = 0;
+    int producers = 4;
+
+    if(argc > 1) {
+        producers = atoi(argv[1]);
+    }
+    if(argc > 2) {
+        per_producer = strtoul(argv[2], NULL, 0);
+    }
+    TEST_ASSERT(producers > 0 && producers <= PRODUCER_MAX);
+    for(int i = 0; i < producers; ++i) {
+        entries[i] = calloc(per_producer, sizeof(struct entry));
+        TEST_ASSERT(entries[i]);
+    }
+    entries[PRODUCER_MAX] = calloc(SIGNALED_MAX, sizeof(struct entry));
+    TEST_ASSERT(entries[PRODUCER_MAX]);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &sa, NULL);
+    interrupt = true;
+    run_mpsc(producers);
+    isr = signaled;
+    /* timed without the timer, the signals cost more than the pushes */
+    interrupt = false;
+    mpsc = run_mpsc(producers);
+    list = run_list(producers);
+    total = (double)producers * per_producer;
+    printf("mpsc_stress: %d producers, %.0f entries and %u from a signal handler popped in order, "
+           "mpsc %.1f Mops/s, mutex and list %.1f Mops/s\n", producers, total, isr, total / mpsc / 1e6,
+           total / list / 1e6);
+
+    return 0;
+}
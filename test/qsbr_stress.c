@@ -0,0 +1,271 @@
+/**
+ * @file test/qsbr_stress.c
+ *
+ * Copyright (C) 2022
+ *
+ * qsbr_stress.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Readers walk a list and the buckets of an hlist with the _rcu macros,
+ * and go through a quiescent state after each pass, sometimes offline
+ * for a while. Writers add, delete and replace entries under their lock.
+ * One of them frees what it deleted after qsbr_synchronize(), the other
+ * one retires it with qsbr_start() and frees it once qsbr_poll() tells
+ * the grace period is over. A freed entry is poisoned first: a reader
+ * must never see it, and the list and the hlist must hold the same
+ * entries at the end.
+ *
+ * Usage: qsbr_stress [seconds]
+ */
+
+/*---------- includes ----------*/
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include "test.h"
+/* the host options have no __delay_ms(), do not spin on a single core */
+#define CONFIG_QSBR_WAIT()                  sched_yield()
+#include "qsbr.h"
+
+/*---------- macro ----------*/
+#define READERS                             (4)
+#define WRITERS                             (2)
+#define BUCKETS                             (16)
+#define LIVE                                (0x600DF00Du)
+#define DEAD                                (0xDEADDEADu)
+
+/*---------- type define ----------*/
+struct entry {
+    uint32_t magic;
+    uint32_t key;
+    uint32_t gp;                                    /*<< grace period it was retired in */
+    struct list_head list;
+    struct hlist_node hnode;
+    struct list_head retired;
+};
+
+/*---------- variable ----------*/
+static LIST_HEAD(entries);
+static struct hlist_head buckets[BUCKETS];
+static struct qsbr domain;
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool stop;
+static unsigned long walks, frees, grace_periods, polls;
+
+/*---------- function ----------*/
+static void check_live(const struct entry *e)
+{
+    TEST_ASSERT(__atomic_load_n(&e->magic, __ATOMIC_RELAXED) == LIVE);
+}
+
+static void *reader(void *arg)
+{
+    unsigned int seed = (unsigned int)(long)arg;
+    struct qsbr_reader r;
+    struct entry *pos = NULL;
+    unsigned long n = 0;
+
+    pthread_mutex_lock(&writer_lock);
+    qsbr_register(&domain, &r);
+    pthread_mutex_unlock(&writer_lock);
+    qsbr_online(&domain, &r);
+    while(!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+        list_for_each_entry_rcu(pos, struct entry, &entries, list) {
+            check_live(pos);
+        }
+        list_for_each_entry_rcu(pos, struct entry, &entries, list) {
+            check_live(pos);
+            sched_yield();
+        }
+        hlist_for_each_entry_rcu(pos, struct entry, &buckets[rand_r(&seed) % BUCKETS], hnode) {
+            check_live(pos);
+        }
+        n++;
+        qsbr_quiescent(&domain, &r);
+        if(rand_r(&seed) % 1000 == 0) {
+            qsbr_offline(&r);
+            usleep(100);
+            qsbr_online(&domain, &r);
+        }
+    }
+    qsbr_offline(&r);
+    pthread_mutex_lock(&writer_lock);
+    qsbr_unregister(&r);
+    walks += n;
+    pthread_mutex_unlock(&writer_lock);
+
+    return NULL;
+}
+
+static void release(struct entry *e)
+{
+    e->magic = DEAD;
+    e->list.next = NULL;
+    e->hnode.next = NULL;
+    free(e);
+    frees++;
+}
+
+static struct entry *entry_new(uint32_t key)
+{
+    struct entry *e = malloc(sizeof(*e));
+
+    TEST_ASSERT(e);
+    e->magic = LIVE;
+    e->key = key;
+
+    return e;
+}
+
+/* Add, delete or replace an entry, returns the entry taken out of the
+ * lists, if any.
+ */
+static struct entry *update(unsigned int *seed)
+{
+    struct entry *e = NULL, *victim = NULL;
+    struct list_head *pos = entries.next;
+    int op = rand_r(seed) % 3, k = rand_r(seed) % 8;
+
+    if(op == 0 || list_empty(&entries)) {
+        e = entry_new(rand_r(seed));
+        if(rand_r(seed) & 1) {
+            list_add_rcu(&e->list, &entries);
+        } else {
+            list_add_tail_rcu(&e->list, &entries);
+        }
+        hlist_add_head_rcu(&e->hnode, &buckets[e->key % BUCKETS]);
+    } else {
+        while(k-- && pos->next != &entries) {
+            pos = pos->next;
+        }
+        victim = list_entry(pos, struct entry, list);
+        hlist_del_rcu(&victim->hnode);
+        if(op == 1) {
+            list_del_rcu(&victim->list);
+        } else {
+            e = entry_new(victim->key);
+            list_replace_rcu(&victim->list, &e->list);
+            hlist_add_head_rcu(&e->hnode, &buckets[e->key % BUCKETS]);
+        }
+    }
+
+    return victim;
+}
+
+static void *writer_sync(void *arg)
+{
+    unsigned int seed = (unsigned int)(long)arg;
+    struct entry *victim = NULL;
+
+    while(!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+        pthread_mutex_lock(&writer_lock);
+        victim = update(&seed);
+        if(victim) {
+            qsbr_synchronize(&domain);
+            grace_periods++;
+            release(victim);
+        }
+        pthread_mutex_unlock(&writer_lock);
+    }
+
+    return NULL;
+}
+
+/* Free the retired entries whose grace period is over, they are in the
+ * order they were retired.
+ */
+static void reclaim(struct list_head *retired)
+{
+    struct entry *e = NULL, *n = NULL;
+
+    list_for_each_entry_safe(e, n, struct entry, retired, retired) {
+        polls++;
+        if(!qsbr_poll(&domain, e->gp)) {
+            break;
+        }
+        list_del(&e->retired);
+        release(e);
+    }
+}
+
+static void *writer_poll(void *arg)
+{
+    unsigned int seed = (unsigned int)(long)arg;
+    struct entry *victim = NULL;
+    LIST_HEAD(retired);
+
+    while(!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+        pthread_mutex_lock(&writer_lock);
+        victim = update(&seed);
+        if(victim) {
+            victim->gp = qsbr_start(&domain);
+            list_add_tail(&victim->retired, &retired);
+        }
+        reclaim(&retired);
+        pthread_mutex_unlock(&writer_lock);
+        sched_yield();
+    }
+    /* the readers may still be online */
+    pthread_mutex_lock(&writer_lock);
+    while(!list_empty(&retired)) {
+        reclaim(&retired);
+        pthread_mutex_unlock(&writer_lock);
+        sched_yield();
+        pthread_mutex_lock(&writer_lock);
+    }
+    pthread_mutex_unlock(&writer_lock);
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t threads[READERS + WRITERS];
+    struct entry *pos = NULL, *n = NULL;
+    double seconds = (argc > 1) ? atof(argv[1]) : 2;
+    unsigned long left = 0, hashed = 0;
+
+    qsbr_init(&domain);
+    for(long i = 0; i < READERS; ++i) {
+        TEST_ASSERT(!pthread_create(&threads[i], NULL, reader, (void *)(i + 1)));
+    }
+    TEST_ASSERT(!pthread_create(&threads[READERS], NULL, writer_sync, (void *)100L));
+    TEST_ASSERT(!pthread_create(&threads[READERS + 1], NULL, writer_poll, (void *)200L));
+    usleep(seconds * 1e6);
+    __atomic_store_n(&stop, true, __ATOMIC_RELAXED);
+    for(int i = 0; i < READERS + WRITERS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    TEST_ASSERT(list_empty(&domain.readers));
+    for(int b = 0; b < BUCKETS; ++b) {
+        hlist_for_each_entry(pos, struct entry, &buckets[b], hnode) {
+            check_live(pos);
+            TEST_ASSERT(pos->key % BUCKETS == (uint32_t)b);
+            hashed++;
+        }
+    }
+    list_for_each_entry_safe(pos, n, struct entry, &entries, list) {
+        check_live(pos);
+        free(pos);
+        left++;
+    }
+    TEST_ASSERT(left == hashed);
+    printf("qsbr_stress: %d readers %lu walks, %lu frees after %lu grace periods and %lu polls, %lu entries left\n",
+           READERS, walks, frees, grace_periods, polls, left);
+
+    return 0;
+}
@@ -0,0 +1,118 @@
+/**
+ * @file test/rbtree_bench.c
+ *
+ * Copyright (C) 2022
+ *
+ * rbtree_bench.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * A deadline queue: random deadlines are inserted, then the earliest one
+ * is popped until the queue is empty. A tree with the cached leftmost node
+ * against a list kept sorted by insertion, per entry, for a few sizes.
+ *
+ * Usage: rbtree_bench
+ */
+
+/*---------- includes ----------*/
+#include "test.h"
+#include "rbtree.h"
+#include "lists.h"
+
+/*---------- macro ----------*/
+#define ENTRIES                             (10000)
+
+/*---------- type define ----------*/
+struct timer {
+    uint32_t deadline;
+    struct rb_node node;
+    struct list_head list;
+};
+
+/*---------- variable ----------*/
+static struct timer timers[ENTRIES];
+
+/*---------- function ----------*/
+static bool less(const struct rb_node *a, const struct rb_node *b)
+{
+    return rb_entry(a, struct timer, node)->deadline < rb_entry(b, struct timer, node)->deadline;
+}
+
+static double bench_tree(uint32_t n, unsigned long rounds)
+{
+    struct rb_root_cached queue;
+    double t = test_now();
+
+    for(unsigned long r = 0; r < rounds; ++r) {
+        queue = (struct rb_root_cached)RB_ROOT_CACHED;
+        for(uint32_t i = 0; i < n; ++i) {
+            rb_add_cached(&timers[i].node, &queue, less);
+        }
+        while(rb_first_cached(&queue)) {
+            rb_erase_cached(rb_first_cached(&queue), &queue);
+        }
+    }
+
+    return (test_now() - t) / rounds / n;
+}
+
+static double bench_list(uint32_t n, unsigned long rounds)
+{
+    struct list_head *pos = NULL;
+    double t = test_now();
+    LIST_HEAD(queue);
+
+    for(unsigned long r = 0; r < rounds; ++r) {
+        for(uint32_t i = 0; i < n; ++i) {
+            /* from the back, the deadlines are random anyway */
+            list_for_each_prev(pos, &queue) {
+                if(list_entry(pos, struct timer, list)->deadline <= timers[i].deadline) {
+                    break;
+                }
+            }
+            list_add(&timers[i].list, pos);
+        }
+        while(!list_empty(&queue)) {
+            list_del(queue.next);
+        }
+    }
+
+    return (test_now() - t) / rounds / n;
+}
+
+int main(int argc, char *argv[])
+{
+    static const uint32_t sizes[] = {10, 100, 1000, ENTRIES};
+    unsigned long rounds = 0;
+    double tree = 0, list = 0;
+
+    srand(1);
+    for(uint32_t i = 0; i < ENTRIES; ++i) {
+        timers[i].deadline = rand();
+    }
+    printf("rbtree_bench: insert and pop the earliest, per entry\n");
+    for(uint32_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); ++k) {
+        rounds = 4000000UL / sizes[k];
+        tree = bench_tree(sizes[k], rounds);
+        /* the list is quadratic, it gets fewer rounds */
+        rounds = (sizes[k] >= 1000) ? (rounds * 100 / sizes[k]) : rounds;
+        list = bench_list(sizes[k], rounds ? rounds : 1);
+        printf("%5u timers: rbtree %6.1f ns, sorted list %8.1f ns, x%.1f\n", sizes[k], tree * 1e9, list * 1e9,
+               list / tree);
+    }
+
+    return 0;
+}
@@ -0,0 +1,202 @@
+/**
+ * @file test/rbtree_random.c
+ *
+ * Copyright (C) 2022
+ *
+ * rbtree_random.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Random inserts, erases and replaces on a tree with the cached leftmost
+ * node, against a sorted array of the same entries. The keys repeat, the
+ * entries of a key must stay in the order they were inserted. Every few
+ * operations the red-black invariants are checked: black root, no red
+ * node with a red child, the same black height on every path, and the
+ * parent links. The tree is then walked both ways and must match the
+ * array, its leftmost node must be cached, and rb_find() must find the
+ * keys the array has, and only those.
+ *
+ * Usage: rbtree_random [seed] [operations]
+ */
+
+/*---------- includes ----------*/
+#include <string.h>
+#include "test.h"
+#include "rbtree.h"
+
+/*---------- macro ----------*/
+#define ENTRIES                             (5000)
+#define KEYS                                (2000)
+
+/*---------- type define ----------*/
+struct entry {
+    uint32_t key;
+    uint32_t seq;                                   /*<< insertion order, for the entries of a key */
+    struct rb_node node;
+};
+
+/*---------- variable ----------*/
+/* entry i and its twin i + ENTRIES, which replaces it in the tree */
+static struct entry entries[2 * ENTRIES];
+static struct entry *in_tree[ENTRIES];
+/* the entries in the tree, sorted by key and then insertion order */
+static struct entry *ref[ENTRIES];
+static uint32_t ref_count;
+
+/*---------- function ----------*/
+static bool less(const struct rb_node *a, const struct rb_node *b)
+{
+    return rb_entry(a, struct entry, node)->key < rb_entry(b, struct entry, node)->key;
+}
+
+static int cmp(const void *key, const struct rb_node *node)
+{
+    uint32_t a = *(const uint32_t *)key, b = rb_entry(node, struct entry, node)->key;
+
+    return (a < b) ? -1 : (a > b);
+}
+
+/* First index of the array whose key is not below key.
+ */
+static uint32_t ref_lower(uint32_t key)
+{
+    uint32_t lo = 0, hi = ref_count, mid = 0;
+
+    while(lo < hi) {
+        mid = (lo + hi) / 2;
+        if(ref[mid]->key < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/* Index of the array holding e.
+ */
+static uint32_t ref_index(const struct entry *e)
+{
+    uint32_t i = ref_lower(e->key);
+
+    while(i < ref_count && ref[i]->seq != e->seq) {
+        i++;
+    }
+    TEST_ASSERT(i < ref_count);
+
+    return i;
+}
+
+/* Check the subtree under node, whose parent is parent.
+ * Returns its black height.
+ */
+static uint32_t check_subtree(const struct rb_node *node, const struct rb_node *parent, uint32_t *count)
+{
+    uint32_t left = 0, right = 0;
+
+    if(!node) {
+        return 1;
+    }
+    TEST_ASSERT(rb_parent(node) == parent);
+    TEST_ASSERT(!(rb_is_red(node) && parent && rb_is_red(parent)));
+    left = check_subtree(node->left, node, count);
+    right = check_subtree(node->right, node, count);
+    TEST_ASSERT(left == right);
+    (*count)++;
+
+    return left + (rb_is_black(node) ? 1 : 0);
+}
+
+static void check_tree(const struct rb_root_cached *tree)
+{
+    const struct rb_node *node = NULL;
+    struct entry *pos = NULL;
+    uint32_t count = 0, i = 0, key = 0;
+
+    TEST_ASSERT(!tree->root.node || rb_is_black(tree->root.node));
+    check_subtree(tree->root.node, NULL, &count);
+    TEST_ASSERT(count == ref_count);
+    TEST_ASSERT(rb_first_cached(tree) == rb_first(&tree->root));
+    rb_for_each_entry(pos, struct entry, &tree->root, node) {
+        TEST_ASSERT(i < ref_count && pos == ref[i]);
+        i++;
+    }
+    TEST_ASSERT(i == ref_count);
+    for(node = rb_last(&tree->root); node; node = rb_prev(node)) {
+        TEST_ASSERT(i && rb_entry(node, struct entry, node) == ref[--i]);
+    }
+    TEST_ASSERT(!i);
+    for(int n = 0; n < 50; ++n) {
+        key = rand() % KEYS;
+        node = rb_find(&key, &tree->root, cmp);
+        i = ref_lower(key);
+        if(i < ref_count && ref[i]->key == key) {
+            TEST_ASSERT(node && rb_entry(node, struct entry, node)->key == key);
+        } else {
+            TEST_ASSERT(!node);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    struct rb_root_cached tree = RB_ROOT_CACHED;
+    struct entry *e = NULL, *twin = NULL;
+    unsigned long ops = 1000000, checks = 0;
+    uint32_t seq = 0, i = 0, k = 0;
+
+    srand(argc > 1 ? atoi(argv[1]) : 1);
+    if(argc > 2) {
+        ops = strtoul(argv[2], NULL, 0);
+    }
+    for(unsigned long n = 0; n < ops; ++n) {
+        i = rand() % ENTRIES;
+        e = in_tree[i];
+        if(!e) {
+            e = &entries[i];
+            e->key = rand() % KEYS;
+            e->seq = seq++;
+            k = ref_lower(e->key + 1);
+            memmove(&ref[k + 1], &ref[k], (ref_count - k) * sizeof(ref[0]));
+            ref[k] = e;
+            ref_count++;
+            TEST_ASSERT(rb_add_cached(&e->node, &tree, less) == (k == 0));
+            in_tree[i] = e;
+        } else if(rand() % 4 == 0) {
+            twin = (e == &entries[i]) ? &entries[i + ENTRIES] : &entries[i];
+            twin->key = e->key;
+            twin->seq = e->seq;
+            ref[ref_index(e)] = twin;
+            rb_replace_node_cached(&e->node, &twin->node, &tree);
+            in_tree[i] = twin;
+        } else {
+            k = ref_index(e);
+            memmove(&ref[k], &ref[k + 1], (ref_count - k - 1) * sizeof(ref[0]));
+            ref_count--;
+            rb_erase_cached(&e->node, &tree);
+            in_tree[i] = NULL;
+        }
+        if(n % 997 == 0) {
+            check_tree(&tree);
+            checks++;
+        }
+    }
+    check_tree(&tree);
+    printf("rbtree_random: %lu operations, %lu checks, %u entries left\n", ops, checks + 1, ref_count);
+
+    return 0;
+}
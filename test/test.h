@@ -0,0 +1,52 @@
+/**
+ * @file test/test.h
+ *
+ * Copyright (C) 2022
+ *
+ * test.h is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Assertion and clock of the host tests.
+ */
+#ifndef __TEST_H
+#define __TEST_H
+
+/*---------- includes ----------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*---------- macro ----------*/
+#define TEST_ASSERT(x)                                                          \
+    do {                                                                        \
+        if(!(x)) {                                                              \
+            fprintf(stderr, "%s:%d: assertion failed: %s\n", __FILE__, __LINE__, #x); \
+            exit(1);                                                            \
+        }                                                                       \
+    } while(0)
+
+/*---------- function ----------*/
+static inline double test_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#endif /* __TEST_H */
@@ -0,0 +1,116 @@
+/**
+ * @file test/xlog_async.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_async.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Asynchronous mode with a daemon thread draining the log buffer to a slow
+ * console, under each overflow policy. The producers keep logging while
+ * the console prints, they must not overwrite what it is printing: every
+ * line printed must be whole and in order, and every line missing must be
+ * told by a "N lines lost" marker.
+ *
+ * Usage: xlog_async [producers] [lines per producer]
+ */
+
+/*---------- includes ----------*/
+#include <semaphore.h>
+#include "xlog_test.h"
+
+/*---------- variable ----------*/
+static unsigned long lines_per_producer = 20000;
+static volatile bool producing;
+static sem_t wake;
+
+/*---------- function ----------*/
+static void notify(void)
+{
+    sem_post(&wake);
+}
+
+static void *producer(void *arg)
+{
+    int id = (int)(long)arg;
+
+    for(unsigned long i = 0; i < lines_per_producer; ++i) {
+        xlog_message("T%d-%07lu-" TEST_LINE_BODY "\n", id, i);
+    }
+
+    return NULL;
+}
+
+static void *daemon_task(void *arg)
+{
+    while(producing) {
+        sem_wait(&wake);
+        xlog_process();
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *const names[] = {"block", "drop oldest", "drop newest"};
+    pthread_t threads[TEST_PRODUCER_MAX], daemon;
+    struct test_result res;
+    xlog_async_stats_t stats;
+    xlog_ops_t ops;
+    int producers = 4;
+
+    if(argc > 1) {
+        producers = atoi(argv[1]);
+    }
+    if(argc > 2) {
+        lines_per_producer = strtoul(argv[2], NULL, 0);
+    }
+    TEST_ASSERT(producers > 0 && producers <= TEST_PRODUCER_MAX);
+    test_print_delay = 20;
+    for(int policy = XLOG_ASYNC_BLOCK; policy <= XLOG_ASYNC_DROP_NEWEST; ++policy) {
+        test_ops_init(&ops, (size_t)producers * lines_per_producer * 64 + 4096);
+        ops.notify = notify;
+        sem_init(&wake, 0, 0);
+        xlog_init(&ops);
+        TEST_ASSERT(xlog_set_async_policy((xlog_async_policy_t)policy));
+        producing = true;
+        TEST_ASSERT(!pthread_create(&daemon, NULL, daemon_task, NULL));
+        for(long i = 0; i < producers; ++i) {
+            TEST_ASSERT(!pthread_create(&threads[i], NULL, producer, (void *)i));
+        }
+        for(int i = 0; i < producers; ++i) {
+            pthread_join(threads[i], NULL);
+        }
+        producing = false;
+        sem_post(&wake);
+        pthread_join(daemon, NULL);
+        xlog_process();
+        test_check(producers, lines_per_producer, &res);
+        xlog_get_async_stats(&stats);
+        printf("xlog_async: %s, printed %lu, lost %lu, missing %lu, bad %lu, blocked %u, dropped oldest %u, newest %u\n",
+               names[policy], res.lines, res.lost, res.gaps, res.bad, stats.blocked, stats.dropped_oldest,
+               stats.dropped_newest);
+        TEST_ASSERT(!res.bad);
+        TEST_ASSERT(res.gaps == res.lost);
+        xlog_deinit();
+        sem_destroy(&wake);
+        free(test_out);
+    }
+
+    return 0;
+}
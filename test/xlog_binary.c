@@ -0,0 +1,112 @@
+/**
+ * @file test/xlog_binary.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_binary.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * The binary records of CONFIG_XLOG_BINARY, decoded by tools/xlog_decode.py.
+ * Lines with arguments of every kind are logged, tagged and continued ones
+ * among them, and what the console prints is written to <output>.bin. The
+ * same lines rendered by snprintf() are written to <output>.txt, which the
+ * decoder must give back from <output>.bin and the ELF file of the test, see
+ * the check target of the Makefile.
+ *
+ * Usage: xlog_binary <output>
+ */
+
+/*---------- includes ----------*/
+#include <stdarg.h>
+#include "xlog_test.h"
+
+/*---------- macro ----------*/
+#define BINARY_LINES                        (1000)
+
+/* Log a line and render the one expected.
+ */
+#define binary_line(x, y...)                do { \
+                                                xlog_message(x, ##y); \
+                                                binary_expect(x, ##y); \
+                                            } while(0)
+
+/*---------- variable ----------*/
+static char binary_text[BINARY_LINES * 256];
+static size_t binary_text_len;
+
+/*---------- function ----------*/
+static void __attribute__((format(printf, 1, 2))) binary_expect(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    binary_text_len += vsnprintf(&binary_text[binary_text_len], sizeof(binary_text) - binary_text_len, fmt, args);
+    va_end(args);
+    TEST_ASSERT(binary_text_len < sizeof(binary_text));
+}
+
+static void binary_save(const char *path, const char *ext, const char *data, size_t len)
+{
+    char name[256];
+    FILE *f = NULL;
+
+    snprintf(name, sizeof(name), "%s.%s", path, ext);
+    f = fopen(name, "wb");
+    TEST_ASSERT(f);
+    TEST_ASSERT(fwrite(data, 1, len, f) == len);
+    fclose(f);
+}
+
+int main(int argc, char *argv[])
+{
+    static const char cut[] = "a string longer than the 24 chars kept";
+    xlog_ops_t ops;
+    unsigned long lines = 0;
+
+    TEST_ASSERT(argc > 1);
+    test_ops_init(&ops, BINARY_LINES * 256);
+    xlog_init(&ops);
+    for(long i = 0; lines < BINARY_LINES; ++i) {
+        binary_line("int %d, negative %d, unsigned %u, hex %08x\n", (int)i, (int)-i, 4000000000U - (unsigned int)i,
+                    (unsigned int)i * 0x1001);
+        binary_line("64-bit %lld %llu, long %ld\n", -1234567890123LL * i, 18446744073709551615ULL - i, -i);
+        binary_line("double %.3f %e %g\n", i / 7.0, -2.5e-7 * i, 1e10 + i);
+        binary_line("string %s, char %c, width %*d|%-6s|%.*f, 100%%\n", "abc", 'a' + (int)(i % 26), 5, (int)i, "ab",
+                    (int)(i % 4), 1.23456);
+        binary_line("short %hd %hhu, pointer %p %p\n", (short)-i, (unsigned char)i, (void *)(uintptr_t)(i + 1),
+                    (void *)NULL);
+        /* a string argument is cut to CONFIG_XLOG_BIN_STR_MAX chars */
+        xlog_message("cut %s\n", cut);
+        binary_expect("cut %.*s\n", CONFIG_XLOG_BIN_STR_MAX, cut);
+        xlog_tag_message("net", "tagged %ld\n", i);
+        binary_expect("(net)tagged %ld\n", i);
+        xlog_message("continued %ld", i);
+        xlog_cont(", and %s\n", "ended");
+        binary_expect("continued %ld, and %s\n", i, "ended");
+        lines += 8;
+        /* the console keeps up, the lines are not lost */
+        xlog_process();
+    }
+    binary_save(argv[1], "bin", test_out, test_out_len);
+    binary_save(argv[1], "txt", binary_text, binary_text_len);
+    printf("xlog_binary: %lu lines, %lu bytes, %lu as text\n", lines, (unsigned long)test_out_len,
+           (unsigned long)binary_text_len);
+    free(test_out);
+    xlog_deinit();
+
+    return 0;
+}
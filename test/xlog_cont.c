@@ -0,0 +1,97 @@
+/**
+ * @file test/xlog_cont.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_cont.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Lines continued by LOG_CONT from two threads at once. One thread logs
+ * lines above the console log level and continues them, the other one
+ * logs lines shown and continues them. Every continuation must follow the
+ * fate of the line its own thread logged, whatever the other thread logged
+ * last: no continuation of a filtered line is printed, and every line shown
+ * is printed with its continuation.
+ *
+ * Usage: xlog_cont [lines per thread]
+ */
+
+/*---------- includes ----------*/
+#include "xlog_test.h"
+
+/*---------- variable ----------*/
+static unsigned long lines_per_thread = 100000;
+
+/*---------- function ----------*/
+static void *filtered(void *arg)
+{
+    for(unsigned long i = 0; i < lines_per_thread; ++i) {
+        xlog_info("F-%07lu", i);
+        /* the other thread logs in between */
+        sched_yield();
+        xlog_cont("-hidden\n");
+    }
+
+    return NULL;
+}
+
+static void *shown(void *arg)
+{
+    for(unsigned long i = 0; i < lines_per_thread; ++i) {
+        xlog_error("S-%07lu", i);
+        sched_yield();
+        xlog_cont("-shown\n");
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t threads[2];
+    const char *p = NULL, *end = NULL, *nl = NULL;
+    unsigned long lines = 0, n = 0, bad = 0;
+    char tail[16];
+    xlog_ops_t ops;
+
+    if(argc > 1) {
+        lines_per_thread = strtoul(argv[1], NULL, 0);
+    }
+    test_ops_init(&ops, lines_per_thread * 64 + 4096);
+    xlog_init(&ops);
+    TEST_ASSERT(xlog_set_log_level(LOG_WARN));
+    TEST_ASSERT(!pthread_create(&threads[0], NULL, filtered, NULL));
+    TEST_ASSERT(!pthread_create(&threads[1], NULL, shown, NULL));
+    for(int i = 0; i < 2; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    xlog_process();
+    for(p = test_out, end = test_out + test_out_len; p < end && (nl = memchr(p, '\n', end - p)) != NULL; p = nl + 1) {
+        p = __test_skip_color(p, nl);
+        if(sscanf(p, "S-%lu%15[^\n]", &n, tail) == 2 && n == lines && !strcmp(tail, "-shown")) {
+            lines++;
+        } else if(bad++ < 5) {
+            fprintf(stderr, "bad line: %.*s\n", (int)(nl - p), p);
+        }
+    }
+    printf("xlog_cont: %lu lines continued, bad %lu\n", lines, bad);
+    TEST_ASSERT(!bad);
+    TEST_ASSERT(lines == lines_per_thread);
+    xlog_deinit();
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+/**
+ * @file test/xlog_copy_bench.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_copy_bench.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Copy into the log buffer a char at a time, the way emit_log_char() did,
+ * against _log_copy() copying whole spans, over spans of a few sizes
+ * wrapping around the end of the buffer. xlog.c is built in so that the
+ * static functions can be called.
+ *
+ * Usage: xlog_copy_bench [megabytes per size]
+ */
+
+/*---------- includes ----------*/
+#include "xlog.c"
+#include "xlog_test.h"
+
+/*---------- variable ----------*/
+static uint32_t bench_end, bench_start;
+
+/*---------- function ----------*/
+/* The copy before spans: one char at a time, checking for an overflow after
+ * each one.
+ */
+static void emit_log_char(char c)
+{
+    uint32_t cache_len = 0;
+
+    LOG_BUF(bench_end) = c;
+    bench_end++;
+    if(bench_end < bench_start) {
+        cache_len = UINT32_MAX - bench_start + bench_end + 1;
+    } else {
+        cache_len = bench_end - bench_start;
+    }
+    if(cache_len > __LOG_BUF_LEN) {
+        bench_start++;
+    }
+}
+
+static double bench_chars(const char *src, uint32_t len, uint32_t rounds)
+{
+    double t = test_now();
+
+    for(uint32_t r = 0; r < rounds; ++r) {
+        for(uint32_t i = 0; i < len; ++i) {
+            emit_log_char(src[i]);
+        }
+        __asm__ __volatile__("" : : "r"(log_buf) : "memory");
+    }
+
+    return test_now() - t;
+}
+
+static double bench_spans(const char *src, uint32_t len, uint32_t rounds)
+{
+    double t = test_now();
+
+    for(uint32_t r = 0; r < rounds; ++r) {
+        _log_copy(bench_end, src, len);
+        bench_end += len;
+        __asm__ __volatile__("" : : "r"(log_buf) : "memory");
+    }
+
+    return test_now() - t;
+}
+
+int main(int argc, char *argv[])
+{
+    static const uint32_t sizes[] = {8, 32, 128, 1024};
+    char src[1024];
+    double mb = 64, before = 0, after = 0;
+    uint32_t rounds = 0;
+
+    if(argc > 1) {
+        mb = atof(argv[1]);
+    }
+    for(uint32_t i = 0; i < sizeof(src); ++i) {
+        src[i] = 'a' + i % 26;
+    }
+    printf("xlog_copy_bench: %u bytes log buffer\n", (unsigned int)__LOG_BUF_LEN);
+    for(uint32_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); ++k) {
+        rounds = (uint32_t)(mb * 1e6 / sizes[k]);
+        /* an odd start, so that the spans wrap around the end of the buffer */
+        bench_end = 3;
+        bench_start = 0;
+        before = bench_chars(src, sizes[k], rounds);
+        bench_end = 3;
+        after = bench_spans(src, sizes[k], rounds);
+        printf("%5u B spans: per char %8.1f MB/s, spans %8.1f MB/s, x%.1f\n", sizes[k],
+               mb / before, mb / after, before / after);
+    }
+
+    return 0;
+}
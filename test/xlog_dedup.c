@@ -0,0 +1,147 @@
+/**
+ * @file test/xlog_dedup.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_dedup.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Duplicate lines collapsed with CONFIG_XLOG_DEDUP, on a clock the test
+ * moves: the duplicates are reported in front of the next line which
+ * differs, by xlog_process() once CONFIG_XLOG_DEDUP_FLUSH_MS has passed, and
+ * in front of a duplicate coming after that. The report moves the line
+ * following it up in the log buffer, which is checked with lines of every
+ * length wrapping around the end of the buffer.
+ *
+ * Usage: xlog_dedup
+ */
+
+/*---------- includes ----------*/
+#include "xlog_test.h"
+
+/*---------- macro ----------*/
+#define DEDUP_FLUSH_US                      (30000000ULL)   /*<< CONFIG_XLOG_DEDUP_FLUSH_MS by default */
+
+/*---------- variable ----------*/
+static uint64_t clock_us = 1;
+static size_t checked;
+
+/*---------- function ----------*/
+static void get_timestamp_us(uint64_t *us)
+{
+    *us = clock_us;
+}
+
+/* The next line printed must be line, its color is skipped.
+ */
+static void expect(const char *line)
+{
+    const char *p = test_out + checked, *end = test_out + test_out_len, *nl = memchr(p, '\n', end - p);
+
+    TEST_ASSERT(nl);
+    p = __test_skip_color(p, nl);
+    if((size_t)(nl - p) != strlen(line) || memcmp(p, line, nl - p)) {
+        fprintf(stderr, "expected \"%s\", printed \"%.*s\"\n", line, (int)(nl - p), p);
+        TEST_ASSERT(false);
+    }
+    checked = nl + 1 - test_out;
+}
+
+static void expect_repeated(unsigned int times)
+{
+    char line[64];
+
+    snprintf(line, sizeof(line), "last message repeated %u times", times);
+    expect(line);
+}
+
+static void expect_end(void)
+{
+    TEST_ASSERT(checked == test_out_len);
+}
+
+int main(int argc, char *argv[])
+{
+    char body[400];
+    xlog_ops_t ops;
+
+    test_ops_init(&ops, 1 << 20);
+    ops.get_timestamp_us = get_timestamp_us;
+    xlog_init(&ops);
+
+    /* reported in front of the next line which differs */
+    for(int i = 0; i < 5; ++i) {
+        xlog_message("Hello, AliGenie\n");
+    }
+    xlog_process();
+    expect("Hello, AliGenie");
+    expect_end();
+    xlog_message("bye\n");
+    expect_repeated(4);
+    expect("bye");
+    expect_end();
+
+    /* reported by xlog_process() once expired, the next duplicate is stored */
+    for(int i = 0; i < 4; ++i) {
+        xlog_message("Hello, AliGenie\n");
+        clock_us += DEDUP_FLUSH_US / 6;
+    }
+    xlog_process();
+    expect("Hello, AliGenie");
+    expect_end();
+    clock_us += DEDUP_FLUSH_US / 2;
+    xlog_process();
+    expect_repeated(3);
+    expect_end();
+    xlog_process();
+    expect_end();
+    xlog_message("Hello, AliGenie\n");
+    xlog_message("Hello, AliGenie\n");
+    expect("Hello, AliGenie");
+    expect_end();
+
+    /* reported in front of a duplicate coming once expired */
+    clock_us += DEDUP_FLUSH_US;
+    xlog_message("Hello, AliGenie\n");
+    expect_repeated(1);
+    expect("Hello, AliGenie");
+    expect_end();
+    xlog_message("bye\n");
+    expect("bye");
+    expect_end();
+
+    /* the line following the report is moved up, across the end of the buffer */
+    for(int round = 0; round < 3; ++round) {
+        for(int len = 1; len < (int)sizeof(body) - 1; ++len) {
+            for(int i = 0; i < len; ++i) {
+                body[i] = 'a' + (i + round) % 26;
+            }
+            body[len] = '\0';
+            xlog_message("dup\n");
+            xlog_message("dup\n");
+            xlog_message("%s\n", body);
+            expect("dup");
+            expect_repeated(1);
+            expect(body);
+        }
+    }
+    expect_end();
+    printf("xlog_dedup: %zu bytes printed as expected\n", checked);
+    xlog_deinit();
+
+    return 0;
+}
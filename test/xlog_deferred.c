@@ -0,0 +1,102 @@
+/**
+ * @file test/xlog_deferred.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_deferred.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Deferred mode with a consumer thread calling xlog_process() while the
+ * producers log. Every other line has a %s argument and is formatted in
+ * place, it must not overtake the lines its producer queued before. No more
+ * than 1% of the lines may be lost.
+ *
+ * Usage: xlog_deferred [producers] [lines per producer]
+ */
+
+/*---------- includes ----------*/
+#include "xlog_test.h"
+
+/*---------- variable ----------*/
+static unsigned long lines_per_producer = 50000;
+static volatile bool producing = true;
+
+/*---------- function ----------*/
+static void *producer(void *arg)
+{
+    int id = (int)(long)arg;
+
+    for(unsigned long i = 0; i < lines_per_producer; ++i) {
+        if(i & 1) {
+            xlog_message("T%d-%07lu-%s\n", id, i, TEST_LINE_BODY);
+        } else {
+            xlog_message("T%d-%07lu-" TEST_LINE_BODY "\n", id, i);
+        }
+    }
+
+    return NULL;
+}
+
+static void *consumer(void *arg)
+{
+    while(producing) {
+        xlog_process();
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t threads[TEST_PRODUCER_MAX], cons;
+    struct test_result res;
+    xlog_ops_t ops;
+    int producers = 4;
+    double t = 0;
+
+    if(argc > 1) {
+        producers = atoi(argv[1]);
+    }
+    if(argc > 2) {
+        lines_per_producer = strtoul(argv[2], NULL, 0);
+    }
+    TEST_ASSERT(producers > 0 && producers <= TEST_PRODUCER_MAX);
+    test_ops_init(&ops, (size_t)producers * lines_per_producer * 64 + 4096);
+    xlog_init(&ops);
+    t = test_now();
+    TEST_ASSERT(!pthread_create(&cons, NULL, consumer, NULL));
+    for(long i = 0; i < producers; ++i) {
+        TEST_ASSERT(!pthread_create(&threads[i], NULL, producer, (void *)i));
+    }
+    for(int i = 0; i < producers; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    producing = false;
+    pthread_join(cons, NULL);
+    xlog_process();
+    t = test_now() - t;
+    test_check(producers, lines_per_producer, &res);
+    printf("xlog_deferred: %d producers, %.0f lines/s, printed %lu, lost %lu, missing %lu, bad %lu\n",
+           producers, producers * lines_per_producer / t, res.lines, res.lost, res.gaps, res.bad);
+    TEST_ASSERT(!res.bad);
+    TEST_ASSERT(res.gaps == res.lost);
+    /* a producer waits for room, lines are only lost when that takes too long */
+    TEST_ASSERT(res.lost * 100 <= producers * lines_per_producer);
+    xlog_deinit();
+
+    return 0;
+}
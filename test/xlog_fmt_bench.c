@@ -0,0 +1,88 @@
+/**
+ * @file test/xlog_fmt_bench.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_fmt_bench.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Time taken by _vformat() and by the C library vsnprintf() to format a
+ * few typical log lines. xlog.c is built in so that _vformat() can be
+ * called.
+ *
+ * Usage: xlog_fmt_bench [rounds]
+ */
+
+/*---------- includes ----------*/
+#include "xlog.c"
+#include "xlog_test.h"
+
+/*---------- variable ----------*/
+static char bench_buf[256];
+
+/*---------- function ----------*/
+static void __attribute__((format(printf, 1, 2))) bench_xlog(const char *fmt, ...)
+{
+    struct log_out_buf b;
+    va_list args;
+
+    va_start(args, fmt);
+    _out_buf_init(&b, bench_buf, sizeof(bench_buf));
+    _vformat(&b.out, fmt, args);
+    va_end(args);
+}
+
+static void __attribute__((format(printf, 1, 2))) bench_libc(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(bench_buf, sizeof(bench_buf), fmt, args);
+    va_end(args);
+}
+
+#define BENCH_LINES(func, i)                                                    \
+    do {                                                                        \
+        func("wifi connected, rssi %d dBm, channel %u\n", -(int)((i) & 63), (unsigned int)((i) % 13)); \
+        func("heap free %lu, min %lu, task %s\n", 123456ul + (i), 98765ul, "daemon"); \
+        func("reg 0x%08x = 0x%04x\n", (unsigned int)(i) * 2654435761u, (unsigned int)(i) & 0xffff); \
+        func("Hello, AliGenie\n");                                              \
+    } while(0)
+
+int main(int argc, char *argv[])
+{
+    unsigned long rounds = 1000000;
+    double xlog = 0, libc = 0;
+
+    if(argc > 1) {
+        rounds = strtoul(argv[1], NULL, 0);
+    }
+    xlog = test_now();
+    for(unsigned long i = 0; i < rounds; ++i) {
+        BENCH_LINES(bench_xlog, i);
+    }
+    xlog = test_now() - xlog;
+    libc = test_now();
+    for(unsigned long i = 0; i < rounds; ++i) {
+        BENCH_LINES(bench_libc, i);
+    }
+    libc = test_now() - libc;
+    printf("xlog_fmt_bench: _vformat %.0f ns/line, vsnprintf %.0f ns/line, x%.1f\n",
+           xlog * 1e9 / rounds / 4, libc * 1e9 / rounds / 4, libc / xlog);
+
+    return 0;
+}
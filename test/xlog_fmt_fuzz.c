@@ -0,0 +1,273 @@
+/**
+ * @file test/xlog_fmt_fuzz.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_fmt_fuzz.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Differential fuzz test of the conversions of _vformat() against the C
+ * library vsnprintf(): random flags, widths, precisions, length modifiers
+ * and arguments, the outputs must be the same. The combinations the C
+ * standard leaves undefined are skipped. The conversions handed to the C
+ * library one by one, "%Lf", "%lc", "%ls" and "%n", are followed by a tail
+ * longer than a conversion buffer, with conversions of its own. xlog.c is
+ * built in so that _vformat() can be called.
+ *
+ * Usage: xlog_fmt_fuzz [seed] [cases]
+ */
+
+/*---------- includes ----------*/
+#include <limits.h>
+#include <sys/types.h>
+#include <wchar.h>
+#include "xlog.c"
+#include "xlog_test.h"
+
+/*---------- macro ----------*/
+#define FUZZ_BUF_SIZE                       (512)
+
+/* format the argument with both, passing the '*' width and precision first
+ */
+#define FUZZ_CALL(type, val)                                                    \
+    do {                                                                        \
+        if(stars == 0) {                                                        \
+            fuzz_xlog(mine, f, (type)(val));                                    \
+            snprintf(libc, sizeof(libc), f, (type)(val));                       \
+        } else if(stars == 1) {                                                 \
+            fuzz_xlog(mine, f, star[0], (type)(val));                           \
+            snprintf(libc, sizeof(libc), f, star[0], (type)(val));              \
+        } else {                                                                \
+            fuzz_xlog(mine, f, star[0], star[1], (type)(val));                  \
+            snprintf(libc, sizeof(libc), f, star[0], star[1], (type)(val));     \
+        }                                                                       \
+    } while(0)
+
+/*---------- function ----------*/
+static void fuzz_xlog(char *buf, const char *fmt, ...)
+{
+    struct log_out_buf b;
+    va_list args;
+
+    va_start(args, fmt);
+    _out_buf_init(&b, buf, FUZZ_BUF_SIZE);
+    _vformat(&b.out, fmt, args);
+    va_end(args);
+}
+
+static unsigned long long fuzz_rand64(void)
+{
+    unsigned long long v = ((unsigned long long)rand() << 33) ^ ((unsigned long long)rand() << 11) ^ rand();
+
+    switch(rand() % 8) {
+        case 0:
+            v = 0;
+            break;
+        case 1:
+            v = rand() % 10;
+            break;
+        case 2:
+            v = (unsigned long long)LLONG_MIN;
+            break;
+        case 3:
+            v = ULLONG_MAX;
+            break;
+        case 4:
+            v = (unsigned int)INT_MIN;
+            break;
+        case 5:
+            v &= 0xffffffff;
+            break;
+        default:
+            break;
+    }
+
+    return v;
+}
+
+/* Build a random "x%<flags><width><.prec><length><conv>|y" into f.
+ * Returns false for a combination the C standard leaves undefined.
+ */
+static bool fuzz_spec(char *f, char conv, int *len_mod, int *stars, int star[2])
+{
+    static const char *const lens[] = {"", "hh", "h", "l", "ll", "z"};
+    static const char flags[] = "-+ #0";
+    bool zero = false, alt = false;
+    int k = 0, width = 0, prec = 0;
+
+    f[k++] = 'x';
+    f[k++] = '%';
+    for(int i = 0; flags[i]; ++i) {
+        if(rand() % 4 == 0) {
+            f[k++] = flags[i];
+            zero = zero || flags[i] == '0';
+            alt = alt || flags[i] == '#';
+        }
+    }
+    *stars = 0;
+    width = rand() % 3;
+    if(width == 1) {
+        k += sprintf(&f[k], "%d", 1 + rand() % 30);
+    } else if(width == 2) {
+        f[k++] = '*';
+        star[(*stars)++] = rand() % 40 - 20;
+    }
+    prec = rand() % 3;
+    if(prec == 1) {
+        k += sprintf(&f[k], ".%d", rand() % 25);
+    } else if(prec == 2) {
+        f[k++] = '.';
+        f[k++] = '*';
+        star[(*stars)++] = rand() % 30 - 5;
+    }
+    *len_mod = strchr("diouxX", conv) ? rand() % 6 : 0;
+    sprintf(&f[k], "%s%c|y", lens[*len_mod], conv);
+
+    return !(alt && strchr("diucs", conv)) && !(zero && strchr("cs", conv));
+}
+
+/* A conversion handed to the C library, then a long tail with conversions of
+ * its own, the tail must come out whole.
+ * Returns the number of mismatches.
+ */
+static unsigned long fuzz_tails(unsigned long cases)
+{
+    static const char tail[] = " and the rest of the line, %d items of %s, which is longer than a"
+                               " conversion buffer: %5.2f%% done, last %#x\n";
+    static const wchar_t wide[] = L"wide";
+    char f[256], mine[FUZZ_BUF_SIZE], libc[FUZZ_BUF_SIZE];
+    unsigned long bad = 0;
+    long double ld = 0;
+    int count = 0, v = 0;
+
+    for(unsigned long n = 0; n < cases; ++n) {
+        v = rand();
+        ld = (long double)v / (1 + rand() % 1000);
+        switch(n % 4) {
+            case 0:
+                snprintf(f, sizeof(f), "x%%.%dL%c%s", rand() % 12, "feg"[rand() % 3], tail);
+                fuzz_xlog(mine, f, ld, v, "bytes", (double)v / 1000, v);
+                snprintf(libc, sizeof(libc), f, ld, v, "bytes", (double)v / 1000, v);
+                break;
+            case 1:
+                snprintf(f, sizeof(f), "x%%%dlc%s", rand() % 8, tail);
+                fuzz_xlog(mine, f, (wint_t)('A' + v % 26), v, "bytes", (double)v / 1000, v);
+                snprintf(libc, sizeof(libc), f, (wint_t)('A' + v % 26), v, "bytes", (double)v / 1000, v);
+                break;
+            case 2:
+                snprintf(f, sizeof(f), "x%%-%d.%dls%s", rand() % 8, rand() % 6, tail);
+                fuzz_xlog(mine, f, wide, v, "bytes", (double)v / 1000, v);
+                snprintf(libc, sizeof(libc), f, wide, v, "bytes", (double)v / 1000, v);
+                break;
+            default:
+                snprintf(f, sizeof(f), "x%%n%s", tail);
+                fuzz_xlog(mine, f, &count, v, "bytes", (double)v / 1000, v);
+                snprintf(libc, sizeof(libc), f, &count, v, "bytes", (double)v / 1000, v);
+                break;
+        }
+        if(strcmp(mine, libc)) {
+            if(bad++ < 15) {
+                fprintf(stderr, "fmt %-20.20s xlog [%s] libc [%s]\n", f, mine, libc);
+            }
+        }
+    }
+
+    return bad;
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *const strs[] = {"", "a", "hello", "0123456789abcdefghijklmnopqrstuvwxyz", NULL};
+    static const char convs[] = "diouxXcsfeg";
+    char f[64], mine[FUZZ_BUF_SIZE], libc[FUZZ_BUF_SIZE];
+    unsigned long cases = 1000000, n = 0, bad = 0;
+    unsigned long long v = 0;
+    double d = 0;
+    int len_mod = 0, stars = 0, star[2] = {0};
+    const char *s = NULL;
+    char conv = 0;
+
+    srand(argc > 1 ? atoi(argv[1]) : 1);
+    if(argc > 2) {
+        cases = strtoul(argv[2], NULL, 0);
+    }
+    while(n < cases) {
+        conv = convs[rand() % (sizeof(convs) - 1)];
+        if(!fuzz_spec(f, conv, &len_mod, &stars, star)) {
+            continue;
+        }
+        v = fuzz_rand64();
+        switch(conv) {
+            case 'd':
+            case 'i':
+                if(len_mod <= 2) {
+                    FUZZ_CALL(int, v);
+                } else if(len_mod == 3) {
+                    FUZZ_CALL(long, v);
+                } else if(len_mod == 4) {
+                    FUZZ_CALL(long long, v);
+                } else {
+                    FUZZ_CALL(ssize_t, v);
+                }
+                break;
+            case 'o':
+            case 'u':
+            case 'x':
+            case 'X':
+                if(len_mod <= 2) {
+                    FUZZ_CALL(unsigned int, v);
+                } else if(len_mod == 3) {
+                    FUZZ_CALL(unsigned long, v);
+                } else if(len_mod == 4) {
+                    FUZZ_CALL(unsigned long long, v);
+                } else {
+                    FUZZ_CALL(size_t, v);
+                }
+                break;
+            case 'c':
+                FUZZ_CALL(int, 'A' + (int)(v % 26));
+                break;
+            case 's':
+                s = strs[rand() % 5];
+                if(!s) {
+                    /* "(null)" is the C library's own, with no precision only */
+                    if(strchr(f, '.')) {
+                        continue;
+                    }
+                }
+                FUZZ_CALL(const char *, s);
+                break;
+            default:
+                d = ((double)(long long)v) / (1 + rand() % 1000);
+                FUZZ_CALL(double, d);
+                break;
+        }
+        n++;
+        if(strcmp(mine, libc)) {
+            if(bad++ < 15) {
+                fprintf(stderr, "fmt %-20s xlog [%s] libc [%s]\n", f, mine, libc);
+            }
+        }
+    }
+    printf("xlog_fmt_fuzz: %lu cases, %lu mismatches\n", n, bad);
+    TEST_ASSERT(!bad);
+    bad = fuzz_tails(cases / 100);
+    printf("xlog_fmt_fuzz: %lu long tails after a conversion of the C library, %lu mismatches\n", cases / 100, bad);
+    TEST_ASSERT(!bad);
+
+    return 0;
+}
@@ -0,0 +1,182 @@
+/**
+ * @file test/xlog_hexdump.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_hexdump.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * The rows of xlog_hexdump() come out whole and together. One thread dumps
+ * frames carrying their number in the first bytes while another one logs
+ * lines, every row must be the one rendered here and the rows of a dump must
+ * follow each other with no line of the other thread in between. In lockless
+ * mode a dump longer than the log buffer is then dumped alone and must come
+ * out whole, the locked path puts all of its rows under one lock and drops
+ * the oldest ones.
+ *
+ * Usage: xlog_hexdump [dumps]
+ */
+
+/*---------- includes ----------*/
+#include "xlog_test.h"
+
+/*---------- macro ----------*/
+#define TEST_FRAME_SIZE                     (200)
+#define TEST_BIG_SIZE                       (1 << 13)
+
+/*---------- variable ----------*/
+static unsigned long dumps = 5000;
+static volatile bool dumping;
+
+/*---------- function ----------*/
+static void fill(uint8_t *frame, uint32_t size, uint32_t k)
+{
+    for(uint32_t i = 0; i < size; ++i) {
+        frame[i] = (uint8_t)(k * 31 + i * 7);
+    }
+    memcpy(frame, &k, sizeof(k));
+}
+
+/* Render a row the way xlog_hexdump() prints it, without the '\n'.
+ */
+static int render_row(char *row, const char *tag, const uint8_t *p, uint32_t n, uint32_t off, int digits)
+{
+    int len = sprintf(row, "(%s)%0*X:", tag, digits, (unsigned int)off);
+
+    for(uint32_t i = 0; i < 16; ++i) {
+        len += sprintf(&row[len], (i == 8) ? "  " : " ");
+        len += (i < n) ? sprintf(&row[len], "%02X", p[i]) : sprintf(&row[len], "  ");
+    }
+    len += sprintf(&row[len], "  |");
+    for(uint32_t i = 0; i < n; ++i) {
+        row[len++] = (p[i] >= 0x20 && p[i] < 0x7F) ? (char)p[i] : '.';
+    }
+    row[len++] = '|';
+    row[len] = '\0';
+
+    return len;
+}
+
+/* Check the rows of a dump of size bytes starting at *pp, the frame is
+ * told by its first row. Returns false when a row is missing or wrong.
+ */
+static bool check_dump(const char **pp, const char *end, const char *tag, uint32_t size, uint8_t *frame)
+{
+    const char *p = *pp, *nl = NULL;
+    char row[256];
+    uint32_t k = 0, n = 0;
+    unsigned int b[4];
+    int digits = (size > 0x10000) ? 8 : 4, len = 0;
+
+    for(uint32_t off = 0; off < size; off += n) {
+        nl = memchr(p, '\n', end - p);
+        if(!nl) {
+            return false;
+        }
+        p = __test_skip_color(p, nl);
+        if(!off) {
+            if(sscanf(p + strlen(tag) + 2 + digits + 1, " %2x %2x %2x %2x", &b[0], &b[1], &b[2], &b[3]) != 4) {
+                return false;
+            }
+            k = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+            fill(frame, size, k);
+        }
+        n = ((size - off) < 16) ? (size - off) : 16;
+        len = render_row(row, tag, &frame[off], n, off, digits);
+        if(len != nl - p || memcmp(p, row, len)) {
+            return false;
+        }
+        p = nl + 1;
+    }
+    *pp = p;
+
+    return true;
+}
+
+static void *dumper(void *arg)
+{
+    uint8_t frame[TEST_FRAME_SIZE];
+
+    for(uint32_t k = 0; k < dumps; ++k) {
+        fill(frame, sizeof(frame), k);
+        xlog_hexdump(LOG_WARN, "dump", frame, sizeof(frame));
+    }
+    dumping = false;
+
+    return NULL;
+}
+
+static void *logger(void *arg)
+{
+    for(unsigned long i = 0; dumping && i < dumps * 16; ++i) {
+        xlog_warn("T0-%lu-" TEST_LINE_BODY "\n", i);
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    static uint8_t frame[TEST_BIG_SIZE];
+    pthread_t threads[2];
+    const char *p = NULL, *end = NULL, *nl = NULL, *q = NULL;
+    unsigned long whole = 0, lines = 0, lost = 0, bad = 0;
+    xlog_ops_t ops;
+
+    if(argc > 1) {
+        dumps = strtoul(argv[1], NULL, 0);
+    }
+    test_ops_init(&ops, dumps * (16 * 128 + 16 * 64) + 1024 * 1024);
+    xlog_init(&ops);
+    dumping = true;
+    TEST_ASSERT(!pthread_create(&threads[0], NULL, dumper, NULL));
+    TEST_ASSERT(!pthread_create(&threads[1], NULL, logger, NULL));
+    for(int i = 0; i < 2; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    xlog_process();
+    for(p = test_out, end = test_out + test_out_len; p < end && (nl = memchr(p, '\n', end - p)) != NULL;) {
+        q = __test_skip_color(p, nl);
+        if(!strncmp(q, "(dump)0000:", 11) && check_dump(&p, end, "dump", TEST_FRAME_SIZE, frame)) {
+            whole++;
+            continue;
+        } else if(!strncmp(q, "T0-", 3)) {
+            lines++;
+        } else if(strstr(q, " lines lost") && strstr(q, " lines lost") < nl) {
+            lost++;
+        } else if(bad++ < 5) {
+            fprintf(stderr, "bad line: %.*s\n", (int)(nl - q), q);
+        }
+        p = nl + 1;
+    }
+    printf("xlog_hexdump: %lu of %lu dumps whole, %lu lines between, %lu lost markers, bad %lu\n",
+           whole, dumps, lines, lost, bad);
+    TEST_ASSERT(!bad && whole && whole + lost >= dumps);
+#ifdef CONFIG_XLOG_LOCKLESS
+    test_out_len = 0;
+    fill(frame, sizeof(frame), 0x12345678);
+    xlog_hexdump(LOG_WARN, "big", frame, sizeof(frame));
+    xlog_process();
+    p = test_out;
+    TEST_ASSERT(check_dump(&p, test_out + test_out_len, "big", sizeof(frame), frame));
+    TEST_ASSERT(p == test_out + test_out_len);
+#endif
+    xlog_deinit();
+    free(test_out);
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file test/xlog_hexdump_bench.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_hexdump_bench.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Time taken to dump a 256-byte frame by xlog_hexdump(), with and without
+ * a tag, and by the byte by byte xlog_cont() loop PRINT_BUFFER_CONTENT was
+ * before it. The tag is copied into a stack buffer on every dump, it must
+ * be registered once only. xlog.c is built in so that the registry can be
+ * checked.
+ *
+ * Usage: xlog_hexdump_bench [rounds]
+ */
+
+/*---------- includes ----------*/
+#include "xlog.c"
+#include "xlog_test.h"
+
+/*---------- macro ----------*/
+#define BENCH_FRAME_SIZE                    (256)
+
+/* PRINT_BUFFER_CONTENT as it was, one call per byte */
+#define BENCH_OLD_DUMP(color, tag, buf, length)         \
+        do {                                            \
+            xlog_cont("%s%s: ", color, tag);            \
+            for(uint32_t i = 0; i < length; ++i) {      \
+                xlog_cont("%02X ", buf[i]);             \
+            }                                           \
+            xlog_cont("\b\n");                          \
+        } while(0);
+
+/*---------- function ----------*/
+static uint32_t bench_registered(void)
+{
+    uint32_t count = 0;
+
+    for(uint32_t i = 0; i < CONFIG_XLOG_TAG_MAX; ++i) {
+        count += (tag_states[i] != TAG_FREE);
+    }
+
+    return count;
+}
+
+int main(int argc, char *argv[])
+{
+    uint8_t frame[BENCH_FRAME_SIZE];
+    char tag[8];
+    unsigned long rounds = 2000;
+    double old = 0, plain = 0, tagged = 0;
+    xlog_ops_t ops;
+
+    if(argc > 1) {
+        rounds = strtoul(argv[1], NULL, 0);
+    }
+    for(uint32_t i = 0; i < sizeof(frame); ++i) {
+        frame[i] = (uint8_t)(i * 7);
+    }
+    test_ops_init(&ops, 64 * 1024);
+    xlog_init(&ops);
+    xlog_set_log_level(LOG_INFO);
+    old = test_now();
+    for(unsigned long i = 0; i < rounds; ++i) {
+        BENCH_OLD_DUMP("\033[32;22m", "uart", frame, sizeof(frame));
+        test_out_len = 0;
+    }
+    old = test_now() - old;
+    plain = test_now();
+    for(unsigned long i = 0; i < rounds; ++i) {
+        xlog_hexdump(LOG_MESSAGE, NULL, frame, sizeof(frame));
+        test_out_len = 0;
+    }
+    plain = test_now() - plain;
+    tagged = test_now();
+    for(unsigned long i = 0; i < rounds; ++i) {
+        /* a tag which does not outlive the call */
+        snprintf(tag, sizeof(tag), "uart");
+        xlog_hexdump(LOG_MESSAGE, tag, frame, sizeof(frame));
+        memset(tag, 'x', sizeof(tag) - 1);
+        test_out_len = 0;
+    }
+    tagged = test_now() - tagged;
+    TEST_ASSERT(bench_registered() == 1);
+    TEST_ASSERT(!strcmp(tag_names[0], "uart"));
+    TEST_ASSERT(xlog_set_tag_level("uart", LOG_ERROR) && bench_registered() == 1);
+    xlog_hexdump(LOG_MESSAGE, "uart", frame, sizeof(frame));
+    TEST_ASSERT(!test_out_len);
+    printf("xlog_hexdump_bench: %u-byte frame, byte by byte %.2f us, xlog_hexdump %.2f us, "
+           "tagged %.2f us, x%.1f\n", BENCH_FRAME_SIZE, old * 1e6 / rounds, plain * 1e6 / rounds,
+           tagged * 1e6 / rounds, old / tagged);
+    xlog_deinit();
+
+    return 0;
+}
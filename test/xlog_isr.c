@@ -0,0 +1,173 @@
+/**
+ * @file test/xlog_isr.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_isr.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * xlog_from_isr() called from simulated interrupts of two cores, one thread
+ * per core, while a task thread merges the staged lines with xlog_process().
+ * The lines must be merged in the order they were logged: a line logged
+ * after another one returned is never printed before it. Every line
+ * missing, because a ring was full, must be told by a "N lines lost"
+ * marker. The cost of xlog_from_isr() is printed.
+ *
+ * Usage: xlog_isr [lines per core]
+ */
+
+/*---------- includes ----------*/
+#include <sched.h>
+#include "xlog_test.h"
+
+/*---------- macro ----------*/
+#define ISR_CORES                           (2)
+#define ISR_BURST                           (16)    /*<< interrupts in a row, more than the slots of a ring */
+
+/*---------- type define ----------*/
+struct isr_line {
+    uint32_t before;                                /*<< lines logged when the call started */
+    uint32_t after;                                 /*<< lines logged once the call returned */
+};
+
+/*---------- variable ----------*/
+static unsigned long lines_per_core = 100000;
+static __thread uint32_t core;
+static uint32_t logged;                             /*<< calls of both cores returned */
+static struct isr_line *lines[ISR_CORES];
+static unsigned long refused[ISR_CORES];
+static double cost[ISR_CORES];
+static volatile bool interrupting = true;
+
+/*---------- function ----------*/
+static uint32_t core_id(void)
+{
+    return core;
+}
+
+static void *isr_core(void *arg)
+{
+    struct isr_line *line = NULL;
+    double t = 0;
+
+    core = (uint32_t)(long)arg;
+    for(unsigned long i = 0; i < lines_per_core; ++i) {
+        line = &lines[core][i];
+        line->before = __atomic_load_n(&logged, __ATOMIC_ACQUIRE);
+        t = test_now();
+        if(!xlog_from_isr(LOG_MESSAGE "T%u-%07lu-" TEST_LINE_BODY "\n", core, i)) {
+            refused[core]++;
+        }
+        cost[core] += test_now() - t;
+        line->after = __atomic_add_fetch(&logged, 1, __ATOMIC_ACQ_REL);
+        /* a burst of interrupts, then the task gets the core back */
+        if((i % ISR_BURST) == (ISR_BURST - 1)) {
+            sched_yield();
+        }
+    }
+    cost[core] /= lines_per_core;
+
+    return NULL;
+}
+
+static void *task(void *arg)
+{
+    while(interrupting) {
+        xlog_process();
+    }
+
+    return NULL;
+}
+
+/* A line must not be printed after a line whose call returned before its
+ * own call started, the printed lines are walked from the last one.
+ */
+static unsigned long check_order(void)
+{
+    const char *p = test_out, *end = test_out + test_out_len, *nl = NULL;
+    struct isr_line **printed = calloc(ISR_CORES * lines_per_core, sizeof(*printed));
+    uint32_t first_after = UINT32_MAX;
+    unsigned long retval = 0, count = 0, n = 0;
+    unsigned int id = 0;
+
+    TEST_ASSERT(printed);
+    for(; p < end && (nl = memchr(p, '\n', end - p)) != NULL; p = nl + 1) {
+        p = __test_skip_color(p, nl);
+        if(sscanf(p, "T%u-%lu-", &id, &n) == 2 && id < ISR_CORES && n < lines_per_core) {
+            printed[count++] = &lines[id][n];
+        }
+    }
+    while(count--) {
+        if(first_after <= printed[count]->before) {
+            retval++;
+        }
+        if(printed[count]->after < first_after) {
+            first_after = printed[count]->after;
+        }
+    }
+    free(printed);
+
+    return retval;
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t cores[ISR_CORES], merger;
+    struct test_result res;
+    xlog_ops_t ops;
+    unsigned long misordered = 0;
+
+    if(argc > 1) {
+        lines_per_core = strtoul(argv[1], NULL, 0);
+    }
+    test_ops_init(&ops, ISR_CORES * lines_per_core * 64 + 4096);
+    ops.core_id = core_id;
+    xlog_init(&ops);
+    for(long i = 0; i < ISR_CORES; ++i) {
+        lines[i] = calloc(lines_per_core, sizeof(struct isr_line));
+        TEST_ASSERT(lines[i]);
+    }
+    TEST_ASSERT(!pthread_create(&merger, NULL, task, NULL));
+    for(long i = 0; i < ISR_CORES; ++i) {
+        TEST_ASSERT(!pthread_create(&cores[i], NULL, isr_core, (void *)i));
+    }
+    for(int i = 0; i < ISR_CORES; ++i) {
+        pthread_join(cores[i], NULL);
+    }
+    interrupting = false;
+    pthread_join(merger, NULL);
+    xlog_process();
+    /* the lost lines not followed by a line are reported by the next one,
+     * which is not checked, in deferred mode it is queued behind the others
+     */
+    xlog_message("end\n");
+    xlog_process();
+    for(test_out_len--; test_out_len && test_out[test_out_len - 1] != '\n'; test_out_len--) {
+    }
+    test_check(ISR_CORES, lines_per_core, &res);
+    misordered = check_order();
+    printf("xlog_isr: %.0f ns per call, printed %lu, refused %lu, lost %lu, missing %lu, bad %lu, misordered %lu\n",
+           (cost[0] + cost[1]) / ISR_CORES * 1e9, res.lines, refused[0] + refused[1], res.lost, res.gaps,
+           res.bad, misordered);
+    TEST_ASSERT(!res.bad);
+    TEST_ASSERT(!misordered);
+    TEST_ASSERT(res.gaps == res.lost);
+    TEST_ASSERT(refused[0] + refused[1] <= res.lost);
+    xlog_deinit();
+
+    return 0;
+}
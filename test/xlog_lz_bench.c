@@ -0,0 +1,148 @@
+/**
+ * @file test/xlog_lz_bench.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_lz_bench.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * The compressor of the sinks(xlog_lz.h) on a log captured from the console:
+ * lines of a few kinds at every level, with their colors and timestamps. The
+ * log is compressed in chunks of a sink buffer, the way a sink writes it, and
+ * the ratio and the speed are reported. With an output given, the log and the
+ * compressed stream are written to <output>.log and <output>.lz, to be checked
+ * against tools/xlog_lz.py, see the check target of the Makefile.
+ *
+ * Usage: xlog_lz_bench [megabytes [output]]
+ */
+
+/*---------- includes ----------*/
+#include "xlog_test.h"
+#include "xlog_lz.h"
+
+/*---------- macro ----------*/
+#define BENCH_LINES                         (20000)
+#define BENCH_CHUNK                         (256)   /*<< CONFIG_XLOG_SINK_BUF_SIZE */
+
+/*---------- variable ----------*/
+static xlog_lz_t bench_lz;
+static char *bench_out;
+static size_t bench_out_len, bench_out_size;
+
+/*---------- function ----------*/
+static void bench_write(const char *str, uint32_t length)
+{
+    TEST_ASSERT(bench_out_len + length <= bench_out_size);
+    memcpy(&bench_out[bench_out_len], str, length);
+    bench_out_len += length;
+}
+
+/* Log lines of a few kinds, with values changing from line to line.
+ */
+static void bench_capture(void)
+{
+    uint32_t r = 1;
+    xlog_ops_t ops;
+
+    test_ops_init(&ops, BENCH_LINES * 128);
+    xlog_init(&ops);
+    for(unsigned long i = 0; i < BENCH_LINES; ++i) {
+        r = r * 1103515245 + 12345;
+        switch(i % 6) {
+            case 0:
+                xlog_info("wifi: rssi %d dBm, channel %u\n", -40 - (int)(r >> 27), (unsigned int)(r >> 8) % 13 + 1);
+                break;
+            case 1:
+                xlog_message("sensor: temperature %u.%u C, humidity %u%%\n", (unsigned int)(r >> 20) % 40,
+                             (unsigned int)(r >> 12) % 10, (unsigned int)(r >> 4) % 100);
+                break;
+            case 2:
+                xlog_warn("mqtt: publish %lu failed, retry in %u ms\n", i, (unsigned int)(r >> 22) * 10);
+                break;
+            case 3:
+                xlog_info("heap: free %u bytes, largest block %u bytes\n", 100000 + (unsigned int)(r >> 16),
+                          4096 + (unsigned int)(r >> 20));
+                break;
+            case 4:
+                xlog_error("uart: frame error at %08x\n", (unsigned int)r);
+                break;
+            default:
+                xlog_message("task: idle %u%%, switches %lu\n", (unsigned int)(r >> 25), i * 37);
+                break;
+        }
+        /* the console keeps up, the lines are not lost */
+        xlog_process();
+    }
+}
+
+static void bench_compress(const char *log, size_t len)
+{
+    uint32_t n = 0;
+
+    bench_out_len = 0;
+    xlog_lz_reset(&bench_lz);
+    for(size_t off = 0; off < len; off += n) {
+        n = (len - off < BENCH_CHUNK) ? (uint32_t)(len - off) : BENCH_CHUNK;
+        xlog_lz_write(&bench_lz, &log[off], n, bench_write);
+    }
+}
+
+static void bench_save(const char *path, const char *ext, const char *data, size_t len)
+{
+    char name[256];
+    FILE *f = NULL;
+
+    snprintf(name, sizeof(name), "%s.%s", path, ext);
+    f = fopen(name, "wb");
+    TEST_ASSERT(f);
+    TEST_ASSERT(fwrite(data, 1, len, f) == len);
+    fclose(f);
+}
+
+int main(int argc, char *argv[])
+{
+    double mb = 64, t = 0;
+    uint32_t rounds = 0;
+
+    if(argc > 1) {
+        mb = atof(argv[1]);
+    }
+    bench_capture();
+    /* no chunk may grow by more than its token, offset and run bytes */
+    bench_out_size = test_out_len * 2 + 1024;
+    bench_out = malloc(bench_out_size);
+    TEST_ASSERT(bench_out);
+    rounds = (uint32_t)(mb * 1e6 / test_out_len) + 1;
+    t = test_now();
+    for(uint32_t r = 0; r < rounds; ++r) {
+        bench_compress(test_out, test_out_len);
+    }
+    t = test_now() - t;
+    printf("xlog_lz_bench: %lu lines, %lu bytes to %lu, ratio %.2f, %.1f MB/s, window %u bytes\n",
+           (unsigned long)BENCH_LINES, (unsigned long)test_out_len, (unsigned long)bench_out_len,
+           (double)test_out_len / bench_out_len, rounds * (test_out_len / 1e6) / t,
+           1U << CONFIG_XLOG_LZ_WINDOW_SHIFT);
+    if(argc > 2) {
+        bench_save(argv[2], "log", test_out, test_out_len);
+        bench_save(argv[2], "lz", bench_out, bench_out_len);
+    }
+    free(bench_out);
+    free(test_out);
+    xlog_deinit();
+
+    return 0;
+}
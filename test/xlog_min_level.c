@@ -0,0 +1,93 @@
+/**
+ * @file test/xlog_min_level.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_min_level.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Lines continued after a level compiled out, built with CONFIG_XLOG_MIN_LEVEL
+ * set to 1(LOG_WARN). The continuation of a compiled out line must be dropped
+ * like the line, and must not be glued to the line shown before it; the
+ * continuation of a line shown must be printed with it.
+ *
+ * Usage: xlog_min_level
+ */
+
+/*---------- includes ----------*/
+#include "xlog_test.h"
+
+/*---------- function ----------*/
+int main(int argc, char *argv[])
+{
+    static const char expected[] = "shown and continued\nwarned\ntag shown and continued\nrate limited and continued\n";
+    char out[256];
+    size_t len = 0;
+    xlog_ops_t ops;
+
+    (void)argc;
+    (void)argv;
+    test_ops_init(&ops, 4096);
+    xlog_init(&ops);
+    xlog_hide_log_type(true);
+    xlog_set_log_level(LOG_INFO);
+    xlog_warn("shown");
+    xlog_cont(" and continued\n");
+    xlog_info("compiled out");
+    xlog_cont(", dropped\n");
+    xlog_message("compiled out");
+    xlog_cont(", dropped too\n");
+    xlog_warn("warned\n");
+    xlog_tag_info("test", "compiled out");
+    xlog_cont(", dropped\n");
+    xlog_tag_warn("test", "tag shown");
+    xlog_cont(" and continued\n");
+    xlog_tag_message("test", "compiled out");
+    xlog_cont(", dropped\n");
+    xlog_ratelimited_warn("rate limited");
+    xlog_cont(" and continued\n");
+    xlog_ratelimited_info("compiled out");
+    xlog_cont(", dropped\n");
+    xlog_ratelimited_tag_message("test", "compiled out");
+    xlog_cont(", dropped\n");
+    xlog_process();
+    /* the text of the lines, without their prefixes and tags */
+    for(const char *p = test_out, *end = test_out + test_out_len, *nl = NULL; p < end; p = nl + 1) {
+        nl = memchr(p, '\n', end - p);
+        TEST_ASSERT(nl);
+        p = __test_skip_color(p, nl);
+        if(*p == '[') {
+            p = memchr(p, ']', nl - p) + 1;
+        }
+        if(!strncmp(p, "(test)", 6)) {
+            p += 6;
+        }
+        TEST_ASSERT(len + (nl + 1 - p) < sizeof(out));
+        memcpy(&out[len], p, nl + 1 - p);
+        len += nl + 1 - p;
+    }
+    out[len] = '\0';
+    printf("xlog_min_level: %zu chars printed, expected %zu\n", len, sizeof(expected) - 1);
+    if(strcmp(out, expected)) {
+        fprintf(stderr, "printed:\n%s", out);
+    }
+    TEST_ASSERT(!strcmp(out, expected));
+    xlog_deinit();
+    free(test_out);
+
+    return 0;
+}
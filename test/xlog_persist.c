@@ -0,0 +1,145 @@
+/**
+ * @file test/xlog_persist.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_persist.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * The persistent log region with CONFIG_XLOG_PERSIST, mapped from a file
+ * by xlog_get_persist(). A child process logs and exits without cleaning
+ * up, like a boot ended by a reset, then xlog_init() must print the lines
+ * it left once more, the newest ones, in order, followed by the line
+ * telling how many they were. A second child logs again and the text of
+ * one of its lines is corrupted in the file: that line and the ones before
+ * it must not be printed, the ones after it must.
+ *
+ * Usage: xlog_persist
+ */
+
+/*---------- includes ----------*/
+#define _GNU_SOURCE                         /*<< memmem() */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "xlog_test.h"
+
+/*---------- macro ----------*/
+#define PERSIST_LINES                       (1000)
+#define PERSIST_CORRUPT                     (990)   /*<< line corrupted in the file */
+
+/*---------- function ----------*/
+/* Log the lines "T<id>-<n>-abc...z" in a process of their own, which ends
+ * without xlog_deinit().
+ */
+static void previous_boot(int id)
+{
+    xlog_ops_t ops;
+    pid_t pid = fork();
+    int status = 0;
+
+    TEST_ASSERT(pid >= 0);
+    if(!pid) {
+        test_ops_init(&ops, PERSIST_LINES * 64 + 4096);
+        ops.get_persist = xlog_get_persist;
+        xlog_init(&ops);
+        for(unsigned long i = 0; i < PERSIST_LINES; ++i) {
+            xlog_message("T%d-%07lu-" TEST_LINE_BODY "\n", id, i);
+        }
+        _exit(0);
+    }
+    TEST_ASSERT(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && !WEXITSTATUS(status));
+}
+
+/* Flip a char of the text of a line in the file of the persistent log region.
+ */
+static void corrupt(const char *line)
+{
+    struct stat st;
+    char *region = NULL, *p = NULL;
+    int fd = open(CONFIG_XLOG_PERSIST_FILE, O_RDWR);
+
+    TEST_ASSERT(fd >= 0 && !fstat(fd, &st));
+    region = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    TEST_ASSERT(region != MAP_FAILED);
+    p = memmem(region, st.st_size, line, strlen(line));
+    TEST_ASSERT(p);
+    p[strlen(line)] ^= 0x20;
+    munmap(region, st.st_size);
+    close(fd);
+}
+
+/* Initialize xlog on the persistent log region and check what it prints: the
+ * lines of producer id from first on up to the last one logged, and the count
+ * of the records restored.
+ * Returns the number of lines restored.
+ */
+static unsigned long restart(int id, long first)
+{
+    const char *p = NULL, *end = NULL, *nl = NULL;
+    unsigned long restored = 0, lines = 0, records = 0, n = 0;
+    long last = -1;
+    int i = 0;
+    char body[sizeof(TEST_LINE_BODY) + 1];
+    xlog_ops_t ops;
+
+    test_ops_init(&ops, PERSIST_LINES * 64 + 4096);
+    ops.get_persist = xlog_get_persist;
+    xlog_init(&ops);
+    xlog_process();
+    for(p = test_out, end = test_out + test_out_len; p < end && (nl = memchr(p, '\n', end - p)) != NULL; p = nl + 1) {
+        p = __test_skip_color(p, nl);
+        if(sscanf(p, "T%d-%lu-%27s", &i, &n, body) == 3 && i == id) {
+            TEST_ASSERT(!strcmp(body, TEST_LINE_BODY));
+            TEST_ASSERT(last < 0 || n == (unsigned long)last + 1);
+            TEST_ASSERT((long)n >= first);
+            last = n;
+            lines++;
+        } else if(sscanf(p, "xlog: %lu records restored", &records) == 1) {
+            restored++;
+        }
+    }
+    TEST_ASSERT(restored == 1);
+    TEST_ASSERT(last == PERSIST_LINES - 1);
+    /* the lines of the other producers restored are counted too */
+    TEST_ASSERT(lines && records >= lines);
+    free(test_out);
+    xlog_deinit();
+
+    return lines;
+}
+
+int main(int argc, char *argv[])
+{
+    char line[32];
+    unsigned long kept = 0, after = 0;
+
+    unlink(CONFIG_XLOG_PERSIST_FILE);
+    previous_boot(0);
+    kept = restart(0, 0);
+    previous_boot(1);
+    snprintf(line, sizeof(line), "T1-%07d-", PERSIST_CORRUPT);
+    corrupt(line);
+    after = restart(1, PERSIST_CORRUPT + 1);
+    TEST_ASSERT(after == PERSIST_LINES - PERSIST_CORRUPT - 1);
+    printf("xlog_persist: %lu lines restored, %lu after a corrupted one\n", kept, after);
+    unlink(CONFIG_XLOG_PERSIST_FILE);
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file test/xlog_print_func.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_print_func.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * The output functions changed after xlog_init(). The log starts with
+ * print_v() set, as the daemon task sets it, then xlog_set_print_func() and
+ * xlog_set_print_v_func() switch between both: every line must reach the
+ * function set last, and nothing else.
+ *
+ * Usage: xlog_print_func
+ */
+
+/*---------- includes ----------*/
+#include "xlog_test.h"
+
+/*---------- variable ----------*/
+static unsigned long print_calls, print_v_calls;
+
+/*---------- function ----------*/
+static void test_print_only(const char *str, uint32_t length)
+{
+    print_calls++;
+    test_print(str, length);
+}
+
+static void test_print_v(const xlog_iovec_t *iov, uint32_t count)
+{
+    print_v_calls++;
+    for(uint32_t i = 0; i < count; ++i) {
+        test_print(iov[i].base, iov[i].len);
+    }
+}
+
+/* Log a line and check it is printed, by print_v() when by_print_v is true.
+ */
+static void check_line(const char *text, bool by_print_v)
+{
+    unsigned long calls = by_print_v ? print_v_calls : print_calls;
+    unsigned long other = by_print_v ? print_calls : print_v_calls;
+    size_t len = test_out_len;
+
+    xlog_message("%s\n", text);
+    xlog_process();
+    TEST_ASSERT((by_print_v ? print_v_calls : print_calls) > calls);
+    TEST_ASSERT((by_print_v ? print_calls : print_v_calls) == other);
+    TEST_ASSERT(test_out_len - len > strlen(text) + 1);
+    TEST_ASSERT(!memcmp(&test_out[test_out_len - strlen(text) - 1], text, strlen(text)));
+}
+
+int main(int argc, char *argv[])
+{
+    xlog_ops_t ops;
+
+    (void)argc;
+    (void)argv;
+    test_ops_init(&ops, 4096);
+    ops.print = NULL;
+    ops.print_v = test_print_v;
+    xlog_init(&ops);
+    check_line("first by print_v", true);
+    TEST_ASSERT(xlog_set_print_func(test_print_only) == NULL);
+    check_line("second by print", false);
+    TEST_ASSERT(xlog_set_print_v_func(test_print_v) == NULL);
+    check_line("third by print_v", true);
+    TEST_ASSERT(xlog_set_print_v_func(NULL) == test_print_v);
+    check_line("fourth by print", false);
+    TEST_ASSERT(xlog_set_print_func(test_print) == test_print_only);
+    printf("xlog_print_func: print %lu calls, print_v %lu calls\n", print_calls, print_v_calls);
+    xlog_deinit();
+    free(test_out);
+
+    return 0;
+}
@@ -0,0 +1,181 @@
+/**
+ * @file test/xlog_print_v_bench.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_print_v_bench.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Throughput of the console writing to stdout, a write() per segment with
+ * print() against xlog_print_v() as print_v(), both into /dev/null. Then
+ * xlog_print_v() writes into a small pipe drained slowly by a thread while
+ * a timer interrupts the writes with a signal: whatever writev() leaves
+ * unwritten must be written again, every line must come out of the pipe
+ * once and whole.
+ *
+ * Usage: xlog_print_v_bench [lines]
+ */
+
+/*---------- includes ----------*/
+#define _GNU_SOURCE                         /*<< F_SETPIPE_SZ */
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "xlog_test.h"
+
+/*---------- variable ----------*/
+static unsigned long lines = 200000;
+static unsigned long bench_bytes;
+static volatile sig_atomic_t bench_signals;
+static int bench_pipe[2];
+
+/*---------- function ----------*/
+static void bench_write(const char *str, uint32_t length)
+{
+    TEST_ASSERT(write(STDOUT_FILENO, str, length) == (ssize_t)length);
+    bench_bytes += length;
+}
+
+static void bench_print_v(const xlog_iovec_t *iov, uint32_t count)
+{
+    for(uint32_t i = 0; i < count; ++i) {
+        bench_bytes += iov[i].len;
+    }
+    xlog_print_v(iov, count);
+}
+
+static void bench_alarm(int sig)
+{
+    bench_signals++;
+}
+
+/* Log the lines with the console writing to stdout by print() or print_v().
+ * Returns the seconds taken.
+ */
+static double bench_run(bool vectored)
+{
+    xlog_ops_t ops;
+    double t = 0;
+
+    test_ops_init(&ops, 64);
+    ops.print = vectored ? NULL : bench_write;
+    ops.print_v = vectored ? bench_print_v : NULL;
+    xlog_init(&ops);
+    t = test_now();
+    for(unsigned long i = 0; i < lines; ++i) {
+        xlog_message("T0-%07lu-" TEST_LINE_BODY "\n", i);
+        /* the console keeps up, the lines are not lost */
+        if((i & 0xF) == 0xF) {
+            xlog_process();
+        }
+    }
+    xlog_process();
+    t = test_now() - t;
+    xlog_deinit();
+    free(test_out);
+
+    return t;
+}
+
+/* Read the pipe slowly into the captured output, so that the writes block and
+ * get interrupted.
+ */
+static void *bench_reader(void *arg)
+{
+    char chunk[256];
+    ssize_t n = 0;
+
+    while((n = read(bench_pipe[0], chunk, sizeof(chunk))) != 0) {
+        if(n < 0) {
+            TEST_ASSERT(errno == EINTR);
+            continue;
+        }
+        TEST_ASSERT(test_out_len + n <= test_out_size);
+        memcpy(&test_out[test_out_len], chunk, n);
+        test_out_len += n;
+        sched_yield();
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    struct sigaction sa;
+    struct itimerval timer = {{0, 200}, {0, 200}};
+    struct test_result res;
+    sigset_t alarm;
+    pthread_t reader;
+    xlog_ops_t ops;
+    double print = 0, print_v = 0;
+    int out = dup(STDOUT_FILENO), null = open("/dev/null", O_WRONLY);
+
+    if(argc > 1) {
+        lines = strtoul(argv[1], NULL, 0);
+    }
+    TEST_ASSERT(out >= 0 && null >= 0);
+    fflush(stdout);
+    dup2(null, STDOUT_FILENO);
+    print = bench_run(false);
+    bench_bytes = 0;
+    print_v = bench_run(true);
+    dup2(out, STDOUT_FILENO);
+    printf("xlog_print_v_bench: %lu lines, print() %.2f M lines/s %.1f MB/s, print_v() %.2f M lines/s %.1f MB/s, x%.1f\n",
+           lines, lines / print / 1e6, bench_bytes / print / 1e6, lines / print_v / 1e6, bench_bytes / print_v / 1e6,
+           print / print_v);
+
+    /* the reader does not take the signals, the writer does */
+    TEST_ASSERT(!pipe(bench_pipe));
+    fcntl(bench_pipe[1], F_SETPIPE_SZ, 4096);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = bench_alarm;
+    TEST_ASSERT(!sigaction(SIGALRM, &sa, NULL));
+    sigemptyset(&alarm);
+    sigaddset(&alarm, SIGALRM);
+    test_ops_init(&ops, lines * 64 + 4096);
+    ops.print_v = xlog_print_v;
+    xlog_init(&ops);
+    pthread_sigmask(SIG_BLOCK, &alarm, NULL);
+    TEST_ASSERT(!pthread_create(&reader, NULL, bench_reader, NULL));
+    pthread_sigmask(SIG_UNBLOCK, &alarm, NULL);
+    fflush(stdout);
+    dup2(bench_pipe[1], STDOUT_FILENO);
+    close(bench_pipe[1]);
+    setitimer(ITIMER_REAL, &timer, NULL);
+    for(unsigned long i = 0; i < lines; ++i) {
+        xlog_message("T0-%07lu-" TEST_LINE_BODY "\n", i);
+        if((i & 0xF) == 0xF) {
+            xlog_process();
+        }
+    }
+    xlog_process();
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_REAL, &timer, NULL);
+    /* the write end is closed, the reader sees the end of the pipe */
+    dup2(out, STDOUT_FILENO);
+    pthread_join(reader, NULL);
+    test_check(1, lines, &res);
+    printf("xlog_print_v_bench: %lu lines through a pipe, %lu signals, lines %lu, gaps %lu, bad %lu\n", lines,
+           (unsigned long)bench_signals, res.lines, res.gaps, res.bad);
+    TEST_ASSERT(res.lines == lines && !res.gaps && !res.bad && !res.lost);
+    xlog_deinit();
+    free(test_out);
+
+    return 0;
+}
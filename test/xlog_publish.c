@@ -0,0 +1,154 @@
+/**
+ * @file test/xlog_publish.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_publish.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Lockless publishing with producers which keep overlapping. Two threads take
+ * turns: each one commits the record it reserved, then reserves its next one
+ * before the other one commits, so a record of the other thread is always in
+ * flight when a record is committed and the reserved range never drains.
+ * Every record reserved before the one committed is committed by then, so it
+ * must be published at once: log_end right past it, its sequence number the
+ * next one and the line printed by the console before the turn is passed on.
+ * xlog.c is built in so that the reservation and the commit can be taken
+ * apart.
+ *
+ * Usage: xlog_publish [records per thread]
+ */
+
+/*---------- includes ----------*/
+#include "xlog.c"
+#include "xlog_test.h"
+#include <sched.h>
+
+/*---------- variable ----------*/
+static unsigned long records_per_thread = 20000;
+static uint32_t turn;                               /*<< thread turn & 1 acts next */
+static unsigned long late;                          /*<< records not published when committed */
+
+/*---------- function ----------*/
+static void wait_turn(uint32_t t)
+{
+    while(__atomic_load_n(&turn, __ATOMIC_ACQUIRE) != t) {
+        sched_yield();
+    }
+}
+
+static void pass_turn(uint32_t t)
+{
+    __atomic_store_n(&turn, t + 1, __ATOMIC_RELEASE);
+}
+
+static int render(char *text, int id, unsigned long i)
+{
+    return sprintf(text, "T%d-%lu-" TEST_LINE_BODY "\n", id, i);
+}
+
+static uint32_t reserve(int id, unsigned long i)
+{
+    char text[64];
+    uint32_t off = 0;
+
+    TEST_ASSERT(_log_reserve(sizeof(struct log_record) + render(text, id, i), &off));
+    _log_first_advance(off + sizeof(struct log_record) + render(text, id, i));
+
+    return off;
+}
+
+/* Commit the record reserved at off the way __log_store() does, and check the
+ * reader sees it right away.
+ */
+static void commit(uint32_t off, int id, unsigned long i)
+{
+    struct log_record rec;
+    char text[64];
+    int len = render(text, id, i);
+    uint64_t seq = log_seq;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.level = 1;
+    rec.len = len;
+    rec.tag = LOG_TAG_NONE;
+    _log_copy(off + sizeof(rec), text, len);
+    _log_copy(off, (const char *)&rec, sizeof(rec));
+    __atomic_store_n(&LOG_MARK(off), true, __ATOMIC_RELEASE);
+    _log_publish();
+    _flush_console();
+    _log_read(off, &rec, sizeof(rec));
+    if(__atomic_load_n(&log_end, __ATOMIC_ACQUIRE) != off + sizeof(rec) + len || rec.seq != seq) {
+        late++;
+    }
+    pthread_mutex_lock(&test_buf_mutex);
+    if(test_out_len < (size_t)len || memcmp(test_out + test_out_len - len, text, len)) {
+        if(late++ < 5) {
+            fprintf(stderr, "not printed when committed: %.*s\n", len - 1, text);
+        }
+    }
+    pthread_mutex_unlock(&test_buf_mutex);
+}
+
+static void *producer(void *arg)
+{
+    int id = (int)(intptr_t)arg;
+    uint32_t t = id, off = 0;
+
+    wait_turn(t);
+    off = reserve(id, 0);
+    pass_turn(t);
+    for(unsigned long i = 0; i < records_per_thread; ++i) {
+        t += 2;
+        wait_turn(t);
+        commit(off, id, i);
+        if(i + 1 < records_per_thread) {
+            off = reserve(id, i + 1);
+        }
+        pass_turn(t);
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t threads[2];
+    struct test_result res;
+    xlog_ops_t ops;
+
+    if(argc > 1) {
+        records_per_thread = strtoul(argv[1], NULL, 0);
+    }
+    test_ops_init(&ops, records_per_thread * 2 * 64 + 4096);
+    xlog_init(&ops);
+    for(int i = 0; i < 2; ++i) {
+        TEST_ASSERT(!pthread_create(&threads[i], NULL, producer, (void *)(intptr_t)i));
+    }
+    for(int i = 0; i < 2; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    test_check(2, records_per_thread, &res);
+    printf("xlog_publish: %lu lines, lost %lu, gaps %lu, bad %lu, %lu not published when committed\n",
+           res.lines, res.lost, res.gaps, res.bad, late);
+    TEST_ASSERT(!late && log_seq == records_per_thread * 2);
+    TEST_ASSERT(res.lines == records_per_thread * 2 && !res.lost && !res.gaps && !res.bad);
+    xlog_deinit();
+    free(test_out);
+
+    return 0;
+}
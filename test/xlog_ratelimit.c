@@ -0,0 +1,248 @@
+/**
+ * @file test/xlog_ratelimit.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_ratelimit.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * The token buckets of the xlog_ratelimited_* call sites, on a clock moved
+ * by the test. A burst lets CONFIG_XLOG_RATELIMIT_BURST lines through, a
+ * step of the interval earns one line back and the first line logged after
+ * some were suppressed is preceded by their count. Lines above the log level
+ * take no token and lines continuing a suppressed one are suppressed too.
+ * Threads sharing a call site while the clock moves take every token earned
+ * once, and every line is either logged or counted as suppressed.
+ * Then the cost of a suppressed call is measured, in cycles where there is
+ * a cycle counter, against a call filtered by the log level.
+ *
+ * Usage: xlog_ratelimit [calls measured]
+ */
+
+/*---------- includes ----------*/
+#include <stdarg.h>
+#include "xlog_test.h"
+
+/*---------- macro ----------*/
+#define RATELIMIT_STEP_US                   (CONFIG_XLOG_RATELIMIT_INTERVAL * 1000UL / CONFIG_XLOG_RATELIMIT_BURST)
+#define SHARED_THREADS                      (4)
+#define SHARED_CALLS                        (200000)
+#define SHARED_STEP_CALLS                   (1000)
+#if defined(__x86_64__) || defined(__i386__)
+#define TEST_CYCLES_UNIT                    "cycles"
+#else
+#define TEST_CYCLES_UNIT                    "ns"
+#endif
+
+/*---------- variable ----------*/
+static uint64_t test_clock_us = 1000000;
+static const char *test_next;                       /*<< next line of the captured output to be checked */
+
+/*---------- function ----------*/
+static void test_get_timestamp_us(uint64_t *us)
+{
+    *us = __atomic_load_n(&test_clock_us, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t test_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return (uint64_t)(test_now() * 1e9);
+#endif
+}
+
+/* Check the lines printed since the last call, one line of text per argument,
+ * the list ends with NULL.
+ */
+static void expect(const char *line, ...)
+{
+    const char *end = test_out + test_out_len, *nl = NULL, *p = NULL;
+    va_list args;
+
+    xlog_process();
+    va_start(args, line);
+    for(; line; line = va_arg(args, const char *)) {
+        nl = memchr(test_next, '\n', end - test_next);
+        TEST_ASSERT(nl);
+        p = __test_skip_color(test_next, nl);
+        if((size_t)(nl - p) != strlen(line) || memcmp(p, line, nl - p)) {
+            fprintf(stderr, "expected \"%s\", got \"%.*s\"\n", line, (int)(nl - p), p);
+            exit(1);
+        }
+        test_next = nl + 1;
+    }
+    va_end(args);
+    if(test_next != end) {
+        fprintf(stderr, "unexpected \"%.*s\"\n", (int)(end - test_next), test_next);
+        exit(1);
+    }
+}
+
+static void burst(unsigned long i)
+{
+    xlog_ratelimited_message("R-%lu\n", i);
+}
+
+static void info(unsigned long i)
+{
+    xlog_ratelimited_info("I-%lu\n", i);
+}
+
+static void continued(unsigned long i)
+{
+    xlog_ratelimited_message("C-%lu", i);
+    xlog_cont("-end\n");
+}
+
+static void shared(unsigned long i)
+{
+    xlog_ratelimited_message("S-%lu\n", i);
+}
+
+/* The threads step the clock in turn, a line is earned back every
+ * SHARED_STEP_CALLS calls of a thread.
+ */
+static void *shared_thread(void *arg)
+{
+    for(unsigned long i = 0; i < SHARED_CALLS; ++i) {
+        if(i % SHARED_STEP_CALLS == (uintptr_t)arg) {
+            __atomic_fetch_add(&test_clock_us, RATELIMIT_STEP_US / SHARED_THREADS, __ATOMIC_RELAXED);
+        }
+        shared(i);
+    }
+
+    return NULL;
+}
+
+static void check_shared(void)
+{
+    const char *p = test_next, *end = NULL, *nl = NULL;
+    unsigned long logged = 0, reported = 0, n = 0, steps = SHARED_CALLS / SHARED_STEP_CALLS;
+    pthread_t threads[SHARED_THREADS];
+
+    for(uintptr_t i = 0; i < SHARED_THREADS; ++i) {
+        TEST_ASSERT(!pthread_create(&threads[i], NULL, shared_thread, (void *)i));
+    }
+    for(int i = 0; i < SHARED_THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    /* the last one reports what is left */
+    test_clock_us += CONFIG_XLOG_RATELIMIT_INTERVAL * 1000UL;
+    shared(0);
+    xlog_process();
+    for(end = test_out + test_out_len; p < end && (nl = memchr(p, '\n', end - p)) != NULL; p = nl + 1) {
+        p = __test_skip_color(p, nl);
+        if(*p == 'S') {
+            logged++;
+        } else if(sscanf(p, "xlog: %lu lines suppressed in shared()", &n) == 1) {
+            reported += n;
+        }
+    }
+    test_next = end;
+    printf("xlog_ratelimit: %d threads, %lu lines logged, %lu suppressed, %lu earned back\n", SHARED_THREADS, logged,
+           reported, steps);
+    TEST_ASSERT(logged + reported == SHARED_THREADS * SHARED_CALLS + 1);
+    TEST_ASSERT(logged <= CONFIG_XLOG_RATELIMIT_BURST + steps + 1);
+}
+
+static void check_burst(void)
+{
+    for(unsigned long i = 0; i < 100; ++i) {
+        burst(i);
+    }
+    expect("R-0", "R-1", "R-2", "R-3", "R-4", "R-5", "R-6", "R-7", "R-8", "R-9", NULL);
+    /* a step earns one line back */
+    test_clock_us += RATELIMIT_STEP_US;
+    for(unsigned long i = 100; i < 105; ++i) {
+        burst(i);
+    }
+    expect("xlog: 90 lines suppressed in burst()", "R-100", NULL);
+    /* the whole interval fills the bucket, not more */
+    test_clock_us += 10 * CONFIG_XLOG_RATELIMIT_INTERVAL * 1000UL;
+    for(unsigned long i = 105; i < 200; ++i) {
+        burst(i);
+    }
+    expect("xlog: 4 lines suppressed in burst()", "R-105", "R-106", "R-107", "R-108", "R-109", "R-110", "R-111",
+           "R-112", "R-113", "R-114", NULL);
+}
+
+static void check_filtered(void)
+{
+    TEST_ASSERT(xlog_set_log_level(LOG_WARN));
+    for(unsigned long i = 0; i < 100; ++i) {
+        info(i);
+    }
+    expect(NULL);
+    /* the bucket is still full */
+    TEST_ASSERT(xlog_set_log_level(LOG_INFO));
+    for(unsigned long i = 100; i < 120; ++i) {
+        info(i);
+    }
+    expect("I-100", "I-101", "I-102", "I-103", "I-104", "I-105", "I-106", "I-107", "I-108", "I-109", NULL);
+}
+
+static void check_continued(void)
+{
+    for(unsigned long i = 0; i < 100; ++i) {
+        continued(i);
+    }
+    expect("C-0-end", "C-1-end", "C-2-end", "C-3-end", "C-4-end", "C-5-end", "C-6-end", "C-7-end", "C-8-end",
+           "C-9-end", NULL);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long calls = 10000000;
+    uint64_t suppressed = 0, filtered = 0;
+    double t = 0;
+    xlog_ops_t ops;
+
+    if(argc > 1) {
+        calls = strtoul(argv[1], NULL, 0);
+    }
+    test_ops_init(&ops, 1 << 20);
+    ops.get_timestamp_us = test_get_timestamp_us;
+    xlog_init(&ops);
+    test_next = test_out;
+    check_shared();
+    check_burst();
+    check_filtered();
+    check_continued();
+    /* the bucket of burst() is empty and the clock stands still */
+    t = test_now();
+    suppressed = test_cycles();
+    for(unsigned long i = 0; i < calls; ++i) {
+        burst(i);
+    }
+    suppressed = test_cycles() - suppressed;
+    t = test_now() - t;
+    TEST_ASSERT(xlog_set_log_level(LOG_WARN));
+    filtered = test_cycles();
+    for(unsigned long i = 0; i < calls; ++i) {
+        xlog_info("I-%lu\n", i);
+    }
+    filtered = test_cycles() - filtered;
+    expect(NULL);
+    printf("xlog_ratelimit: suppressed call %.1f " TEST_CYCLES_UNIT "(%.1f ns), filtered call %.1f\n",
+           (double)suppressed / calls, t / calls * 1e9, (double)filtered / calls);
+    free(test_out);
+    xlog_deinit();
+
+    return 0;
+}
@@ -0,0 +1,214 @@
+/**
+ * @file test/xlog_read.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_read.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Copies of the log buffer by xlog_read(). The lines kept are read a few
+ * at a time, resuming from the sequence number returned, then more lines
+ * are read from there on. Then far more lines are logged than the buffer
+ * holds and the reader must be told how many it missed. At last producers
+ * log from threads while a reader copies the history over and over from
+ * its sequence number: every line copied must be whole and every line
+ * missing counted by the "N lines lost" markers. Copies of the whole
+ * history taken meanwhile must hold whole lines in order.
+ *
+ * Usage: xlog_read [producers [lines per producer]]
+ */
+
+/*---------- includes ----------*/
+#include "xlog_test.h"
+
+/*---------- macro ----------*/
+#define READ_FIRST                          (50)
+#define READ_MORE                           (10)
+#define READ_OVERWRITE                      (1000)  /*<< lines logged past the reader, far more than the buffer holds */
+#define READ_HISTORY_SIZE                   (16384) /*<< more than the whole log buffer as printed */
+
+/*---------- variable ----------*/
+static int producers = 4;
+static unsigned long lines_per_producer = 20000;
+static volatile bool producing = true;
+static char *copy;
+static size_t copy_len, copy_size;
+static unsigned long histories;
+static uint64_t history_seq;                        /*<< First line logged by the producers */
+
+/*---------- function ----------*/
+/* Read the lines from *seq on, len chars at most at a time, and append them
+ * to the copy.
+ * Returns the number of chars read.
+ */
+static size_t read_all(uint64_t *seq, uint32_t len)
+{
+    uint32_t n = 0;
+    size_t total = 0;
+
+    do {
+        TEST_ASSERT(copy_len + len <= copy_size);
+        n = xlog_read(seq, &copy[copy_len], len);
+        copy_len += n;
+        total += n;
+    } while(n);
+
+    return total;
+}
+
+static void log_lines(unsigned long from, unsigned long to)
+{
+    for(unsigned long i = from; i < to; ++i) {
+        xlog_message("T0-%07lu-" TEST_LINE_BODY "\n", i);
+        if((i & 0xF) == 0xF) {
+            xlog_process();
+        }
+    }
+    xlog_process();
+}
+
+static void *producer(void *arg)
+{
+    int id = (int)(intptr_t)arg;
+
+    for(unsigned long i = 0; i < lines_per_producer; ++i) {
+        xlog_message("T%d-%07lu-" TEST_LINE_BODY "\n", id, i);
+        if((i & 0xF) == 0xF) {
+            xlog_process();
+        }
+    }
+
+    return NULL;
+}
+
+static void *reader(void *arg)
+{
+    static char history[READ_HISTORY_SIZE];
+    struct test_result res;
+    uint64_t *seq = arg, from = 0;
+    uint32_t n = 0;
+
+    while(producing) {
+        read_all(seq, 512);
+        /* the whole history in one call, from the first line of the producers on as
+         * the lines of the checks before would be out of order with theirs
+         */
+        from = history_seq;
+        n = xlog_read(&from, history, sizeof(history));
+        TEST_ASSERT(n < sizeof(history));
+        test_check_out(history, n, producers, lines_per_producer, &res);
+        TEST_ASSERT(!res.bad);
+        histories++;
+        sched_yield();
+    }
+
+    return NULL;
+}
+
+/* Read back the lines kept a few at a time, then the lines logged after them.
+ * Returns the sequence number to resume from.
+ */
+static uint64_t check_resume(void)
+{
+    struct test_result res;
+    uint64_t seq = 0;
+
+    log_lines(0, READ_FIRST);
+    /* two or three lines a call */
+    read_all(&seq, 128);
+    TEST_ASSERT(seq == READ_FIRST);
+    test_check_out(copy, copy_len, 1, READ_FIRST, &res);
+    TEST_ASSERT(res.lines == READ_FIRST && !res.lost && !res.gaps && !res.bad);
+    log_lines(READ_FIRST, READ_FIRST + READ_MORE);
+    read_all(&seq, 4096);
+    TEST_ASSERT(seq == READ_FIRST + READ_MORE);
+    test_check_out(copy, copy_len, 1, READ_FIRST + READ_MORE, &res);
+    TEST_ASSERT(res.lines == READ_FIRST + READ_MORE && !res.lost && !res.gaps && !res.bad);
+    /* nothing new */
+    TEST_ASSERT(!read_all(&seq, 4096) && seq == READ_FIRST + READ_MORE);
+
+    return seq;
+}
+
+/* Log past the reader, which must be told how many lines it missed.
+ */
+static void check_overwrite(uint64_t seq)
+{
+    struct test_result res;
+    unsigned long total = READ_FIRST + READ_MORE + READ_OVERWRITE;
+
+    log_lines(READ_FIRST + READ_MORE, total);
+    read_all(&seq, 4096);
+    TEST_ASSERT(seq == total);
+    test_check_out(copy, copy_len, 1, total, &res);
+    printf("xlog_read: %lu lines logged past the reader, %lu read, %lu reported lost\n",
+           (unsigned long)READ_OVERWRITE, res.lines - READ_FIRST - READ_MORE, res.lost);
+    TEST_ASSERT(res.lost && res.lost == res.gaps && res.lines + res.lost == total && !res.bad);
+}
+
+/* Copy the history from threads logging at the same time.
+ */
+static void check_concurrent(void)
+{
+    pthread_t threads[TEST_PRODUCER_MAX], copier;
+    struct test_result res;
+    uint64_t seq = 0;
+
+    /* the lines of the checks before are not wanted */
+    read_all(&seq, 4096);
+    copy_len = 0;
+    history_seq = seq;
+    TEST_ASSERT(!pthread_create(&copier, NULL, reader, &seq));
+    for(int i = 0; i < producers; ++i) {
+        TEST_ASSERT(!pthread_create(&threads[i], NULL, producer, (void *)(intptr_t)i));
+    }
+    for(int i = 0; i < producers; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    producing = false;
+    pthread_join(copier, NULL);
+    read_all(&seq, 4096);
+    test_check_out(copy, copy_len, producers, lines_per_producer, &res);
+    printf("xlog_read: %d producers, %lu lines copied, lost %lu, gaps %lu, bad %lu, %lu whole histories\n",
+           producers, res.lines, res.lost, res.gaps, res.bad, histories);
+    TEST_ASSERT(res.lines && res.lost == res.gaps && !res.bad);
+}
+
+int main(int argc, char *argv[])
+{
+    xlog_ops_t ops;
+
+    if(argc > 1) {
+        producers = atoi(argv[1]);
+    }
+    if(argc > 2) {
+        lines_per_producer = strtoul(argv[2], NULL, 0);
+    }
+    TEST_ASSERT(producers > 0 && producers <= TEST_PRODUCER_MAX);
+    copy_size = (producers * lines_per_producer + READ_FIRST + READ_MORE + READ_OVERWRITE) * 64 + 8192;
+    copy = malloc(copy_size);
+    TEST_ASSERT(copy);
+    test_ops_init(&ops, copy_size);
+    xlog_init(&ops);
+    check_overwrite(check_resume());
+    check_concurrent();
+    xlog_deinit();
+    free(test_out);
+    free(copy);
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+/**
+ * @file test/xlog_sinks.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_sinks.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * A fast sink and a slow one next to the console. The fast sink is written
+ * by xlog_process(), which the producer calls often enough for nothing to be
+ * lost. The slow sink is a manual one, flushed by a thread of its own, and
+ * every write of it blocks for a while, so it falls behind by more than the
+ * log buffer. The producer and the fast sink must not wait for it: the fast
+ * sink gets every line, the slow one loses lines and is told how many by the
+ * "N lines lost" markers, and every line it gets is whole.
+ *
+ * Usage: xlog_sinks [lines [microseconds per slow write]]
+ */
+
+/*---------- includes ----------*/
+#include <unistd.h>
+#include "xlog_test.h"
+
+/*---------- type define ----------*/
+struct sink_out {
+    char *buf;
+    size_t len, size;
+    unsigned long writes;
+};
+
+/*---------- variable ----------*/
+static unsigned long lines = 20000;
+static unsigned int slow_us = 2000;
+static struct sink_out fast, slow;
+static int32_t slow_id;
+static volatile bool producing = true;
+
+/*---------- function ----------*/
+static void sink_put(struct sink_out *out, const char *str, uint32_t length)
+{
+    TEST_ASSERT(out->len + length <= out->size);
+    memcpy(&out->buf[out->len], str, length);
+    out->len += length;
+    out->writes++;
+}
+
+static void fast_write(const char *str, uint32_t length)
+{
+    sink_put(&fast, str, length);
+}
+
+static void slow_write(const char *str, uint32_t length)
+{
+    usleep(slow_us);
+    sink_put(&slow, str, length);
+}
+
+static void *slow_flusher(void *arg)
+{
+    while(producing) {
+        xlog_flush_sink(slow_id);
+    }
+    xlog_flush_sink(slow_id);
+
+    return NULL;
+}
+
+static void sink_init(struct sink_out *out, size_t size)
+{
+    out->buf = malloc(size);
+    TEST_ASSERT(out->buf);
+    out->len = 0;
+    out->size = size;
+    out->writes = 0;
+}
+
+int main(int argc, char *argv[])
+{
+    xlog_sink_t sink;
+    xlog_ops_t ops;
+    pthread_t flusher;
+    struct test_result res;
+    double t = 0;
+
+    if(argc > 1) {
+        lines = strtoul(argv[1], NULL, 0);
+    }
+    if(argc > 2) {
+        slow_us = strtoul(argv[2], NULL, 0);
+    }
+    test_ops_init(&ops, lines * 64 + 4096);
+    xlog_init(&ops);
+    sink_init(&fast, lines * 64 + 4096);
+    sink_init(&slow, lines * 64 + 4096);
+    memset(&sink, 0, sizeof(sink));
+    sink.write = fast_write;
+    TEST_ASSERT(xlog_add_sink(&sink) >= 0);
+    sink.write = slow_write;
+    sink.manual = true;
+    slow_id = xlog_add_sink(&sink);
+    TEST_ASSERT(slow_id >= 0);
+    TEST_ASSERT(!pthread_create(&flusher, NULL, slow_flusher, NULL));
+    t = test_now();
+    for(unsigned long i = 0; i < lines; ++i) {
+        xlog_message("T0-%07lu-" TEST_LINE_BODY "\n", i);
+        if((i & 0xF) == 0xF) {
+            xlog_process();
+        }
+    }
+    xlog_process();
+    t = test_now() - t;
+    producing = false;
+    pthread_join(flusher, NULL);
+
+    test_check(1, lines, &res);
+    printf("xlog_sinks: %lu lines in %.3f s, console %lu lines lost %lu\n", lines, t, res.lines, res.lost);
+    TEST_ASSERT(res.lines == lines && !res.gaps && !res.bad);
+    test_check_out(fast.buf, fast.len, 1, lines, &res);
+    printf("xlog_sinks: fast sink %lu lines in %lu writes, lost %lu, bad %lu\n", res.lines, fast.writes, res.lost,
+           res.bad);
+    TEST_ASSERT(res.lines == lines && !res.lost && !res.gaps && !res.bad);
+    test_check_out(slow.buf, slow.len, 1, lines, &res);
+    printf("xlog_sinks: slow sink %lu lines in %lu writes, lost %lu, gaps %lu, bad %lu\n", res.lines, slow.writes,
+           res.lost, res.gaps, res.bad);
+    TEST_ASSERT(res.lost && res.lost == res.gaps && !res.bad);
+    xlog_deinit();
+    free(fast.buf);
+    free(slow.buf);
+    free(test_out);
+
+    return 0;
+}
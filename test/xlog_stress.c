@@ -0,0 +1,86 @@
+/**
+ * @file test/xlog_stress.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_stress.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Producers logging from several threads at once. Every line printed must
+ * be whole and in the order of its producer, and every line missing must
+ * be told by a "N lines lost" marker, and no more than 1% may be lost. The
+ * throughput of the lines printed is printed.
+ *
+ * Usage: xlog_stress [producers] [lines per producer]
+ */
+
+/*---------- includes ----------*/
+#include "xlog_test.h"
+
+/*---------- variable ----------*/
+static unsigned long lines_per_producer = 50000;
+
+/*---------- function ----------*/
+static void *producer(void *arg)
+{
+    int id = (int)(long)arg;
+
+    for(unsigned long i = 0; i < lines_per_producer; ++i) {
+        xlog_message("T%d-%07lu-" TEST_LINE_BODY "\n", id, i);
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t threads[TEST_PRODUCER_MAX];
+    struct test_result res;
+    xlog_ops_t ops;
+    int producers = 4;
+    double t = 0;
+
+    if(argc > 1) {
+        producers = atoi(argv[1]);
+    }
+    if(argc > 2) {
+        lines_per_producer = strtoul(argv[2], NULL, 0);
+    }
+    TEST_ASSERT(producers > 0 && producers <= TEST_PRODUCER_MAX);
+    test_ops_init(&ops, (size_t)producers * lines_per_producer * 64 + 4096);
+    xlog_init(&ops);
+    t = test_now();
+    for(long i = 0; i < producers; ++i) {
+        TEST_ASSERT(!pthread_create(&threads[i], NULL, producer, (void *)i));
+    }
+    for(int i = 0; i < producers; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    t = test_now() - t;
+    xlog_process();
+    test_check(producers, lines_per_producer, &res);
+    /* lines dropped are cheap, only the lines printed count */
+    printf("xlog_stress: %d producers, %.0f lines/s printed(%.0f logged), printed %lu, lost %lu, missing %lu, bad %lu\n",
+           producers, res.lines / t, producers * lines_per_producer / t, res.lines, res.lost, res.gaps, res.bad);
+    TEST_ASSERT(!res.bad);
+    TEST_ASSERT(res.gaps == res.lost);
+    /* a producer waits for room, lines are only lost when that takes too long */
+    TEST_ASSERT(res.lost * 100 <= producers * lines_per_producer);
+    xlog_deinit();
+
+    return 0;
+}
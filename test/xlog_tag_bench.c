@@ -0,0 +1,110 @@
+/**
+ * @file test/xlog_tag_bench.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_tag_bench.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Time taken by a line filtered out before it is formatted: a tagged line
+ * below the level of its tag, and an untagged line below the console log
+ * level, from one thread and then from several at once, which share the
+ * state xlog_tag_enabled() keeps for the continued lines. Nothing may be
+ * printed.
+ *
+ * Usage: xlog_tag_bench [threads] [calls per thread]
+ */
+
+/*---------- includes ----------*/
+#include "xlog_test.h"
+
+/*---------- variable ----------*/
+static unsigned long calls = 10000000;
+static volatile unsigned long sink;
+
+/*---------- function ----------*/
+static void *tagged(void *arg)
+{
+    unsigned long n = 0;
+
+    for(unsigned long i = 0; i < calls; ++i) {
+        n += xlog_tag_info("bench", "rssi %d, channel %u, heap %lu\n", -(int)(i & 63), (unsigned int)(i % 13), i);
+    }
+    sink = n;
+
+    return NULL;
+}
+
+static void *untagged(void *arg)
+{
+    unsigned long n = 0;
+
+    for(unsigned long i = 0; i < calls; ++i) {
+        n += xlog_info("rssi %d, channel %u, heap %lu\n", -(int)(i & 63), (unsigned int)(i % 13), i);
+    }
+    sink = n;
+
+    return NULL;
+}
+
+/* Returns the time of a call in ns, with all the threads calling at once.
+ */
+static double run(void *(*func)(void *), int threads)
+{
+    pthread_t tid[TEST_PRODUCER_MAX];
+    double t = test_now();
+
+    for(int i = 0; i < threads; ++i) {
+        TEST_ASSERT(!pthread_create(&tid[i], NULL, func, NULL));
+    }
+    for(int i = 0; i < threads; ++i) {
+        pthread_join(tid[i], NULL);
+    }
+
+    return (test_now() - t) * 1e9 / calls;
+}
+
+int main(int argc, char *argv[])
+{
+    double tag1 = 0, plain1 = 0, tagn = 0, plainn = 0;
+    xlog_ops_t ops;
+    int threads = 4;
+
+    if(argc > 1) {
+        threads = atoi(argv[1]);
+    }
+    if(argc > 2) {
+        calls = strtoul(argv[2], NULL, 0);
+    }
+    TEST_ASSERT(threads > 0 && threads <= TEST_PRODUCER_MAX);
+    test_ops_init(&ops, 4096);
+    xlog_init(&ops);
+    /* the tag is shown up to LOG_ERROR, the console up to LOG_MESSAGE */
+    TEST_ASSERT(xlog_set_log_level(LOG_MESSAGE));
+    TEST_ASSERT(xlog_set_tag_level("bench", LOG_ERROR));
+    tag1 = run(tagged, 1);
+    plain1 = run(untagged, 1);
+    tagn = run(tagged, threads);
+    plainn = run(untagged, threads);
+    TEST_ASSERT(!test_out_len);
+    printf("xlog_tag_bench: filtered out, tagged %.1f ns/call, untagged %.1f ns/call, "
+           "%d threads at once %.1f and %.1f ns/call overall\n", tag1, plain1, threads, tagn / threads,
+           plainn / threads);
+    xlog_deinit();
+
+    return 0;
+}
@@ -0,0 +1,181 @@
+/**
+ * @file test/xlog_test.h
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_test.h is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * Host harness of the xlog tests: pthread ops, a console capturing what
+ * is printed and a checker of the captured lines.
+ */
+#ifndef __XLOG_TEST_H
+#define __XLOG_TEST_H
+
+/*---------- includes ----------*/
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include "test.h"
+#include "xlog.h"
+
+/*---------- macro ----------*/
+#define TEST_PRODUCER_MAX                   (16)
+#define TEST_LINE_BODY                      "abcdefghijklmnopqrstuvwxyz"
+
+/*---------- type define ----------*/
+struct test_result {
+    unsigned long lines;                            /*<< lines of the producers printed */
+    unsigned long lost;                             /*<< sum of the "N lines lost" markers */
+    unsigned long gaps;                             /*<< lines of the producers missing */
+    unsigned long bad;                              /*<< torn, empty or reordered lines */
+};
+
+/*---------- variable ----------*/
+static pthread_mutex_t test_console_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t test_buf_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char *test_out;
+static size_t test_out_len, test_out_size;
+static volatile unsigned int test_print_delay;      /*<< spins per char printed, to widen the races */
+
+/*---------- function ----------*/
+static bool test_acquire_console(void)
+{
+#ifdef CONFIG_XLOG_LOCKLESS
+    return (pthread_mutex_trylock(&test_console_mutex) == 0);
+#else
+    pthread_mutex_lock(&test_console_mutex);
+    return true;
+#endif
+}
+
+static void test_release_console(void)
+{
+    pthread_mutex_unlock(&test_console_mutex);
+}
+
+static void test_lock(void)
+{
+    pthread_mutex_lock(&test_buf_mutex);
+}
+
+static void test_unlock(void)
+{
+    pthread_mutex_unlock(&test_buf_mutex);
+}
+
+static void test_yield(void)
+{
+    sched_yield();
+}
+
+/* The console is held while printing, the chars are copied one by one
+ * so that a producer overwriting them shows up as a torn line.
+ */
+static void test_print(const char *str, uint32_t length)
+{
+    volatile unsigned int spin = 0;
+
+    TEST_ASSERT(test_out_len + length <= test_out_size);
+    for(uint32_t i = 0; i < length; ++i) {
+        for(spin = 0; spin < test_print_delay; ++spin) {
+        }
+        test_out[test_out_len + i] = str[i];
+    }
+    test_out_len += length;
+}
+
+static inline void test_ops_init(xlog_ops_t *ops, size_t out_size)
+{
+    test_out_size = out_size;
+    test_out = malloc(out_size);
+    TEST_ASSERT(test_out);
+    test_out_len = 0;
+    memset(ops, 0, sizeof(*ops));
+    ops->lock = test_lock;
+    ops->unlock = test_unlock;
+    ops->acquire_console = test_acquire_console;
+    ops->release_console = test_release_console;
+    ops->yield = test_yield;
+    ops->print = test_print;
+}
+
+/* Skip the color of a line, "\033[..m".
+ */
+static inline const char *__test_skip_color(const char *p, const char *end)
+{
+    if(p < end && *p == '\033') {
+        while(p < end && *p != 'm') {
+            p++;
+        }
+        p++;
+    }
+
+    return p;
+}
+
+/* Check the lines "T<id>-<n>-abc...z" in out, written by @producers
+ * producers, each logging its lines in order from 0.
+ */
+static inline void test_check_out(const char *out, size_t out_len, int producers, unsigned long per_producer,
+                                  struct test_result *res)
+{
+    const char *p = out, *end = out + out_len, *nl = NULL;
+    long last[TEST_PRODUCER_MAX];
+    char body[sizeof(TEST_LINE_BODY) + 1];
+    char line[128];
+    int id = 0, n = 0;
+    unsigned long lost = 0;
+    size_t len = 0;
+
+    memset(res, 0, sizeof(*res));
+    for(int i = 0; i < producers; ++i) {
+        last[i] = -1;
+    }
+    while(p < end && (nl = memchr(p, '\n', end - p)) != NULL) {
+        p = __test_skip_color(p, nl);
+        len = (size_t)(nl - p) < sizeof(line) ? (size_t)(nl - p) : sizeof(line) - 1;
+        memcpy(line, p, len);
+        line[len] = '\0';
+        if(sscanf(line, "%lu lines lost", &lost) == 1 && strstr(line, " lines lost")) {
+            res->lost += lost;
+        } else if(sscanf(line, "T%d-%d-%27s", &id, &n, body) == 3 && id >= 0 && id < producers &&
+                  !strcmp(body, TEST_LINE_BODY) && n > last[id] && (unsigned long)n < per_producer) {
+            res->gaps += n - last[id] - 1;
+            last[id] = n;
+            res->lines++;
+        } else {
+            if(res->bad < 5) {
+                fprintf(stderr, "bad line: %s\n", line);
+            }
+            res->bad++;
+        }
+        p = nl + 1;
+    }
+    for(int i = 0; i < producers; ++i) {
+        res->gaps += per_producer - 1 - last[i];
+    }
+}
+
+/* Check the lines printed to the console, see test_check_out().
+ */
+static inline void test_check(int producers, unsigned long per_producer, struct test_result *res)
+{
+    test_check_out(test_out, test_out_len, producers, per_producer, res);
+}
+
+#endif /* __XLOG_TEST_H */
@@ -0,0 +1,143 @@
+/**
+ * @file test/xlog_timestamp.c
+ *
+ * Copyright (C) 2022
+ *
+ * xlog_timestamp.c is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @author HinsShum hinsshum@qq.com
+ *
+ * @encoding utf-8
+ *
+ * The timestamps of the line prefixes. Every thread has a clock of its own,
+ * which the test sets before each line, and the line carries the time it
+ * was logged at. With CONFIG_XLOG_TIMESTAMP_MONOTONIC the prefix must be
+ * "[sec.usec]" of get_timestamp_us(), at the edges of the fields as well,
+ * otherwise "[%Y-%m-%d %H:%M:%S]" of get_timestamp() as strftime() puts it.
+ * Two threads log at once with seconds of their own, mostly the same second
+ * a few times in a row, so the calendar string cached by the console is hit,
+ * missed and refreshed by both: no line may get the string of the other.
+ *
+ * Usage: xlog_timestamp [lines per thread]
+ */
+
+/*---------- includes ----------*/
+#include "xlog_test.h"
+
+/*---------- variable ----------*/
+static unsigned long lines_per_thread = 20000;
+static __thread uint64_t thread_us;                 /*<< clock of the thread, in microseconds */
+
+/*---------- function ----------*/
+#ifdef CONFIG_XLOG_TIMESTAMP_MONOTONIC
+static void test_get_timestamp_us(uint64_t *us)
+{
+    *us = thread_us;
+}
+#else
+static void test_get_timestamp(time_t *utc)
+{
+    *utc = (time_t)(thread_us / 1000000);
+}
+#endif
+
+/* Render the prefix a line logged at us must get.
+ */
+static int expected_time(char *buf, size_t size, uint64_t us)
+{
+#ifdef CONFIG_XLOG_TIMESTAMP_MONOTONIC
+    return snprintf(buf, size, "[%5lu.%06lu]", (unsigned long)(us / 1000000), (unsigned long)(us % 1000000));
+#else
+    time_t utc = (time_t)(us / 1000000);
+    struct tm tm;
+
+    localtime_r(&utc, &tm);
+
+    return (int)strftime(buf, size, "[%Y-%m-%d %H:%M:%S]", &tm);
+#endif
+}
+
+static void *producer(void *arg)
+{
+    /* the edges of the fields first, then a second changing every few lines */
+    static const uint64_t edges[] = {0, 999999, 1000000, 59999999, 99999999999ULL, 100000000000ULL, 4294967295000000ULL};
+    uint64_t base = (uint64_t)(uintptr_t)arg * 86400000000ULL + 1650000000000000ULL;
+    uint32_t r = (uint32_t)(uintptr_t)arg + 1;
+
+    for(unsigned long i = 0; i < lines_per_thread; ++i) {
+        r = r * 1103515245 + 12345;
+        if(i < sizeof(edges) / sizeof(edges[0])) {
+            thread_us = edges[i];
+        } else {
+            thread_us = base + (i / 4) * 1000000ULL + (r >> 12);
+        }
+        xlog_message("U-%llu\n", (unsigned long long)thread_us);
+        if((i & 0xF) == 0xF) {
+            xlog_process();
+        }
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t threads[2];
+    const char *p = NULL, *end = NULL, *nl = NULL, *t = NULL;
+    unsigned long lines = 0, bad = 0;
+    unsigned long long us = 0;
+    char expected[64];
+    int n = 0;
+    xlog_ops_t ops;
+
+    if(argc > 1) {
+        lines_per_thread = strtoul(argv[1], NULL, 0);
+    }
+    setenv("TZ", "UTC", 1);
+    tzset();
+    test_ops_init(&ops, lines_per_thread * 2 * 64 + 4096);
+#ifdef CONFIG_XLOG_TIMESTAMP_MONOTONIC
+    ops.get_timestamp_us = test_get_timestamp_us;
+#else
+    ops.get_timestamp = test_get_timestamp;
+#endif
+    xlog_init(&ops);
+    for(int i = 0; i < 2; ++i) {
+        TEST_ASSERT(!pthread_create(&threads[i], NULL, producer, (void *)(intptr_t)i));
+    }
+    for(int i = 0; i < 2; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    xlog_process();
+    for(p = test_out, end = test_out + test_out_len; p < end && (nl = memchr(p, '\n', end - p)) != NULL; p = nl + 1) {
+        p = __test_skip_color(p, nl);
+        t = memchr(p, ']', nl - p);
+        if(t && sscanf(t + 1, "U-%llu", &us) == 1) {
+            n = expected_time(expected, sizeof(expected), us);
+            if(n == t + 1 - p && !memcmp(p, expected, n)) {
+                lines++;
+                continue;
+            }
+        }
+        if(bad++ < 5) {
+            fprintf(stderr, "bad line: %.*s\n", (int)(nl - p), p);
+        }
+    }
+    printf("xlog_timestamp: %lu lines stamped as expected, bad %lu\n", lines, bad);
+    TEST_ASSERT(!bad && lines == lines_per_thread * 2);
+    xlog_deinit();
+    free(test_out);
+
+    return 0;
+}
@@ -0,0 +1,364 @@
+#!/usr/bin/env python3
+#
+# @file tools/xlog_decode.py
+#
+# Copyright (C) 2022
+#
+# xlog_decode.py is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# @author HinsShum hinsshum@qq.com
+#
+# @encoding utf-8
+#
+"""Decode the log of xlog built with CONFIG_XLOG_BINARY.
+
+The format strings are read from the .xlog_fmt section of the ELF file of the
+firmware. The input is either what the console or a sink put out(a UART dump,
+the frames may be mixed with plain text, which is passed through) or a copy of
+the persistent log region(CONFIG_XLOG_PERSIST), which is recognized by its magic.
+
+usage: xlog_decode.py [-u] [-c] [-t] firmware.elf [input]
+"""
+
+import argparse
+import re
+import struct
+import sys
+import time
+
+# see LOG_FRAME_SYNC in xlog.c
+FRAME_SYNC = 0xA5
+FRAME_ABS = 0x80
+REC_CONT = 1 << 0
+REC_BREAK = 1 << 1
+REC_TIME = 1 << 2
+REC_BIN = 1 << 3
+REC_EOL = 1 << 4
+
+# see struct xlog_persist and struct log_record in xlog.c
+PERSIST_MAGIC = 0x584C4F47
+PERSIST_HEAD = struct.Struct('<9I')
+# the checksum of a record, then padding to the 8 bytes of the timestamp
+RECORD = struct.Struct('<QQHHHBBI4x')
+RECORD_SUM_OFF = 24
+RECORD_LOST_LEVEL = 1
+
+LEVEL_CHAR = 'EWMI'
+LEVEL_COLOR = ['\033[31;22m', '\033[33;22m', '\033[32;22m', '\033[37;22m']
+
+CONV = re.compile(rb'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?(hh|h|ll|l|j|z|t|L)?([diouxXcsfFeEgGaAp%])')
+
+
+class DecodeError(Exception):
+    pass
+
+
+def read_varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        if pos >= len(data) or shift > 63:
+            raise DecodeError('varint')
+        b = data[pos]
+        pos += 1
+        value |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            return value, pos
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+class Formats:
+    """The format strings of the .xlog_fmt section, found by their address."""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            elf = f.read()
+        if elf[:4] != b'\x7fELF':
+            raise SystemExit('%s: not an ELF file' % path)
+        self.ptr_bits = 64 if elf[4] == 2 else 32
+        end = '<' if elf[5] == 1 else '>'
+        if self.ptr_bits == 64:
+            shoff, = struct.unpack_from(end + 'Q', elf, 0x28)
+            shentsize, shnum, shstrndx = struct.unpack_from(end + 'HHH', elf, 0x3A)
+            shdr = struct.Struct(end + 'IIQQQQIIQQ')
+        else:
+            shoff, = struct.unpack_from(end + 'I', elf, 0x20)
+            shentsize, shnum, shstrndx = struct.unpack_from(end + 'HHH', elf, 0x2E)
+            shdr = struct.Struct(end + 'IIIIIIIIII')
+        sections = [shdr.unpack_from(elf, shoff + i * shentsize) for i in range(shnum)]
+        names = sections[shstrndx]
+        self.addr = 0
+        self.data = b''
+        for s in sections:
+            name = elf[names[4] + s[0]:elf.index(b'\0', names[4] + s[0])]
+            if name == b'.xlog_fmt':
+                self.addr = s[3]
+                self.data = elf[s[4]:s[4] + s[5]]
+        if not self.data:
+            raise SystemExit('%s: no .xlog_fmt section, built without CONFIG_XLOG_BINARY?' % path)
+
+    def get(self, fid):
+        off = fid - self.addr
+        if off < 0 or off >= len(self.data):
+            raise DecodeError('format id 0x%x' % fid)
+        return self.data[off:self.data.index(b'\0', off)]
+
+
+def format_arg(flags, width, prec, size, conv, value, ptr_bits):
+    """Format one argument as C printf() would."""
+    if conv in 'diouxXc':
+        bits = {'hh': 8, 'h': 16, 'll': 64, 'j': 64, 'l': ptr_bits}.get(size, 32)
+        value &= (1 << bits) - 1
+        if conv in 'di' and value >> (bits - 1):
+            value -= 1 << bits
+        if conv == 'c':
+            return ('%' + flags.replace('0', '') + width + 's') % chr(value & 0xFF)
+        if conv == 'u':
+            conv = 'd'
+    elif conv == 'p':
+        value &= (1 << ptr_bits) - 1
+        return ('%' + flags.replace('0', '') + width + 's') % ('0x%x' % value if value else '(nil)')
+    elif conv in 'aA':
+        text = float.hex(value)
+        return ('%' + flags.replace('0', '') + width + 's') % (text.upper() if conv == 'A' else text)
+    elif conv == 's':
+        value = value.decode('utf-8', 'replace')
+    spec = '%' + flags + width + ('.' + prec if prec is not None else '') + conv
+    return spec % value
+
+
+def decode_bin(payload, formats):
+    """Render the text of a binary record."""
+    fid, pos = read_varint(payload, 0)
+    fmt = formats.get(fid)
+    out = []
+    last = 0
+
+    def take(kind):
+        nonlocal pos
+        if kind == 'double':
+            if pos + 8 > len(payload):
+                raise DecodeError('double')
+            value, = struct.unpack_from('<d', payload, pos)
+            pos += 8
+        elif kind == 'str':
+            n, pos = read_varint(payload, pos)
+            value = payload[pos:pos + n]
+            pos += n
+        else:
+            value, pos = read_varint(payload, pos)
+            value = unzigzag(value)
+        return value
+
+    for m in CONV.finditer(fmt):
+        out.append(fmt[last:m.start()].decode('utf-8', 'replace'))
+        last = m.end()
+        flags, width, prec, size, conv = [g.decode() if g is not None else None for g in m.groups()]
+        if conv == '%':
+            out.append('%')
+            continue
+        width = width or ''
+        if width == '*':
+            width = str(take('int'))
+        if prec == '*':
+            prec = str(take('int'))
+        kind = 'double' if conv in 'fFeEgGaA' else 'str' if conv == 's' else 'int'
+        out.append(format_arg(flags, width, prec, size, conv, take(kind), formats.ptr_bits))
+    out.append(fmt[last:].decode('utf-8', 'replace'))
+    if pos != len(payload):
+        raise DecodeError('arguments')
+
+    return ''.join(out)
+
+
+class Printer:
+    """Print the records as the console of a text build would."""
+
+    def __init__(self, out, utc, color, log_type):
+        self.out = out
+        self.utc = utc
+        self.color = color
+        self.log_type = log_type
+        self.new_line = True
+
+    def format_time(self, ts):
+        if self.utc:
+            return time.strftime('[%Y-%m-%d %H:%M:%S]', time.gmtime(ts))
+        return '[%5u.%06u]' % (ts // 1000000, ts % 1000000)
+
+    def record(self, level, flags, ts, text):
+        if flags & REC_BREAK and not self.new_line:
+            self.out.write('\n')
+            self.new_line = True
+        if not flags & REC_CONT:
+            prefix = LEVEL_COLOR[level] if self.color else ''
+            if ts is not None:
+                prefix += self.format_time(ts)
+            if self.log_type:
+                prefix += '<%c>' % LEVEL_CHAR[level]
+            self.out.write(prefix)
+        self.out.write(text)
+        if text:
+            self.new_line = (flags & REC_EOL) != 0 if flags & REC_BIN else text.endswith('\n')
+
+    def raw(self, text):
+        self.out.write(text)
+        if text:
+            self.new_line = text.endswith('\n')
+
+    def lost(self, lost):
+        if not self.new_line:
+            self.out.write('\n')
+        self.record(RECORD_LOST_LEVEL, 0, None, '%u lines lost\n' % lost)
+
+
+def record_text(flags, payload, formats):
+    if flags & REC_BIN:
+        return decode_bin(payload, formats)
+    return payload.decode('utf-8', 'replace')
+
+
+def decode_frames(data, formats, printer):
+    """Decode the frames of a console or sink output, anything else is plain text."""
+    pos = 0
+    raw = bytearray()
+    last = None
+    while pos < len(data):
+        if data[pos] != FRAME_SYNC:
+            raw.append(data[pos])
+            pos += 1
+            continue
+        try:
+            size, body = read_varint(data, pos + 1)
+            if size < 1 or body + size > len(data):
+                raise DecodeError('length')
+            head = data[body]
+            level = head & 0x3
+            flags = (head >> 2) & 0x1F
+            n = body + 1
+            ts = None
+            if flags & REC_TIME:
+                value, n = read_varint(data, n)
+                if head & FRAME_ABS:
+                    ts = value
+                elif last is not None:
+                    ts = last + unzigzag(value)
+                if n > body + size:
+                    raise DecodeError('timestamp')
+            text = record_text(flags, data[n:body + size], formats)
+        except (DecodeError, UnicodeError):
+            raw.append(data[pos])
+            pos += 1
+            continue
+        printer.raw(raw.decode('utf-8', 'replace'))
+        raw.clear()
+        if ts is not None:
+            last = ts
+        printer.record(level, flags, ts, text)
+        pos = body + size
+    printer.raw(raw.decode('utf-8', 'replace'))
+
+
+def decode_persist(data, formats, printer):
+    """Decode the records kept in a persistent log region."""
+    magic, size, gen = PERSIST_HEAD.unpack_from(data)[:3]
+    slots = PERSIST_HEAD.unpack_from(data)[3:]
+    buf = data[PERSIST_HEAD.size:PERSIST_HEAD.size + size]
+    if magic != PERSIST_MAGIC or len(buf) != size or size & (size - 1):
+        raise SystemExit('bad persistent log region')
+
+    def persist_sum(first, end):
+        s = 2166136261
+        for word in (PERSIST_MAGIC, first, end):
+            s = ((s ^ word) * 16777619) & 0xFFFFFFFF
+        return s
+
+    def record_sum(head, text):
+        s = 2166136261
+        for b in head[:RECORD_SUM_OFF] + text:
+            s = ((s ^ b) * 16777619) & 0xFFFFFFFF
+        return s
+
+    def read(off, n):
+        off &= size - 1
+        chunk = buf[off:off + n]
+        return chunk + buf[:n - len(chunk)]
+
+    def chain(off, end):
+        records = []
+        seq = None
+        while ((end - off) & 0xFFFFFFFF) >= RECORD.size and ((end - off) & 0x80000000) == 0:
+            head = read(off, RECORD.size)
+            ts, rseq, length, tag, lost, level, flags, rsum = RECORD.unpack(head)
+            if length > size // 4 or level > 3 or flags & ~0x1F or (seq is not None and rseq != seq) or \
+               ((end - off - RECORD.size) & 0xFFFFFFFF) < length:
+                break
+            text = read(off + RECORD.size, length)
+            if rsum != record_sum(head, text):
+                break
+            records.append(((ts, rseq, length, tag, lost, level, flags), text))
+            off = (off + RECORD.size + length) & 0xFFFFFFFF
+            seq = rseq + 1
+        return records if off == end else []
+
+    slot = None
+    for first, end, s in (slots[0:3], slots[3:6]):
+        if s == persist_sum(first, end) and ((end - first) & 0xFFFFFFFF) <= size and \
+           (slot is None or ((end - slot[1]) & 0x80000000) == 0 and end != slot[1]):
+            slot = (first, end)
+    records = []
+    if slot:
+        first = slot[0]
+        while first != slot[1] and not records:
+            records = chain(first, slot[1])
+            first = (first + 1) & 0xFFFFFFFF
+    for (ts, seq, length, tag, lost, level, flags), payload in records:
+        if lost:
+            printer.lost(lost)
+        try:
+            text = record_text(flags, payload, formats)
+        except DecodeError as e:
+            text = '<record %u: %s>\n' % (seq, e)
+        printer.record(level, flags, ts if flags & REC_TIME else None, text)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode the binary log of xlog(CONFIG_XLOG_BINARY).')
+    parser.add_argument('elf', help='ELF file of the firmware')
+    parser.add_argument('input', nargs='?', help='console dump or persistent log region, stdin by default')
+    parser.add_argument('-u', '--utc', action='store_true',
+                        help='timestamps are UTC seconds, without CONFIG_XLOG_TIMESTAMP_MONOTONIC')
+    parser.add_argument('-c', '--color', action='store_true', help='color the lines by log level')
+    parser.add_argument('-t', '--type', action='store_true', help='show the log type, see xlog_hide_log_type()')
+    args = parser.parse_args()
+
+    formats = Formats(args.elf)
+    if args.input:
+        with open(args.input, 'rb') as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+    printer = Printer(sys.stdout, args.utc, args.color, args.type)
+    if len(data) >= PERSIST_HEAD.size and struct.unpack_from('<I', data)[0] == PERSIST_MAGIC:
+        decode_persist(data, formats, printer)
+    else:
+        decode_frames(data, formats, printer)
+
+
+if __name__ == '__main__':
+    main()
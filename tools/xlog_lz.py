@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+#
+# @file tools/xlog_lz.py
+#
+# Copyright (C) 2022
+#
+# xlog_lz.py is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# @author HinsShum hinsshum@qq.com
+#
+# @encoding utf-8
+#
+"""Decompress a stream written by a sink with a compressor(xlog_lz.h).
+
+The chunks of the stream must be given in order from the start of the stream,
+ie. from when the sink was added. The output of a binary build can be piped
+into xlog_decode.py.
+
+usage: xlog_lz.py [input [output]]
+"""
+
+import argparse
+import sys
+
+# see lz_dict in xlog_lz.c, they must be kept the same
+LZ_DICT = (b' records restored from the previous boot\n'
+           b' lines suppressed in ()\n'
+           b'last message repeated  times\n'
+           b' lines lost\n'
+           b'xlog: '
+           b'[2026-01-01 00:00:00]'
+           b'\n\033[31;22m[    0.000000]'
+           b'\n\033[32;22m[    0.000000]'
+           b'\n\033[33;22m[    0.000000]'
+           b'\n\033[37;22m[    0.000000]')
+LZ_MIN_MATCH = 4
+LZ_RUN_MAX = 15
+
+
+class StreamError(Exception):
+    pass
+
+
+def decompress(data):
+    """Decompress a whole stream, see xlog_lz_write()."""
+    out = bytearray(LZ_DICT)
+    pos = 0
+
+    def byte():
+        nonlocal pos
+        if pos >= len(data):
+            raise StreamError('stream cut at %u' % pos)
+        pos += 1
+        return data[pos - 1]
+
+    def run(n):
+        if n == LZ_RUN_MAX:
+            while True:
+                b = byte()
+                n += b
+                if b != 255:
+                    break
+        return n
+
+    while pos < len(data):
+        token = byte()
+        nlit = run(token >> 4)
+        if pos + nlit > len(data):
+            raise StreamError('stream cut at %u' % pos)
+        out += data[pos:pos + nlit]
+        pos += nlit
+        dist = byte()
+        dist |= byte() << 8
+        if not dist:
+            continue
+        mlen = run(token & 0xF) + LZ_MIN_MATCH
+        if dist > len(out):
+            raise StreamError('offset %u out of the history at %u' % (dist, pos))
+        start = len(out) - dist
+        if dist >= mlen:
+            out += out[start:start + mlen]
+        else:
+            for i in range(mlen):
+                out.append(out[start + i])
+
+    return bytes(out[len(LZ_DICT):])
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decompress the stream of an xlog sink with a compressor.')
+    parser.add_argument('input', nargs='?', help='compressed stream, stdin by default')
+    parser.add_argument('output', nargs='?', help='where the log goes, stdout by default')
+    args = parser.parse_args()
+
+    if args.input:
+        with open(args.input, 'rb') as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+    try:
+        log = decompress(data)
+    except StreamError as e:
+        raise SystemExit('xlog_lz.py: %s' % e)
+    if args.output:
+        with open(args.output, 'wb') as f:
+            f.write(log)
+    else:
+        sys.stdout.buffer.write(log)
+
+
+if __name__ == '__main__':
+    main()